@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "frame_stats.hpp"
+
+// Helpers shared by the benchmark executables, which print one JSON object
+// on stdout so CI can diff and gate on the numbers.
+
+// Peak resident set size of this process so far, in KiB (0 where the
+// platform does not report it).
+inline std::uint64_t peak_rss_kib() {
+#if defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::uint64_t>(usage.ru_maxrss) / 1024;  // bytes
+#elif defined(__unix__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::uint64_t>(usage.ru_maxrss);  // KiB
+#else
+    return 0;
+#endif
+}
+
+inline std::string json_string(const std::string& value) {
+    std::string out = "\"";
+    for (const char c : value) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            default:
+                out += c;
+        }
+    }
+    return out + '"';
+}
+
+inline std::string json_number(double value) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << value;
+    return out.str();
+}
+
+// {"samples":..,"p50_ms":..,"p95_ms":..,"p99_ms":..,"max_ms":..}
+inline std::string json_summary(const FrameStats::Summary& summary) {
+    return "{\"samples\":" + std::to_string(summary.samples) +
+           ",\"p50_ms\":" + json_number(summary.p50_ms) +
+           ",\"p95_ms\":" + json_number(summary.p95_ms) +
+           ",\"p99_ms\":" + json_number(summary.p99_ms) +
+           ",\"max_ms\":" + json_number(summary.max_ms) + "}";
+}
+
+// A stage's json_summary() plus the heap allocations made inside it:
+// {..,"max_ms":..,"allocations":..,"allocated_bytes":..}. Allocations are
+// counted because the benchmarks link alloc_counter.cpp.
+inline std::string json_stage(const FrameStats& stats, FrameStage stage) {
+    std::string json = json_summary(stats.summary(stage));
+    const auto allocations = stats.allocations(stage);
+    json.pop_back();
+    return json + ",\"allocations\":" +
+           std::to_string(allocations.allocations) +
+           ",\"allocated_bytes\":" + std::to_string(allocations.bytes) + "}";
+}
@@ -0,0 +1,370 @@
+// Load benchmark of CustomFileSource against a local HTTP stand-in.
+//
+// Starts an in-process server (local_http_server.hpp) serving synthetic
+// tiles with configurable latency, size and error rate, replays tile request
+// patterns a map produces through CustomFileSource::request(), and prints
+// requests/s, latency percentiles, the process's peak RSS and how many
+// cancelled requests still cost a transfer, as JSON. Responses arrive
+// through an mbgl run loop on the main thread, as they do in the map.
+//
+//   maplibre-slint-fetch-bench [--steps N] [--interval-ms MS]
+//       [--latency-ms MS] [--jitter-ms MS] [--tile-bytes N]
+//       [--error-rate F] [--workers N] [--per-host N]
+//       [--scenario NAME] [--output FILE]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mbgl/storage/resource.hpp>
+#include <mbgl/storage/response.hpp>
+#include <mbgl/util/run_loop.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_report.hpp"
+#include "custom_file_source.hpp"
+#include "local_http_server.hpp"
+#include "log.hpp"
+#include "tile_cover.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// How long one step of a settling scenario may take, and how long the
+// requests still open at the end get, before the scenario counts as timed
+// out.
+constexpr auto kStepTimeout = std::chrono::seconds(30);
+constexpr auto kDrainTimeout = std::chrono::seconds(60);
+
+struct Options {
+    int steps = 40;
+    int interval_ms = 50;
+    LocalHttpServer::Options server;
+    std::size_t workers = 6;
+    std::size_t per_host = 4;
+    std::string scenario;  // empty: all
+    std::string output;    // empty: stdout
+};
+
+// Viewport the requests are generated for: a 1080p screen.
+constexpr double kWidth = 1920.0;
+constexpr double kHeight = 1080.0;
+
+struct View {
+    double lat = 35.681;
+    double lon = 139.767;
+    double zoom = 14.0;
+};
+
+struct Scenario {
+    const char* name;
+    // Camera position at step `i` of `count`.
+    View (*view)(int i, int count);
+    // Waits for every request of a step before the next one (otherwise
+    // steps follow each other every --interval-ms).
+    bool settle;
+    // Drops requests for tiles that left the viewport, like the map does.
+    bool cancel;
+};
+
+const Scenario kScenarios[] = {
+    // Cold starts in unrelated places: nothing shared between bursts.
+    {"burst",
+     [](int i, int) {
+         return View{35.681, 139.767 + 2.0 * i, 14.0};
+     },
+     true, false},
+    // A steady pan east, a quarter screen per step: each step needs a new
+    // column of tiles while the previous ones are still loading.
+    {"pan",
+     [](int i, int) {
+         const double degrees_per_px = 360.0 / (512.0 * std::exp2(14.0));
+         return View{35.681, 139.767 + i * kWidth / 4.0 * degrees_per_px,
+                     14.0};
+     },
+     false, false},
+    // Zooming in quickly from z10 to z16: most requests are cancelled
+    // before they complete.
+    {"zoom_cancel",
+     [](int i, int count) {
+         const double t = count > 1 ? double(i) / (count - 1) : 1.0;
+         return View{35.681, 139.767, 10.0 + 6.0 * t};
+     },
+     false, true},
+};
+
+struct Request {
+    std::string path;
+    Clock::time_point issued;
+    std::unique_ptr<mbgl::AsyncRequest> handle;
+    bool done = false;
+    bool error = false;
+    bool cancelled = false;
+    double latency_ms = 0.0;
+};
+
+std::string tile_path(const char* scenario, const TileCoordinate& tile) {
+    return "/" + std::string(scenario) + "/" + std::to_string(tile.z) + "/" +
+           std::to_string(tile.x) + "/" + std::to_string(tile.y) + ".pbf";
+}
+
+// `timed_out` is set when requests were still open after the timeouts.
+std::string run_scenario(LocalHttpServer& server, const Scenario& scenario,
+                         const Options& options, bool& timed_out) {
+    mbgl::util::RunLoop run_loop;
+    auto pump = [&run_loop] {
+        run_loop.runOnce();
+        std::this_thread::sleep_for(std::chrono::microseconds(250));
+    };
+
+    server.reset();
+
+    mbgl::CustomFileSource::FetchOptions fetch;
+    fetch.workerCount = options.workers;
+    fetch.maxConnectionsPerHost = options.per_host;
+    fetch.cachePath = ":memory:";
+    auto file_source = std::make_unique<mbgl::CustomFileSource>(fetch);
+    const std::string url_template =
+        server.base_url() + "/" + scenario.name + "/{z}/{x}/{y}.pbf";
+
+    // By path, so a tile is requested once while it is wanted.
+    std::map<std::string, std::unique_ptr<Request>> requests;
+    std::size_t open = 0;
+    const auto start = Clock::now();
+    auto last_response = start;
+
+    for (int step = 0; step < options.steps; ++step) {
+        const auto step_start = Clock::now();
+        const View view = scenario.view(step, options.steps);
+        file_source->setViewport(mbgl::LatLng{view.lat, view.lon}, view.zoom);
+        const auto cover =
+            tile_cover(project_mercator(view.lat, view.lon), view.zoom,
+                       kWidth, kHeight, cover_zoom(view.zoom));
+
+        if (scenario.cancel) {
+            std::vector<std::string> wanted;
+            for (const auto& tile : cover) {
+                wanted.push_back(tile_path(scenario.name, tile));
+            }
+            for (auto& [path, request] : requests) {
+                if (request->done || request->cancelled ||
+                    std::find(wanted.begin(), wanted.end(), path) !=
+                        wanted.end()) {
+                    continue;
+                }
+                request->handle.reset();
+                request->cancelled = true;
+                --open;
+            }
+        }
+
+        for (const auto& tile : cover) {
+            const std::string path = tile_path(scenario.name, tile);
+            if (requests.count(path)) {
+                continue;
+            }
+            auto request = std::make_unique<Request>();
+            Request* raw = request.get();
+            raw->path = path;
+            raw->issued = Clock::now();
+            raw->handle = file_source->request(
+                mbgl::Resource::tile(url_template, 1.0f,
+                                     static_cast<std::int32_t>(tile.x),
+                                     static_cast<std::int32_t>(tile.y),
+                                     static_cast<std::int8_t>(tile.z),
+                                     mbgl::Tileset::Scheme::XYZ),
+                [raw, &open, &last_response](mbgl::Response response) {
+                    if (raw->done) {
+                        return;
+                    }
+                    last_response = Clock::now();
+                    raw->done = true;
+                    raw->error = response.error != nullptr;
+                    raw->latency_ms = std::chrono::duration<double, std::milli>(
+                                          last_response - raw->issued)
+                                          .count();
+                    --open;
+                });
+            requests.emplace(path, std::move(request));
+            ++open;
+        }
+
+        const auto next =
+            scenario.settle
+                ? step_start + kStepTimeout
+                : step_start + std::chrono::milliseconds(options.interval_ms);
+        while ((!scenario.settle || open > 0) && Clock::now() < next) {
+            pump();
+        }
+        if (scenario.settle && open > 0) {
+            break;
+        }
+    }
+
+    const auto deadline = Clock::now() + kDrainTimeout;
+    while (open > 0 && Clock::now() < deadline) {
+        pump();
+    }
+    timed_out = open > 0;
+    const auto transfer = file_source->transferStats();
+    const auto cache = file_source->memoryCacheStats();
+    const std::size_t workers = file_source->workerCount();
+
+    std::vector<double> latencies;
+    std::size_t completed = 0, errors = 0, cancelled = 0;
+    std::size_t never_sent = 0, aborted = 0, completed_anyway = 0;
+    for (const auto& [path, request] : requests) {
+        if (request->cancelled) {
+            ++cancelled;
+            if (!server.received(path)) {
+                ++never_sent;
+            } else if (server.served(path)) {
+                ++completed_anyway;
+            } else {
+                ++aborted;
+            }
+        } else if (request->done) {
+            ++completed;
+            errors += request->error ? 1 : 0;
+            latencies.push_back(request->latency_ms);
+        }
+    }
+    for (auto& [path, request] : requests) {
+        request->handle.reset();
+    }
+    file_source.reset();
+
+    const double seconds =
+        std::chrono::duration<double>(last_response - start).count();
+    const auto served = server.stats();
+    const double effectiveness =
+        cancelled ? double(never_sent + aborted) / cancelled : 1.0;
+
+    return "{\"name\":" + json_string(scenario.name) +
+           ",\"requests\":" + std::to_string(requests.size()) +
+           ",\"completed\":" + std::to_string(completed) +
+           ",\"errors\":" + std::to_string(errors) +
+           ",\"timed_out\":" + (timed_out ? "true" : "false") +
+           ",\"seconds\":" + json_number(seconds) + ",\"requests_per_s\":" +
+           json_number(seconds > 0.0 ? completed / seconds : 0.0) +
+           ",\"latency\":" +
+           json_summary(FrameStats::summarize(std::move(latencies))) +
+           ",\"worker_threads\":" + std::to_string(workers) +
+           ",\"process_peak_rss_kib\":" + std::to_string(peak_rss_kib()) +
+           ",\"cancellation\":{\"cancelled\":" + std::to_string(cancelled) +
+           ",\"never_sent\":" + std::to_string(never_sent) +
+           ",\"aborted_in_flight\":" + std::to_string(aborted) +
+           ",\"completed_anyway\":" + std::to_string(completed_anyway) +
+           ",\"effectiveness\":" + json_number(effectiveness) + "}" +
+           ",\"server\":{\"requests\":" + std::to_string(served.requests) +
+           ",\"responses\":" + std::to_string(served.responses) +
+           ",\"errors\":" + std::to_string(served.errors) +
+           ",\"client_aborts\":" + std::to_string(served.client_aborts) +
+           ",\"bytes_sent\":" + std::to_string(served.bytes_sent) + "}" +
+           ",\"transfer\":{\"transfers\":" +
+           std::to_string(transfer.transfers) +
+           ",\"wire_bytes\":" + std::to_string(transfer.wireBytes) +
+           ",\"decoded_bytes\":" + std::to_string(transfer.decodedBytes) +
+           "},\"memory_cache\":{\"hits\":" + std::to_string(cache.hits) +
+           ",\"misses\":" + std::to_string(cache.misses) + "}}";
+}
+
+bool parse(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            std::cerr << "missing value for " << arg << "\n";
+            return false;
+        }
+        if (arg == "--steps") {
+            options.steps = std::atoi(value);
+        } else if (arg == "--interval-ms") {
+            options.interval_ms = std::atoi(value);
+        } else if (arg == "--latency-ms") {
+            options.server.latency =
+                std::chrono::milliseconds(std::atoi(value));
+        } else if (arg == "--jitter-ms") {
+            options.server.jitter =
+                std::chrono::milliseconds(std::atoi(value));
+        } else if (arg == "--tile-bytes") {
+            options.server.body_bytes = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--error-rate") {
+            options.server.error_rate = std::atof(value);
+        } else if (arg == "--workers") {
+            options.workers = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--per-host") {
+            options.per_host = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--scenario") {
+            options.scenario = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        }
+        ++i;
+    }
+    return options.steps > 0 && options.interval_ms >= 0 &&
+           options.workers > 0 && options.per_host > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        std::cerr << "usage: maplibre-slint-fetch-bench [--steps N] "
+                     "[--interval-ms MS] [--latency-ms MS] [--jitter-ms MS] "
+                     "[--tile-bytes N] [--error-rate F] [--workers N] "
+                     "[--per-host N] [--scenario NAME] [--output FILE]\n";
+        return 2;
+    }
+    if (!std::getenv("SLINT_MAPLIBRE_LOG")) {
+        slint_maplibre::log::set_level(slint_maplibre::log::Level::Warning);
+    }
+    // Enough handlers that every worker connection is served at once.
+    options.server.threads = std::max(options.server.threads, options.workers);
+    LocalHttpServer server(options.server);
+
+    std::string json =
+        "{\"benchmark\":\"fetch\",\"workers\":" +
+        std::to_string(options.workers) +
+        ",\"per_host\":" + std::to_string(options.per_host) +
+        ",\"latency_ms\":" + std::to_string(options.server.latency.count()) +
+        ",\"jitter_ms\":" + std::to_string(options.server.jitter.count()) +
+        ",\"tile_bytes\":" + std::to_string(options.server.body_bytes) +
+        ",\"error_rate\":" + json_number(options.server.error_rate) +
+        ",\"scenarios\":[";
+    bool first = true;
+    bool failed = false;
+    for (const auto& scenario : kScenarios) {
+        if (!options.scenario.empty() && options.scenario != scenario.name) {
+            continue;
+        }
+        bool timed_out = false;
+        json += (first ? "" : ",") +
+                run_scenario(server, scenario, options, timed_out);
+        first = false;
+        if (timed_out) {
+            std::cerr << scenario.name << ": requests still open after "
+                      << "the timeout\n";
+            failed = true;
+        }
+    }
+    json += "],\"peak_rss_kib\":" + std::to_string(peak_rss_kib()) + "}\n";
+
+    if (options.output.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.output, std::ios::trunc) << json;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+#include "fixture.hpp"
+
+#include <fstream>
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Mapbox Vector Tile (protobuf) encoding, just enough for unattributed
+// lines and polygons.
+constexpr std::uint32_t kExtent = 4096;
+
+void put_varint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void put_uint(std::string& out, std::uint32_t field, std::uint64_t value) {
+    put_varint(out, field << 3);
+    put_varint(out, value);
+}
+
+void put_bytes(std::string& out, std::uint32_t field,
+               const std::string& bytes) {
+    put_varint(out, (field << 3) | 2);
+    put_varint(out, bytes.size());
+    out += bytes;
+}
+
+std::uint32_t zigzag(std::int32_t value) {
+    return (static_cast<std::uint32_t>(value) << 1) ^
+           static_cast<std::uint32_t>(value >> 31);
+}
+
+std::uint32_t command(std::uint32_t id, std::uint32_t count) {
+    return (id & 7) | (count << 3);
+}
+
+class LayerBuilder {
+public:
+    explicit LayerBuilder(std::string name) : name_(std::move(name)) {
+    }
+
+    // Clockwise in tile coordinates (y down), i.e. an exterior ring.
+    void add_rect(std::int32_t x, std::int32_t y, std::int32_t w,
+                  std::int32_t h) {
+        add(kPolygon, {command(kMoveTo, 1), zigzag(x), zigzag(y),
+                       command(kLineTo, 3), zigzag(w), zigzag(0), zigzag(0),
+                       zigzag(h), zigzag(-w), zigzag(0),
+                       command(kClosePath, 1)});
+    }
+
+    void add_line(std::int32_t x0, std::int32_t y0, std::int32_t x1,
+                  std::int32_t y1) {
+        add(kLine, {command(kMoveTo, 1), zigzag(x0), zigzag(y0),
+                    command(kLineTo, 1), zigzag(x1 - x0), zigzag(y1 - y0)});
+    }
+
+    std::string encode() const {
+        std::string layer;
+        put_uint(layer, 15, 2);  // version
+        put_bytes(layer, 1, name_);
+        for (const auto& feature : features_) {
+            put_bytes(layer, 2, feature);
+        }
+        put_uint(layer, 5, kExtent);
+        return layer;
+    }
+
+private:
+    static constexpr std::uint32_t kLine = 2;
+    static constexpr std::uint32_t kPolygon = 3;
+    static constexpr std::uint32_t kMoveTo = 1;
+    static constexpr std::uint32_t kLineTo = 2;
+    static constexpr std::uint32_t kClosePath = 7;
+
+    void add(std::uint32_t type, const std::vector<std::uint32_t>& geometry) {
+        std::string packed;
+        for (const auto value : geometry) {
+            put_varint(packed, value);
+        }
+        std::string feature;
+        put_uint(feature, 1, features_.size() + 1);  // id
+        put_uint(feature, 3, type);
+        put_bytes(feature, 4, packed);
+        features_.push_back(std::move(feature));
+    }
+
+    std::string name_;
+    std::vector<std::string> features_;
+};
+
+const char* kStyleTemplate = R"JSON({
+  "version": 8,
+  "name": "bench",
+  "sources": {
+    "fixture": { "type": "vector", "url": "@ARCHIVE@" }
+  },
+  "layers": [
+    { "id": "background", "type": "background",
+      "paint": { "background-color": "#f2efe9" } },
+    { "id": "blocks", "type": "fill", "source": "fixture",
+      "source-layer": "blocks",
+      "paint": { "fill-color": "#d8d0c4", "fill-outline-color": "#b8ad9e" } },
+    { "id": "water", "type": "fill", "source": "fixture",
+      "source-layer": "water",
+      "paint": { "fill-color": "#a0c8f0", "fill-opacity": 0.9 } },
+    { "id": "roads-casing", "type": "line", "source": "fixture",
+      "source-layer": "roads",
+      "paint": { "line-color": "#c0b8a8",
+                 "line-width": { "stops": [[2, 1.5], [12, 7]] } } },
+    { "id": "roads", "type": "line", "source": "fixture",
+      "source-layer": "roads",
+      "paint": { "line-color": "#ffffff",
+                 "line-width": { "stops": [[2, 0.5], [12, 4]] } } }
+  ]
+})JSON";
+
+void exec(sqlite3* db, const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::string message = error ? error : "unknown error";
+        sqlite3_free(error);
+        throw std::runtime_error("fixture archive: " + message);
+    }
+}
+
+void write_archive(const std::filesystem::path& path, int max_zoom) {
+    std::filesystem::remove(path);
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.string().c_str(), &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        throw std::runtime_error("cannot create " + path.string());
+    }
+    try {
+        exec(db,
+             "CREATE TABLE metadata (name TEXT, value TEXT);"
+             "CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER,"
+             " tile_row INTEGER, tile_data BLOB);"
+             "CREATE UNIQUE INDEX tile_index ON tiles"
+             " (zoom_level, tile_column, tile_row);"
+             "BEGIN;");
+        const std::string metadata =
+            "INSERT INTO metadata VALUES ('name', 'bench'),"
+            " ('format', 'pbf'), ('minzoom', '0'),"
+            " ('maxzoom', '" +
+            std::to_string(max_zoom) +
+            "'), ('json', '{\"vector_layers\":[{\"id\":\"blocks\"},"
+            "{\"id\":\"water\"},{\"id\":\"roads\"}]}');";
+        exec(db, metadata.c_str());
+
+        sqlite3_stmt* insert = nullptr;
+        sqlite3_prepare_v2(db, "INSERT INTO tiles VALUES (?1, ?2, ?3, ?4)",
+                           -1, &insert, nullptr);
+        for (int z = 0; z <= max_zoom; ++z) {
+            const std::uint32_t n = 1u << z;
+            for (std::uint32_t x = 0; x < n; ++x) {
+                for (std::uint32_t y = 0; y < n; ++y) {
+                    const std::string tile =
+                        bench_tile(static_cast<std::uint8_t>(z), x, y);
+                    sqlite3_bind_int(insert, 1, z);
+                    sqlite3_bind_int(insert, 2, static_cast<int>(x));
+                    // MBTiles rows count from the south (TMS).
+                    sqlite3_bind_int(insert, 3, static_cast<int>(n - 1 - y));
+                    sqlite3_bind_blob(insert, 4, tile.data(),
+                                      static_cast<int>(tile.size()),
+                                      SQLITE_TRANSIENT);
+                    sqlite3_step(insert);
+                    sqlite3_reset(insert);
+                }
+            }
+        }
+        sqlite3_finalize(insert);
+        exec(db, "COMMIT;");
+    } catch (...) {
+        sqlite3_close(db);
+        throw;
+    }
+    sqlite3_close(db);
+}
+
+}  // namespace
+
+std::string bench_tile(std::uint8_t z, std::uint32_t x, std::uint32_t y) {
+    constexpr std::int32_t kCell = kExtent / 8;
+    constexpr std::int32_t kInset = kCell / 16;
+    constexpr std::int32_t kBuffer = 64;
+
+    LayerBuilder blocks("blocks");
+    for (std::int32_t row = 0; row < 8; ++row) {
+        for (std::int32_t column = 0; column < 8; ++column) {
+            if ((row + column + x + y) % 2 == 0) {
+                blocks.add_rect(column * kCell + kInset, row * kCell + kInset,
+                                kCell - 2 * kInset, kCell - 2 * kInset);
+            }
+        }
+    }
+
+    // A lake in one quadrant, which one depending on the tile.
+    LayerBuilder water("water");
+    const std::uint32_t quadrant = (x * 7 + y * 13 + z) % 4;
+    water.add_rect(static_cast<std::int32_t>(quadrant % 2) * 2 * kCell +
+                       kCell / 2,
+                   static_cast<std::int32_t>(quadrant / 2) * 2 * kCell +
+                       kCell / 2,
+                   3 * kCell / 2, kCell);
+
+    LayerBuilder roads("roads");
+    for (std::int32_t i = 0; i <= 8; ++i) {
+        const std::int32_t at = i * kCell;
+        roads.add_line(-kBuffer, at, kExtent + kBuffer, at);
+        roads.add_line(at, -kBuffer, at, kExtent + kBuffer);
+    }
+
+    std::string tile;
+    put_bytes(tile, 3, blocks.encode());
+    put_bytes(tile, 3, water.encode());
+    put_bytes(tile, 3, roads.encode());
+    return tile;
+}
+
+BenchFixture write_bench_fixture(const std::filesystem::path& directory,
+                                 int max_zoom) {
+    std::filesystem::create_directories(directory);
+    BenchFixture fixture;
+    fixture.max_zoom = max_zoom;
+    fixture.archive =
+        std::filesystem::absolute(directory / "fixture.mbtiles");
+    write_archive(fixture.archive, max_zoom);
+
+    std::string style = kStyleTemplate;
+    const std::string placeholder = "@ARCHIVE@";
+    style.replace(style.find(placeholder), placeholder.size(),
+                  "mbtiles://" + fixture.archive.generic_string());
+    const auto style_path = std::filesystem::absolute(directory / "style.json");
+    std::ofstream(style_path, std::ios::binary | std::ios::trunc) << style;
+    fixture.style_url = "file://" + style_path.generic_string();
+    return fixture;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// A self-contained map for the benchmarks, so they never touch the network:
+// a style with fill and line layers only (no glyphs or sprites) over an
+// MBTiles archive of synthetic vector tiles. Every tile holds a checkerboard
+// of blocks, a few water bodies and a road grid, so the renderer does a
+// similar amount of work at every position and zoom.
+struct BenchFixture {
+    // file:// URL of the style.
+    std::string style_url;
+    // Archive with zoom levels 0..max_zoom; deeper zooms are overzoomed.
+    std::filesystem::path archive;
+    int max_zoom = 0;
+};
+
+// Writes style.json and fixture.mbtiles into `directory` (created if
+// needed) and returns where they are. Throws std::runtime_error if the
+// archive cannot be written.
+BenchFixture write_bench_fixture(const std::filesystem::path& directory,
+                                 int max_zoom = 5);
+
+// The encoded vector tile the fixture stores at z/x/y.
+std::string bench_tile(std::uint8_t z, std::uint32_t x, std::uint32_t y);
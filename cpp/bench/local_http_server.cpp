@@ -0,0 +1,330 @@
+#include "local_http_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;  // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+// Incompressible, so the numbers do not depend on content encoding.
+std::string make_body(std::size_t size) {
+    std::string body(size, '\0');
+    std::mt19937 random(42);
+    for (auto& c : body) {
+        c = static_cast<char>(random() & 0xff);
+    }
+    return body;
+}
+
+bool send_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const auto sent = ::send(fd, data.data(), data.size(), kSendFlags);
+        if (sent <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+}
+
+std::string lower_case(std::string_view text) {
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return lower;
+}
+
+bool header_says_close(std::string_view head) {
+    return lower_case(head).find("\r\nconnection: close") !=
+           std::string::npos;
+}
+
+const char* reason_phrase(int status) {
+    switch (status) {
+        case 200:
+            return "OK";
+        case 204:
+            return "No Content";
+        case 304:
+            return "Not Modified";
+        case 404:
+            return "Not Found";
+        case 429:
+            return "Too Many Requests";
+        case 500:
+            return "Internal Server Error";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Status";
+    }
+}
+
+}  // namespace
+
+std::string LocalHttpServer::Request::header(std::string_view name) const {
+    const std::string lower = lower_case(head);
+    const std::string key = "\r\n" + lower_case(name) + ":";
+    const auto start = lower.find(key);
+    if (start == std::string::npos) {
+        return {};
+    }
+    auto value = start + key.size();
+    const auto end = head.find("\r\n", value);
+    value = head.find_first_not_of(" \t", value);
+    if (value == std::string::npos ||
+        (end != std::string::npos && value > end)) {
+        return {};
+    }
+    return head.substr(value, end == std::string::npos ? end : end - value);
+}
+
+LocalHttpServer::LocalHttpServer(Options options)
+    : options_(options), body_(make_body(options.body_bytes)) {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("local server: cannot create socket");
+    }
+    const int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) != 0 ||
+        ::listen(listen_fd_, 128) != 0 ||
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                      &length) != 0) {
+        ::close(listen_fd_);
+        throw std::runtime_error("local server: cannot listen on loopback");
+    }
+    port_ = ntohs(address.sin_port);
+
+    const std::size_t threads = std::max<std::size_t>(1, options_.threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        handlers_.emplace_back([this, i] { handler_loop(i); });
+    }
+    acceptor_ = std::thread([this] { accept_loop(); });
+}
+
+LocalHttpServer::~LocalHttpServer() {
+    stopping_ = true;
+    ::shutdown(listen_fd_, SHUT_RDWR);
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        for (const int fd : active_) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+    connections_ready_.notify_all();
+    acceptor_.join();
+    for (auto& handler : handlers_) {
+        handler.join();
+    }
+    for (const int fd : waiting_) {
+        ::close(fd);
+    }
+    ::close(listen_fd_);
+}
+
+std::string LocalHttpServer::base_url() const {
+    return "http://127.0.0.1:" + std::to_string(port_);
+}
+
+LocalHttpServer::Stats LocalHttpServer::stats() const {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    return stats_;
+}
+
+bool LocalHttpServer::received(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    return received_.count(path) != 0;
+}
+
+bool LocalHttpServer::served(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    return served_.count(path) != 0;
+}
+
+void LocalHttpServer::reset() {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    stats_ = {};
+    received_.clear();
+    served_.clear();
+}
+
+void LocalHttpServer::accept_loop() {
+    while (!stopping_) {
+        const int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (stopping_) {
+                return;
+            }
+            continue;
+        }
+        const int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            waiting_.push_back(fd);
+        }
+        connections_ready_.notify_one();
+    }
+}
+
+void LocalHttpServer::handler_loop(std::size_t index) {
+    while (true) {
+        int fd = -1;
+        {
+            std::unique_lock<std::mutex> lock(connections_mutex_);
+            connections_ready_.wait(
+                lock, [this] { return stopping_ || !waiting_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            fd = waiting_.front();
+            waiting_.pop_front();
+            active_.insert(fd);
+        }
+        serve(fd, index);
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            active_.erase(fd);
+        }
+        ::close(fd);
+    }
+}
+
+void LocalHttpServer::serve(int fd, std::size_t index) {
+    std::mt19937 random(static_cast<unsigned>(index) * 7919u + port_);
+    const auto max_jitter = std::max<std::int64_t>(0, options_.jitter.count());
+    std::uniform_int_distribution<int> jitter(0,
+                                              static_cast<int>(max_jitter));
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    std::string buffer;
+    char chunk[4096];
+    while (!stopping_) {
+        std::size_t end = buffer.find("\r\n\r\n");
+        while (end == std::string::npos) {
+            const auto got = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                return;
+            }
+            buffer.append(chunk, static_cast<std::size_t>(got));
+            end = buffer.find("\r\n\r\n");
+        }
+        const std::string head = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+
+        // "GET /path?query HTTP/1.1"; clients only send GETs here.
+        const auto first = head.find(' ');
+        const auto second = head.find(' ', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            return;
+        }
+        const std::string path = head.substr(first + 1, second - first - 1);
+        {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            ++stats_.requests;
+            received_.insert(path);
+        }
+
+        const auto delay =
+            options_.latency + std::chrono::milliseconds(jitter(random));
+        if (!wait_for_response(fd, delay)) {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            ++stats_.client_aborts;
+            return;
+        }
+
+        bool error = false;
+        std::string response;
+        std::string_view body;
+        Reply reply;
+        if (options_.handler) {
+            reply = options_.handler(Request{path, head});
+            error = reply.status >= 400;
+            body = reply.body;
+            response = "HTTP/1.1 " + std::to_string(reply.status) + " " +
+                       reason_phrase(reply.status) + "\r\n" + reply.headers +
+                       "Content-Length: " + std::to_string(body.size()) +
+                       "\r\n\r\n";
+        } else if (chance(random) < options_.error_rate) {
+            error = true;
+            response =
+                "HTTP/1.1 500 Internal Server Error\r\n"
+                "Content-Length: 0\r\n\r\n";
+        } else {
+            body = body_;
+            response =
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: application/x-protobuf\r\n"
+                "Cache-Control: max-age=3600\r\n"
+                "Content-Length: " +
+                std::to_string(body_.size()) + "\r\n\r\n";
+        }
+        if (!send_all(fd, response) || !send_all(fd, body)) {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            ++stats_.client_aborts;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            ++stats_.responses;
+            stats_.errors += error ? 1 : 0;
+            stats_.bytes_sent += response.size() + body.size();
+            served_.insert(path);
+        }
+        if (header_says_close(head)) {
+            return;
+        }
+    }
+}
+
+// Sleeps for `delay`, returning early (false) if the client hangs up in the
+// meantime, which is how an aborted transfer shows up on this side.
+bool LocalHttpServer::wait_for_response(int fd,
+                                        std::chrono::milliseconds delay) {
+    const auto deadline = std::chrono::steady_clock::now() + delay;
+    while (!stopping_) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return true;
+        }
+        pollfd entry{fd, POLLIN, 0};
+        const auto slice = std::min<std::int64_t>(left.count(), 5);
+        const int ready = ::poll(&entry, 1, static_cast<int>(slice));
+        if (ready > 0) {
+            char probe;
+            if (::recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) == 0 ||
+                (entry.revents & (POLLERR | POLLHUP))) {
+                return false;
+            }
+            // Pipelined data; curl does not pipeline, so just keep waiting.
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return false;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// A small HTTP/1.1 server on 127.0.0.1 for the fetch benchmark and the
+// file source tests. Every GET is answered after a configurable delay with a
+// synthetic body, or with a 500 at a configurable rate, unless a handler
+// scripts the replies. Connections are kept alive, as CustomFileSource keeps
+// one session per worker, and served by a fixed set of threads so the server
+// does not disturb the client's thread count. POSIX only.
+class LocalHttpServer {
+public:
+    struct Request {
+        // Including the query.
+        std::string path;
+        // Value of a request header, empty if it was not sent. `name` is
+        // matched case-insensitively.
+        std::string header(std::string_view name) const;
+
+        // Request line and headers as received.
+        std::string head;
+    };
+
+    struct Reply {
+        int status = 200;
+        // Extra header lines, each ending in "\r\n".
+        std::string headers;
+        std::string body;
+    };
+
+    // Runs on a server thread once the latency has passed.
+    using Handler = std::function<Reply(const Request&)>;
+
+    struct Options {
+        // Time to first byte: latency plus a uniformly distributed jitter.
+        std::chrono::milliseconds latency{20};
+        std::chrono::milliseconds jitter{10};
+        std::size_t body_bytes = 32 * 1024;
+        // Fraction of requests answered with 500 Internal Server Error.
+        double error_rate = 0.0;
+        // Connections served at once; more wait to be accepted.
+        std::size_t threads = 16;
+        // Answers every request instead of the synthetic body and
+        // error_rate when set.
+        Handler handler;
+    };
+
+    struct Stats {
+        std::uint64_t requests = 0;
+        // Complete responses written, errors included.
+        std::uint64_t responses = 0;
+        std::uint64_t errors = 0;
+        // Requests whose client hung up before the response was due.
+        std::uint64_t client_aborts = 0;
+        std::uint64_t bytes_sent = 0;
+    };
+
+    // Listens on an ephemeral port. Throws std::runtime_error if the socket
+    // cannot be set up.
+    explicit LocalHttpServer(Options options);
+    ~LocalHttpServer();
+
+    LocalHttpServer(const LocalHttpServer&) = delete;
+    LocalHttpServer& operator=(const LocalHttpServer&) = delete;
+
+    // "http://127.0.0.1:<port>"
+    std::string base_url() const;
+
+    Stats stats() const;
+    // Whether a request for `path` (including the query) arrived, and
+    // whether its response was written in full.
+    bool received(const std::string& path) const;
+    bool served(const std::string& path) const;
+    // Clears the counters and the request log.
+    void reset();
+
+private:
+    void accept_loop();
+    void handler_loop(std::size_t index);
+    void serve(int fd, std::size_t index);
+    bool wait_for_response(int fd, std::chrono::milliseconds delay);
+
+    const Options options_;
+    const std::string body_;
+    int listen_fd_ = -1;
+    std::uint16_t port_ = 0;
+    std::atomic<bool> stopping_{false};
+
+    std::mutex connections_mutex_;
+    std::condition_variable connections_ready_;
+    std::deque<int> waiting_;
+    // Connections being served, shut down on destruction.
+    std::unordered_set<int> active_;
+
+    mutable std::mutex log_mutex_;
+    Stats stats_;
+    std::unordered_set<std::string> received_;
+    std::unordered_set<std::string> served_;
+
+    std::thread acceptor_;
+    std::vector<std::thread> handlers_;
+};
@@ -0,0 +1,264 @@
+// Offline benchmark of the headless render pipeline.
+//
+// Renders a generated fixture (see fixture.hpp) through SlintMapLibre along
+// scripted camera paths and prints frames/s, per-stage latency percentiles
+// and the process's peak RSS as JSON. Needs no network and no GPU: with
+// Mesa installed, run it with LIBGL_ALWAYS_SOFTWARE=1 (llvmpipe) on a
+// headless Linux box.
+//
+//   maplibre-slint-bench [--frames N] [--width W] [--height H]
+//                        [--scenario NAME] [--fixture DIR] [--output FILE]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_report.hpp"
+#include "fixture.hpp"
+#include "frame_stats.hpp"
+#include "log.hpp"
+#include "slint_maplibre_headless.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int frames = 120;
+    int width = 1024;
+    int height = 768;
+    std::string scenario;  // empty: all
+    std::filesystem::path fixture_dir =
+        std::filesystem::temp_directory_path() / "maplibre-slint-bench";
+    std::string output;  // empty: stdout
+};
+
+struct Scenario {
+    const char* name;
+    mbgl::CameraOptions start;
+    // Applied before frame `i` of `count`.
+    std::function<void(SlintMapLibre&, int i, int count)> step;
+    std::function<void(SlintMapLibre&)> finish;
+};
+
+const mbgl::LatLng kTokyo{35.681, 139.767};
+const mbgl::LatLng kOsaka{34.693, 135.502};
+
+std::vector<Scenario> scenarios(const Options& options) {
+    const float cx = options.width / 2.0f;
+    const float cy = options.height / 2.0f;
+    const auto at = [](mbgl::LatLng center, double zoom) {
+        return mbgl::CameraOptions().withCenter(center).withZoom(zoom);
+    };
+    return {
+        {"static", at(kTokyo, 10.0), nullptr, nullptr},
+        {"pan", at(kTokyo, 10.0),
+         [cx, cy](SlintMapLibre& map, int i, int) {
+             if (i == 0) {
+                 map.handle_mouse_press(cx, cy);
+             }
+             // A steady diagonal drag, 8 px per frame.
+             map.handle_mouse_move(cx - 8.0f * (i + 1), cy - 3.0f * (i + 1),
+                                   true);
+         },
+         [cx, cy](SlintMapLibre& map) { map.handle_mouse_release(cx, cy); }},
+        {"zoom_sweep", at(kTokyo, 2.0),
+         [](SlintMapLibre& map, int i, int count) {
+             const double t = count > 1 ? double(i) / (count - 1) : 0.0;
+             map.get_map()->jumpTo(
+                 mbgl::CameraOptions().withZoom(2.0 + 12.0 * t));
+         },
+         nullptr},
+        {"fly_to", at(kTokyo, 11.0),
+         [flights = 0](SlintMapLibre& map, int, int) mutable {
+             // SlintMapLibre::fly_to() itself, back and forth between Tokyo
+             // and Osaka: a new flight starts once the last one has landed,
+             // and every frame's run_map_loop() advances it. The animation
+             // runs on the wall clock (2.5 s), so slower frames sample it
+             // more coarsely.
+             if (!map.animating()) {
+                 const mbgl::LatLng& to = flights++ % 2 == 0 ? kOsaka : kTokyo;
+                 map.fly_to(to.latitude(), to.longitude(), 11.0);
+             }
+         },
+         [](SlintMapLibre& map) {
+             // Land, so the next scenario's camera is not overridden.
+             while (map.animating()) {
+                 map.run_map_loop();
+                 map.take_repaint_request();
+             }
+         }},
+    };
+}
+
+// Pumps until the map is loaded and has nothing left to do.
+bool settle(SlintMapLibre& map, std::chrono::seconds timeout) {
+    const auto deadline = Clock::now() + timeout;
+    while (Clock::now() < deadline) {
+        const bool busy = map.run_map_loop();
+        map.take_repaint_request();
+        if (!busy && map.get_map()->isFullyLoaded()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// One frame as the embedder sees it: pump until MapLibre renders, then read
+// it back and convert it for Slint. There is no window, so no Upload.
+bool render_frame(SlintMapLibre& map, FrameStats& stats) {
+    map.get_map()->triggerRepaint();
+    const auto deadline = Clock::now() + std::chrono::seconds(2);
+    while (Clock::now() < deadline) {
+        map.run_map_loop();
+        if (map.take_repaint_request()) {
+            map.render_map();
+            stats.end_frame();
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+std::string run_scenario(SlintMapLibre& map, const Scenario& scenario,
+                         const Options& options) {
+    map.get_map()->jumpTo(scenario.start);
+    settle(map, std::chrono::seconds(30));
+
+    auto stats = std::make_shared<FrameStats>(
+        static_cast<std::size_t>(std::max(1, options.frames)));
+    map.set_frame_stats(stats);
+
+    int rendered = 0;
+    const auto start = Clock::now();
+    for (int i = 0; i < options.frames; ++i) {
+        if (scenario.step) {
+            scenario.step(map, i, options.frames);
+        }
+        rendered += render_frame(map, *stats) ? 1 : 0;
+    }
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    if (scenario.finish) {
+        scenario.finish(map);
+    }
+
+    std::string json = "{\"name\":" + json_string(scenario.name) +
+                       ",\"frames\":" + std::to_string(rendered) +
+                       ",\"dropped\":" +
+                       std::to_string(options.frames - rendered) +
+                       ",\"seconds\":" + json_number(seconds) +
+                       ",\"fps\":" +
+                       json_number(seconds > 0.0 ? rendered / seconds : 0.0) +
+                       ",\"allocating_frames\":" +
+                       std::to_string(stats->allocating_frames()) +
+                       ",\"stages\":{";
+    const std::pair<const char*, FrameStage> stages[] = {
+        {"run_loop", FrameStage::RunLoop}, {"render", FrameStage::Render},
+        {"readback", FrameStage::Readback}, {"convert", FrameStage::Convert},
+        {"frame", FrameStage::Frame},
+    };
+    bool first = true;
+    for (const auto& [key, stage] : stages) {
+        json += (first ? "\"" : ",\"") + std::string(key) +
+                "\":" + json_stage(*stats, stage);
+        first = false;
+    }
+    // A high-water mark of the whole process, so it includes the fixture
+    // and every scenario run before this one; --scenario isolates one.
+    json += "},\"process_peak_rss_kib\":" + std::to_string(peak_rss_kib()) +
+            "}";
+    return json;
+}
+
+bool parse(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            std::cerr << "missing value for " << arg << "\n";
+            return false;
+        }
+        if (arg == "--frames") {
+            options.frames = std::atoi(value);
+        } else if (arg == "--width") {
+            options.width = std::atoi(value);
+        } else if (arg == "--height") {
+            options.height = std::atoi(value);
+        } else if (arg == "--scenario") {
+            options.scenario = value;
+        } else if (arg == "--fixture") {
+            options.fixture_dir = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        }
+        ++i;
+    }
+    return options.frames > 0 && options.width > 0 && options.height > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        std::cerr << "usage: maplibre-slint-bench [--frames N] [--width W] "
+                     "[--height H] [--scenario NAME] [--fixture DIR] "
+                     "[--output FILE]\n";
+        return 2;
+    }
+    if (!std::getenv("SLINT_MAPLIBRE_LOG")) {
+        slint_maplibre::log::set_level(slint_maplibre::log::Level::Warning);
+    }
+
+    const BenchFixture fixture = write_bench_fixture(options.fixture_dir);
+    // The map's caches are created in the working directory; start from
+    // empty ones next to the fixture on every run.
+    std::filesystem::current_path(options.fixture_dir);
+    for (const char* cache : {"cache.sqlite", "cache-http.sqlite"}) {
+        std::filesystem::remove(cache);
+    }
+
+    SlintMapLibre map;
+    map.setStyleUrl(fixture.style_url);
+    map.initialize(options.width, options.height);
+    if (!settle(map, std::chrono::seconds(30))) {
+        std::cerr << "fixture style did not load\n";
+        return 1;
+    }
+
+    std::string json = "{\"benchmark\":\"render\",\"width\":" +
+                       std::to_string(options.width) +
+                       ",\"height\":" + std::to_string(options.height) +
+                       ",\"fixture_max_zoom\":" +
+                       std::to_string(fixture.max_zoom) + ",\"scenarios\":[";
+    bool first = true;
+    for (const auto& scenario : scenarios(options)) {
+        if (!options.scenario.empty() && options.scenario != scenario.name) {
+            continue;
+        }
+        json += (first ? "" : ",") + run_scenario(map, scenario, options);
+        first = false;
+    }
+    json += "],\"peak_rss_kib\":" + std::to_string(peak_rss_kib()) + "}\n";
+
+    if (options.output.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.output, std::ios::trunc) << json;
+    }
+    return 0;
+}
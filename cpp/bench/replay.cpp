@@ -0,0 +1,264 @@
+// Replays an interaction trace recorded with MAPLIBRE_TRACE_RECORD against a
+// headless SlintMapLibre and reports frame timings as JSON, the same way the
+// render benchmark does.
+//
+//   maplibre-slint-replay TRACE [--speed recorded|max] [--style URL]
+//                               [--fixture DIR] [--output FILE]
+//
+// The replay starts from the recorded initial camera and style. At recorded
+// speed events are applied at their recorded times and the map is ticked
+// every 16 ms in between, like the application's timer. At max speed events
+// are applied back to back with one tick after each, except that a fly_to()
+// animation is ticked to its end first so the next event starts from the
+// same camera as it did when recorded; tiles are not waited for. --fixture
+// renders the benchmark fixture instead of the recorded style, for runs that
+// must not touch the network.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_report.hpp"
+#include "fixture.hpp"
+#include "frame_stats.hpp"
+#include "interaction_trace.hpp"
+#include "log.hpp"
+#include "slint_maplibre_headless.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kTick = std::chrono::milliseconds(16);
+
+struct Options {
+    std::string trace;
+    bool max_speed = false;
+    std::string style;
+    std::string fixture_dir;
+    std::string output;  // empty: stdout
+};
+
+bool parse(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            options.trace = arg;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            std::cerr << "missing value for " << arg << "\n";
+            return false;
+        }
+        if (arg == "--speed") {
+            const std::string speed = value;
+            if (speed != "recorded" && speed != "max") {
+                std::cerr << "--speed is 'recorded' or 'max'\n";
+                return false;
+            }
+            options.max_speed = speed == "max";
+        } else if (arg == "--style") {
+            options.style = value;
+        } else if (arg == "--fixture") {
+            options.fixture_dir = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        }
+        ++i;
+    }
+    return !options.trace.empty();
+}
+
+class Replayer {
+public:
+    explicit Replayer(SlintMapLibre& map) : map_(map) {
+    }
+
+    // One tick of the application's render timer.
+    bool tick() {
+        const bool busy = map_.run_map_loop();
+        if (map_.take_repaint_request()) {
+            map_.render_map();
+            map_.frame_stats()->end_frame();
+            ++frames_;
+        }
+        return busy;
+    }
+
+    // Ticks until `until`, at the timer's pace.
+    void tick_until(Clock::time_point until) {
+        while (Clock::now() < until) {
+            const auto next = Clock::now() + kTick;
+            tick();
+            std::this_thread::sleep_until(std::min(next, until));
+        }
+    }
+
+    // Ticks back to back until a fly_to() animation has ended.
+    void finish_animation() {
+        while (map_.animating()) {
+            tick();
+        }
+    }
+
+    // Ticks until the map has nothing left to do.
+    bool settle(std::chrono::seconds timeout) {
+        const auto deadline = Clock::now() + timeout;
+        while (Clock::now() < deadline) {
+            if (!tick() && map_.get_map()->isFullyLoaded()) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    int frames() const {
+        return frames_;
+    }
+
+private:
+    SlintMapLibre& map_;
+    int frames_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        std::cerr << "usage: maplibre-slint-replay TRACE "
+                     "[--speed recorded|max] [--style URL] [--fixture DIR] "
+                     "[--output FILE]\n";
+        return 2;
+    }
+    if (!std::getenv("SLINT_MAPLIBRE_LOG")) {
+        slint_maplibre::log::set_level(slint_maplibre::log::Level::Warning);
+    }
+
+    std::vector<TraceEvent> events;
+    try {
+        events = read_trace(options.trace);
+    } catch (const std::exception& e) {
+        std::cerr << options.trace << ": " << e.what() << "\n";
+        return 1;
+    }
+
+    // The first recorded size is what the application initialized with,
+    // and the first initial state where the camera and style started.
+    int width = 1024;
+    int height = 768;
+    const TraceEvent* initial = nullptr;
+    bool sized = false;
+    for (const auto& event : events) {
+        if (event.kind == TraceEvent::Kind::Resize && !sized) {
+            width = static_cast<int>(event.args[0]);
+            height = static_cast<int>(event.args[1]);
+            sized = true;
+        } else if (event.kind == TraceEvent::Kind::InitialState && !initial) {
+            initial = &event;
+        }
+    }
+
+    SlintMapLibre map;
+    if (!options.fixture_dir.empty()) {
+        map.setStyleUrl(write_bench_fixture(options.fixture_dir).style_url);
+    } else if (!options.style.empty()) {
+        map.setStyleUrl(options.style);
+    } else if (initial && !initial->text.empty()) {
+        map.setStyleUrl(initial->text);
+    }
+    map.initialize(width, height);
+    if (initial) {
+        const auto& a = initial->args;
+        map.get_map()->jumpTo(mbgl::CameraOptions()
+                                  .withCenter(mbgl::LatLng{a[0], a[1]})
+                                  .withZoom(static_cast<double>(a[2]))
+                                  .withBearing(static_cast<double>(a[3]))
+                                  .withPitch(static_cast<double>(a[4])));
+    }
+
+    Replayer replayer(map);
+    if (!replayer.settle(std::chrono::seconds(30))) {
+        std::cerr << "warning: the style did not finish loading\n";
+    }
+    // Percentiles over the whole replay, not just the last few seconds.
+    map.set_frame_stats(std::make_shared<FrameStats>(1 << 16));
+    const int frames_before = replayer.frames();
+
+    const auto start = Clock::now();
+    for (const auto& event : events) {
+        if (!options.max_speed) {
+            replayer.tick_until(start + event.time);
+        }
+        // A style pinned with --style or --fixture ignores recorded changes.
+        if (event.kind == TraceEvent::Kind::StyleChange &&
+            (!options.style.empty() || !options.fixture_dir.empty())) {
+            continue;
+        }
+        apply_trace_event(map, event);
+        if (options.max_speed) {
+            replayer.tick();
+            replayer.finish_animation();
+        }
+    }
+    const auto events_done = Clock::now();
+    const bool settled = replayer.settle(std::chrono::seconds(30));
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    const int frames = replayer.frames() - frames_before;
+
+    const auto stats = map.frame_stats();
+    const std::pair<const char*, FrameStage> stages[] = {
+        {"run_loop", FrameStage::RunLoop}, {"render", FrameStage::Render},
+        {"readback", FrameStage::Readback}, {"convert", FrameStage::Convert},
+        {"frame", FrameStage::Frame},
+    };
+    std::string json =
+        "{\"benchmark\":\"replay\",\"trace\":" + json_string(options.trace) +
+        ",\"speed\":" + json_string(options.max_speed ? "max" : "recorded") +
+        ",\"width\":" + std::to_string(width) +
+        ",\"height\":" + std::to_string(height) +
+        ",\"events\":" + std::to_string(events.size()) +
+        ",\"recorded_seconds\":" +
+        json_number(events.empty()
+                        ? 0.0
+                        : std::chrono::duration<double>(events.back().time)
+                              .count()) +
+        ",\"replay_seconds\":" +
+        json_number(std::chrono::duration<double>(events_done - start)
+                        .count()) +
+        ",\"seconds\":" + json_number(seconds) +
+        ",\"settled\":" + (settled ? "true" : "false") +
+        ",\"frames\":" + std::to_string(frames) + ",\"fps\":" +
+        json_number(seconds > 0.0 ? frames / seconds : 0.0) +
+        ",\"allocating_frames\":" +
+        std::to_string(stats->allocating_frames()) +
+        ",\"copied_bytes\":" + std::to_string(stats->copied_bytes()) +
+        ",\"stages\":{";
+    bool first = true;
+    for (const auto& [key, stage] : stages) {
+        json += (first ? "\"" : ",\"") + std::string(key) +
+                "\":" + json_stage(*stats, stage);
+        first = false;
+    }
+    json += "},\"peak_rss_kib\":" + std::to_string(peak_rss_kib()) + "}\n";
+
+    if (options.output.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.output, std::ios::trunc) << json;
+    }
+    return 0;
+}
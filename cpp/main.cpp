@@ -1,112 +1,365 @@
-#include <iostream>
+#include <chrono>
+#include <cstdlib>
 #include <memory>
+#include <string>
 
+#include "frame_stats.hpp"
+#include "interaction_trace.hpp"
+#include "log.hpp"
 #include "map_window.h"
 #include "slint_maplibre_headless.hpp"
+#include "slint_maplibre_render_thread.hpp"
 
-int main(int argc, char** argv) {
-    std::cout << "[main] Starting application" << std::endl;
-    auto main_window = MapWindow::create();
-    auto slint_map = std::make_shared<SlintMapLibre>();
+namespace {
 
-    auto initialized = std::make_shared<bool>(false);
+// Set MAPLIBRE_RENDER_THREAD=1 to render on a background thread.
+bool use_render_thread() {
+    const char* value = std::getenv("MAPLIBRE_RENDER_THREAD");
+    return value && *value && std::string(value) != "0";
+}
 
-    // Render: read frame from MapLibre and push to MMapAdapter
-    auto render_function = [=]() {
-        auto image = slint_map->render_map();
-        main_window->global<MMapAdapter>().set_frame(image);
+// Set MAPLIBRE_TRACE_RECORD=<file> to record the session's interactions for
+// maplibre-slint-replay.
+std::shared_ptr<TraceRecorder> trace_recorder() {
+    const char* path = std::getenv("MAPLIBRE_TRACE_RECORD");
+    if (!path || !*path) {
+        return nullptr;
+    }
+    try {
+        SLINT_MAPLIBRE_LOG(Info, "main", "Recording interactions to " << path);
+        return std::make_shared<TraceRecorder>(path);
+    } catch (const std::exception& e) {
+        SLINT_MAPLIBRE_LOG(Error, "main", e.what());
+        return nullptr;
+    }
+}
 
-        // Update reactive camera state
-        if (auto* m = slint_map->get_map()) {
-            const auto cam = m->getCameraOptions();
-            if (cam.center) {
-                main_window->global<MMapAdapter>().set_current_lat(
-                    static_cast<float>(cam.center->latitude()));
-                main_window->global<MMapAdapter>().set_current_lon(
-                    static_cast<float>(cam.center->longitude()));
-            }
-            if (cam.zoom)
-                main_window->global<MMapAdapter>().set_current_zoom(
-                    static_cast<float>(*cam.zoom));
-            if (cam.bearing)
-                main_window->global<MMapAdapter>().set_current_bearing(
-                    static_cast<float>(*cam.bearing));
-            if (cam.pitch)
-                main_window->global<MMapAdapter>().set_current_pitch(
-                    static_cast<float>(*cam.pitch));
+// Where a recording starts from, recorded once the map is initialized so a
+// replay can restore it before the first interaction.
+TraceEvent initial_state(const SlintMapLibre& map) {
+    TraceEvent event{TraceEvent::Kind::InitialState, {}, false,
+                     map.style_url()};
+    if (const auto* m = map.get_map()) {
+        const auto cam = m->getCameraOptions();
+        if (cam.center) {
+            event.args[0] = static_cast<float>(cam.center->latitude());
+            event.args[1] = static_cast<float>(cam.center->longitude());
         }
+        event.args[2] = static_cast<float>(cam.zoom.value_or(0.0));
+        event.args[3] = static_cast<float>(cam.bearing.value_or(0.0));
+        event.args[4] = static_cast<float>(cam.pitch.value_or(0.0));
+    }
+    return event;
+}
+
+// The render thread initializes asynchronously; until its first frame the
+// camera is the one every map starts with.
+TraceEvent initial_state(const SlintMapLibreRenderThread& map) {
+    const auto camera = map.camera();
+    return {TraceEvent::Kind::InitialState,
+            {static_cast<float>(camera.latitude),
+             static_cast<float>(camera.longitude),
+             static_cast<float>(camera.zoom),
+             static_cast<float>(camera.bearing),
+             static_cast<float>(camera.pitch)},
+            false,
+            map.style_url()};
+}
+
+// Copies the frame timings into MMapAdapter if the UI asked for them, at
+// most twice a second. UI thread only.
+void publish_frame_stats(const MMapAdapter& adapter, const FrameStats& stats) {
+    using Clock = FrameStats::Clock;
+    static Clock::time_point last_publish{};
+    const auto now = Clock::now();
+    if (!adapter.get_frame_stats_enabled() ||
+        now - last_publish < std::chrono::milliseconds(500)) {
+        return;
+    }
+    last_publish = now;
+    auto p95 = [&](FrameStage stage) {
+        return static_cast<float>(stats.summary(stage).p95_ms);
     };
+    const auto frame = stats.summary(FrameStage::Frame);
+    adapter.set_frame_p50_ms(static_cast<float>(frame.p50_ms));
+    adapter.set_frame_p95_ms(static_cast<float>(frame.p95_ms));
+    adapter.set_frame_p99_ms(static_cast<float>(frame.p99_ms));
+    adapter.set_run_loop_p95_ms(p95(FrameStage::RunLoop));
+    adapter.set_render_p95_ms(p95(FrameStage::Render));
+    adapter.set_readback_p95_ms(p95(FrameStage::Readback));
+    adapter.set_convert_p95_ms(p95(FrameStage::Convert));
+    adapter.set_upload_p95_ms(p95(FrameStage::Upload));
+}
 
-    slint_map->setRenderCallback(render_function);
+// Input, commands and sizing are the same for the inline map and the render
+// thread, which mirrors SlintMapLibre's interface.
+template <typename Map>
+void connect_map(const slint::ComponentHandle<MapWindow>& main_window,
+                 const std::shared_ptr<Map>& slint_map) {
+    auto initialized = std::make_shared<bool>(false);
 
-    // Render loop tick
-    main_window->global<MMapAdapter>().on_tick([=]() {
-        slint_map->run_map_loop();
-        if (slint_map->take_repaint_request() ||
-            slint_map->consume_forced_repaint()) {
-            render_function();
+    // Interactions and commands go through apply_trace_event(), which is
+    // also what replays a recorded trace, so a replay drives the map the
+    // same way.
+    auto recorder = trace_recorder();
+    auto handle = [=](TraceEvent event) {
+        if (recorder) {
+            recorder->record(event);
         }
-    });
+        apply_trace_event(*slint_map, event);
+    };
+    using Kind = TraceEvent::Kind;
 
     // User interactions
     main_window->global<MMapAdapter>().on_mouse_pressed(
-        [=](float x, float y) { slint_map->handle_mouse_press(x, y); });
+        [=](float x, float y) { handle({Kind::MousePress, {x, y}}); });
 
     main_window->global<MMapAdapter>().on_mouse_released(
-        [=](float x, float y) { slint_map->handle_mouse_release(x, y); });
+        [=](float x, float y) { handle({Kind::MouseRelease, {x, y}}); });
 
     main_window->global<MMapAdapter>().on_mouse_moved(
-        [=](float x, float y) { slint_map->handle_mouse_move(x, y, true); });
+        [=](float x, float y) { handle({Kind::MouseMove, {x, y}}); });
 
     main_window->global<MMapAdapter>().on_double_clicked(
         [=](float x, float y, bool shift) {
-            slint_map->handle_double_click(x, y, shift);
+            handle({Kind::DoubleClick, {x, y}, shift});
         });
 
     main_window->global<MMapAdapter>().on_wheel_zoomed(
         [=](float x, float y, float dy) {
-            slint_map->handle_wheel_zoom(x, y, dy);
+            handle({Kind::WheelZoom, {x, y, dy}});
         });
 
     // Commands
     main_window->global<MMapAdapter>().on_request_style_change(
         [=](const slint::SharedString& url) {
-            slint_map->setStyleUrl(std::string(url.data(), url.size()));
+            handle({Kind::StyleChange, {}, false,
+                    std::string(url.data(), url.size())});
         });
 
     main_window->global<MMapAdapter>().on_request_fly_to(
         [=](float lat, float lon, float zoom) {
-            slint_map->fly_to(static_cast<double>(lat),
-                              static_cast<double>(lon),
-                              static_cast<double>(zoom));
+            handle({Kind::FlyTo, {lat, lon, zoom}});
         });
 
     main_window->global<MMapAdapter>().on_request_pitch_change(
-        [=](float pitch) {
-            slint_map->set_pitch(static_cast<int>(pitch / 60.0f * 100.0f));
-        });
+        [=](float pitch) { handle({Kind::PitchChange, {pitch}}); });
 
     main_window->global<MMapAdapter>().on_request_bearing_change(
-        [=](float bearing) {
-            slint_map->set_bearing(bearing / 360.0f * 100.0f);
+        [=](float bearing) { handle({Kind::BearingChange, {bearing}}); });
+
+    // Offline region seeding. Estimates and progress arrive on other
+    // threads and are handed to the UI thread.
+    slint::ComponentWeakHandle<MapWindow> weak_window(main_window);
+    auto bounds = [](float south, float west, float north, float east) {
+        return mbgl::LatLngBounds::hull({south, west}, {north, east});
+    };
+
+    main_window->global<MMapAdapter>().on_request_seed_estimate(
+        [=](float south, float west, float north, float east, float first,
+            float last) {
+            slint_map->estimate_region(
+                bounds(south, west, north, east), first, last,
+                [weak_window](const mbgl::RegionSeeder::Estimate& estimate) {
+                    slint::invoke_from_event_loop([weak_window, estimate]() {
+                        if (auto window = weak_window.lock()) {
+                            const auto& adapter =
+                                (*window)->global<MMapAdapter>();
+                            adapter.set_seed_estimated_tiles(
+                                static_cast<int>(estimate.tiles));
+                            adapter.set_seed_estimated_megabytes(
+                                static_cast<float>(estimate.bytes / 1.0e6));
+                        }
+                    });
+                });
+        });
+
+    main_window->global<MMapAdapter>().on_request_seed_region(
+        [=](float south, float west, float north, float east, float first,
+            float last) {
+            main_window->global<MMapAdapter>().set_seed_active(true);
+            main_window->global<MMapAdapter>().set_seed_complete(false);
+            main_window->global<MMapAdapter>().set_seed_error("");
+            slint_map->seed_region(
+                bounds(south, west, north, east), first, last,
+                [weak_window](const mbgl::RegionSeeder::Progress& progress) {
+                    slint::invoke_from_event_loop([weak_window, progress]() {
+                        if (auto window = weak_window.lock()) {
+                            const auto& adapter =
+                                (*window)->global<MMapAdapter>();
+                            adapter.set_seed_active(progress.active);
+                            adapter.set_seed_complete(progress.complete);
+                            adapter.set_seed_completed_resources(
+                                static_cast<int>(progress.completedResources));
+                            adapter.set_seed_required_resources(
+                                static_cast<int>(progress.requiredResources));
+                            adapter.set_seed_downloaded_megabytes(
+                                static_cast<float>(progress.completedBytes /
+                                                   1.0e6));
+                            adapter.set_seed_error(
+                                slint::SharedString(progress.error));
+                        }
+                    });
+                });
         });
 
+    main_window->global<MMapAdapter>().on_request_seed_cancel([=]() {
+        slint_map->cancel_seeding();
+        main_window->global<MMapAdapter>().set_seed_active(false);
+    });
+
     // Initialize/resize when map area size changes
     main_window->on_map_size_changed([=]() {
         const auto s = main_window->get_map_size();
         const int w = static_cast<int>(s.width);
         const int h = static_cast<int>(s.height);
         if (w > 0 && h > 0) {
+            if (recorder) {
+                recorder->record({Kind::Resize, {s.width, s.height}});
+            }
             if (!*initialized) {
                 slint_map->initialize(w, h);
                 *initialized = true;
+                if (recorder) {
+                    recorder->record(initial_state(*slint_map));
+                }
             } else {
                 slint_map->resize(w, h);
             }
         }
     });
+}
+
+// The map lives on the UI thread and is pumped from MMapAdapter.tick.
+void run_inline(const slint::ComponentHandle<MapWindow>& main_window) {
+    auto slint_map = std::make_shared<SlintMapLibre>();
+
+    // Render: read frame from MapLibre and push to MMapAdapter
+    auto render_function = [=]() {
+        auto image = slint_map->render_map();
+        const auto stats = slint_map->frame_stats();
+        {
+            const auto timer = stats->time(FrameStage::Upload);
+            main_window->global<MMapAdapter>().set_frame(image);
+        }
+        stats->end_frame();
+        publish_frame_stats(main_window->global<MMapAdapter>(), *stats);
+
+        // Update reactive camera state
+        if (auto* m = slint_map->get_map()) {
+            const auto cam = m->getCameraOptions();
+            if (cam.center) {
+                main_window->global<MMapAdapter>().set_current_lat(
+                    static_cast<float>(cam.center->latitude()));
+                main_window->global<MMapAdapter>().set_current_lon(
+                    static_cast<float>(cam.center->longitude()));
+            }
+            if (cam.zoom)
+                main_window->global<MMapAdapter>().set_current_zoom(
+                    static_cast<float>(*cam.zoom));
+            if (cam.bearing)
+                main_window->global<MMapAdapter>().set_current_bearing(
+                    static_cast<float>(*cam.bearing));
+            if (cam.pitch)
+                main_window->global<MMapAdapter>().set_current_pitch(
+                    static_cast<float>(*cam.pitch));
+        }
+    };
+
+    slint_map->setRenderCallback(render_function);
+
+    // Restart the tick when an idle map gets work (input, network responses).
+    slint::ComponentWeakHandle<MapWindow> weak_window(main_window);
+    slint_map->set_wake_callback([weak_window]() {
+        slint::invoke_from_event_loop([weak_window]() {
+            if (auto window = weak_window.lock()) {
+                (*window)->global<MMapAdapter>().set_render_loop_active(true);
+            }
+        });
+    });
+
+    // Render loop tick; stops itself once the map has nothing left to do.
+    main_window->global<MMapAdapter>().on_tick([=]() {
+        const bool busy = slint_map->run_map_loop();
+        // Only read back when MapLibre actually rendered something new.
+        if (slint_map->take_repaint_request()) {
+            render_function();
+        }
+        main_window->global<MMapAdapter>().set_render_loop_active(busy);
+    });
+
+    connect_map(main_window, slint_map);
+}
+
+// The map renders on its own thread; the UI thread only turns finished
+// frames into images.
+void run_threaded(const slint::ComponentHandle<MapWindow>& main_window) {
+    slint::ComponentWeakHandle<MapWindow> weak_window(main_window);
+    // Filled in below; the callback must not keep the thread alive itself.
+    auto weak_map =
+        std::make_shared<std::weak_ptr<SlintMapLibreRenderThread>>();
+
+    auto slint_map = std::make_shared<SlintMapLibreRenderThread>(
+        [weak_window, weak_map]() {
+            slint::invoke_from_event_loop([weak_window, weak_map]() {
+                auto window = weak_window.lock();
+                auto map = weak_map->lock();
+                if (!window || !map) {
+                    return;
+                }
+                // A frame published while the previous notification was
+                // being handled is announced twice; the second finds nothing
+                // and must leave the displayed frame alone.
+                const auto* frame = map->take_frame();
+                if (!frame) {
+                    return;
+                }
+                const auto& adapter = (*window)->global<MMapAdapter>();
+                // take_frame() handed the displayed frame's pixels back to
+                // the render thread. Let go of them right away, or its next
+                // write copies the whole buffer instead of reusing it.
+                adapter.set_frame(slint::Image());
+                const auto stats = map->frame_stats();
+                {
+                    const auto timer = stats->time(FrameStage::Upload);
+                    adapter.set_frame(slint::Image(frame->pixels));
+                }
+                stats->end_frame();
+                publish_frame_stats(adapter, *stats);
+                adapter.set_current_lat(
+                    static_cast<float>(frame->camera.latitude));
+                adapter.set_current_lon(
+                    static_cast<float>(frame->camera.longitude));
+                adapter.set_current_zoom(
+                    static_cast<float>(frame->camera.zoom));
+                adapter.set_current_bearing(
+                    static_cast<float>(frame->camera.bearing));
+                adapter.set_current_pitch(
+                    static_cast<float>(frame->camera.pitch));
+            });
+        });
+    *weak_map = slint_map;
+
+    // The render thread paces itself; the UI timer has nothing to drive.
+    main_window->global<MMapAdapter>().set_render_loop_active(false);
+
+    connect_map(main_window, slint_map);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    SLINT_MAPLIBRE_LOG(Info, "main", "Starting application");
+    auto main_window = MapWindow::create();
+
+    if (use_render_thread()) {
+        SLINT_MAPLIBRE_LOG(Info, "main", "Rendering on a background thread");
+        run_threaded(main_window);
+    } else {
+        run_inline(main_window);
+    }
 
-    std::cout << "[main] Entering UI event loop" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "main", "Entering UI event loop");
     main_window->run();
     return 0;
 }
@@ -1,16 +1,42 @@
 #include <GLES3/gl3.h>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
-#include <iostream>
 #include <memory>
 #include <slint.h>
 #include <string>
 
 #include "gl_map_window.h"
+#include "log.hpp"
 #include "slint_map_gl.hpp"
 
+namespace {
+
+// Copies the frame timings into MMapAdapter if the UI asked for them, at
+// most twice a second. There is no readback, conversion or upload here.
+void publish_frame_stats(const MMapAdapter& adapter, const FrameStats& stats) {
+    using Clock = FrameStats::Clock;
+    static Clock::time_point last_publish{};
+    const auto now = Clock::now();
+    if (!adapter.get_frame_stats_enabled() ||
+        now - last_publish < std::chrono::milliseconds(500)) {
+        return;
+    }
+    last_publish = now;
+    const auto frame = stats.summary(FrameStage::Frame);
+    adapter.set_frame_p50_ms(static_cast<float>(frame.p50_ms));
+    adapter.set_frame_p95_ms(static_cast<float>(frame.p95_ms));
+    adapter.set_frame_p99_ms(static_cast<float>(frame.p99_ms));
+    adapter.set_run_loop_p95_ms(
+        static_cast<float>(stats.summary(FrameStage::RunLoop).p95_ms));
+    adapter.set_render_p95_ms(
+        static_cast<float>(stats.summary(FrameStage::Render).p95_ms));
+}
+
+}  // namespace
+
 int main(int /*argc*/, char** /*argv*/) {
-    std::cout << "[main_gl] Starting zero-copy GL application" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "main_gl", "Starting zero-copy GL application");
 
     auto win = MapWindow::create();
     auto smap = std::make_shared<SlintMapGL>();
@@ -41,9 +67,9 @@ int main(int /*argc*/, char** /*argv*/) {
         switch (state) {
         case slint::RenderingState::RenderingSetup: {
             if (api != slint::GraphicsAPI::NativeOpenGL) {
-                std::cout << "[main_gl] WARNING: GraphicsAPI is not "
-                             "NativeOpenGL; zero-copy GL path unavailable"
-                          << std::endl;
+                SLINT_MAPLIBRE_LOG(Warning, "main_gl",
+                                   "GraphicsAPI is not NativeOpenGL; "
+                                   "zero-copy GL path unavailable");
                 return;
             }
 
@@ -56,9 +82,10 @@ int main(int /*argc*/, char** /*argv*/) {
                         : (ps.height > 0 ? static_cast<int>(ps.height) : 720);
             *Wp = w;
             *Hp = h;
-            std::cout << "[main_gl] RenderingSetup: NativeOpenGL acquired, "
-                         "render size "
-                      << w << "x" << h << std::endl;
+            SLINT_MAPLIBRE_LOG(Info, "main_gl",
+                               "RenderingSetup: NativeOpenGL acquired, "
+                               "render size "
+                                   << w << "x" << h);
 
             glGenTextures(1, tex.get());
             glBindTexture(GL_TEXTURE_2D, *tex);
@@ -82,11 +109,12 @@ int main(int /*argc*/, char** /*argv*/) {
                                       GL_RENDERBUFFER, *rbo);
 
             GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-            std::cout << "[main_gl] FBO status="
-                      << (status == GL_FRAMEBUFFER_COMPLETE
-                              ? "GL_FRAMEBUFFER_COMPLETE"
-                              : std::to_string(status))
-                      << " fbo=" << *fbo << " tex=" << *tex << std::endl;
+            SLINT_MAPLIBRE_LOG(Info, "main_gl",
+                               "FBO status="
+                                   << (status == GL_FRAMEBUFFER_COMPLETE
+                                           ? "GL_FRAMEBUFFER_COMPLETE"
+                                           : std::to_string(status))
+                                   << " fbo=" << *fbo << " tex=" << *tex);
 
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -115,7 +143,7 @@ int main(int /*argc*/, char** /*argv*/) {
             GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
             GLboolean cull = glIsEnabled(GL_CULL_FACE);
 
-            smap->render();
+            const bool rendered = smap->render();
 
             glBindFramebuffer(GL_FRAMEBUFFER, pf);
             glViewport(vp[0], vp[1], vp[2], vp[3]);
@@ -140,18 +168,25 @@ int main(int /*argc*/, char** /*argv*/) {
             else
                 glDisable(GL_CULL_FACE);
 
-            win->global<MMapAdapter>().set_frame(
-                slint::Image::create_from_borrowed_gl_2d_rgba_texture(
-                    *tex,
-                    {static_cast<uint32_t>(*Wp), static_cast<uint32_t>(*Hp)},
-                    slint::Image::BorrowedOpenGLTextureOrigin::BottomLeft));
-            win->window().request_redraw();
+            // Re-publish the texture only when the map changed; the next
+            // redraw is requested from the tick once the map changes.
+            if (rendered) {
+                win->global<MMapAdapter>().set_frame(
+                    slint::Image::create_from_borrowed_gl_2d_rgba_texture(
+                        *tex,
+                        {static_cast<uint32_t>(*Wp),
+                         static_cast<uint32_t>(*Hp)},
+                        slint::Image::BorrowedOpenGLTextureOrigin::BottomLeft));
+                smap->frame_stats()->end_frame();
+                publish_frame_stats(win->global<MMapAdapter>(),
+                                    *smap->frame_stats());
+            }
             break;
         }
         case slint::RenderingState::AfterRendering:
             break;
         case slint::RenderingState::RenderingTeardown: {
-            std::cout << "[main_gl] RenderingTeardown" << std::endl;
+            SLINT_MAPLIBRE_LOG(Info, "main_gl", "RenderingTeardown");
             if (*fbo)
                 glDeleteFramebuffers(1, fbo.get());
             if (*rbo)
@@ -165,6 +200,25 @@ int main(int /*argc*/, char** /*argv*/) {
         }
     });
 
+    // Pump MapLibre from the MMapView timer and redraw only when the map
+    // changed, so an idle map costs no GPU time. The timer itself stops once
+    // the map settles and is restarted from the wake callback.
+    slint::ComponentWeakHandle<MapWindow> weak_win(win);
+    smap->set_wake_callback([weak_win]() {
+        slint::invoke_from_event_loop([weak_win]() {
+            if (auto w = weak_win.lock()) {
+                (*w)->global<MMapAdapter>().set_render_loop_active(true);
+            }
+        });
+    });
+    win->global<MMapAdapter>().on_tick([=]() {
+        const bool busy = smap->run_map_loop();
+        if (*gl_ready && smap->needs_render()) {
+            win->window().request_redraw();
+        }
+        win->global<MMapAdapter>().set_render_loop_active(busy);
+    });
+
     // Touch / pointer interaction (Slint delivers touch via libinput as pointer
     // events; the MMapView forwards them through these MMapAdapter callbacks).
     win->global<MMapAdapter>().on_mouse_pressed(
@@ -193,9 +247,60 @@ int main(int /*argc*/, char** /*argv*/) {
     win->global<MMapAdapter>().on_request_bearing_change(
         [=](float b) { smap->set_bearing(b); });
 
+    // Offline region seeding; estimates and progress are handed to the UI
+    // thread.
+    auto bounds = [](float south, float west, float north, float east) {
+        return mbgl::LatLngBounds::hull({south, west}, {north, east});
+    };
+    win->global<MMapAdapter>().on_request_seed_estimate(
+        [=](float s, float w, float n, float e, float first, float last) {
+            smap->estimate_region(
+                bounds(s, w, n, e), first, last,
+                [weak_win](const mbgl::RegionSeeder::Estimate& estimate) {
+                    slint::invoke_from_event_loop([weak_win, estimate]() {
+                        if (auto window = weak_win.lock()) {
+                            const auto& a = (*window)->global<MMapAdapter>();
+                            a.set_seed_estimated_tiles(
+                                static_cast<int>(estimate.tiles));
+                            a.set_seed_estimated_megabytes(
+                                static_cast<float>(estimate.bytes / 1.0e6));
+                        }
+                    });
+                });
+        });
+    win->global<MMapAdapter>().on_request_seed_region(
+        [=](float s, float w, float n, float e, float first, float last) {
+            win->global<MMapAdapter>().set_seed_active(true);
+            win->global<MMapAdapter>().set_seed_complete(false);
+            win->global<MMapAdapter>().set_seed_error("");
+            smap->seed_region(
+                bounds(s, w, n, e), first, last,
+                [weak_win](const mbgl::RegionSeeder::Progress& progress) {
+                    slint::invoke_from_event_loop([weak_win, progress]() {
+                        if (auto window = weak_win.lock()) {
+                            const auto& a = (*window)->global<MMapAdapter>();
+                            a.set_seed_active(progress.active);
+                            a.set_seed_complete(progress.complete);
+                            a.set_seed_completed_resources(
+                                static_cast<int>(progress.completedResources));
+                            a.set_seed_required_resources(
+                                static_cast<int>(progress.requiredResources));
+                            a.set_seed_downloaded_megabytes(static_cast<float>(
+                                progress.completedBytes / 1.0e6));
+                            a.set_seed_error(
+                                slint::SharedString(progress.error));
+                        }
+                    });
+                });
+        });
+    win->global<MMapAdapter>().on_request_seed_cancel([=]() {
+        smap->cancel_seeding();
+        win->global<MMapAdapter>().set_seed_active(false);
+    });
+
     win->on_map_size_changed([=]() {});
 
-    std::cout << "[main_gl] Entering UI event loop" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "main_gl", "Entering UI event loop");
     win->run();
     return 0;
 }
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <mbgl/util/chrono.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace mbgl {
+
+// A cached HTTP response body with the freshness lifetime and validators the
+// server sent, shared by CustomFileSource's memory and disk caches.
+struct CacheEntry {
+    std::shared_ptr<const std::string> data;
+    std::optional<std::string> etag;
+    std::optional<Timestamp> modified;
+    // No value: the entry has no freshness lifetime and must be revalidated
+    // before every use.
+    std::optional<Timestamp> expires;
+    bool mustRevalidate = false;
+
+    bool isFresh(Timestamp now) const {
+        return expires && *expires > now;
+    }
+};
+
+}  // namespace mbgl
@@ -1,86 +1,1508 @@
 #include "custom_file_source.hpp"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cpr/cpr.h>
+#include <curl/curl.h>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <mbgl/actor/scheduler.hpp>
+#include <mbgl/storage/file_source_manager.hpp>
 #include <mbgl/storage/response.hpp>
-#include <mbgl/util/thread.hpp>
+#include <mbgl/util/tileset.hpp>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "disk_cache.hpp"
+#include "log.hpp"
+#include "memory_cache.hpp"
+#include "retry_policy.hpp"
+#include "tile_archive.hpp"
+#include "token_bucket.hpp"
+
 namespace mbgl {
 
+namespace {
+
+constexpr auto kConnectTimeout = std::chrono::seconds(10);
+// How long a host is left alone after a 429/503 without Retry-After; the same
+// default mbgl's own file source uses.
+constexpr auto kDefaultRetryAfter = std::chrono::seconds(5);
+// Shortest back-off after a 429, whatever the server asked for: a
+// Retry-After of 0 or a date in the past must not turn into a tight loop.
+constexpr auto kMinRetryAfter = std::chrono::seconds(1);
+// Attempts at a rate-limited transfer before its requests get the RateLimit
+// error; the requeued attempts wait 1 s, 2 s, ... in between.
+constexpr std::uint32_t kMaxRateLimitedAttempts = 3;
+// x-rate-limit-reset values below this many seconds cannot be an epoch time
+// in this century; some servers send a delay in seconds instead.
+constexpr long long kEpochResetThreshold = 1000000000;
+// Smallest burst of the bandwidth limiter, so that a low limit still lets a
+// typical tile through in one go.
+constexpr std::uint64_t kMinBandwidthBurst = 64 * 1024;
+// Longest uninterrupted sleep of a throttled transfer, so that cancelling it
+// or shutting down is not held up by the bandwidth limit.
+constexpr auto kThrottleSlice = std::chrono::milliseconds(10);
+
+// DNS results and TLS sessions shared by all worker sessions, so a new
+// connection to an already-seen host skips the lookup and the full TLS
+// handshake. libcurl does not support sharing the connection cache itself
+// between concurrently running threads; each worker keeps its own.
+class SharedCurlState {
+public:
+    SharedCurlState() : share(curl_share_init()) {
+        if (!share) {
+            return;
+        }
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &SharedCurlState::lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC,
+                          &SharedCurlState::unlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    ~SharedCurlState() {
+        if (share) {
+            curl_share_cleanup(share);
+        }
+    }
+
+    void attach(cpr::Session& session) {
+        if (share) {
+            curl_easy_setopt(session.GetCurlHolder()->handle, CURLOPT_SHARE,
+                             share);
+        }
+    }
+
+private:
+    static void lock(CURL*, curl_lock_data data, curl_lock_access, void* self) {
+        static_cast<SharedCurlState*>(self)->mutexes[data].lock();
+    }
+
+    static void unlock(CURL*, curl_lock_data data, void* self) {
+        static_cast<SharedCurlState*>(self)->mutexes[data].unlock();
+    }
+
+    CURLSH* share;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> mutexes;
+};
+
+// Freshness lifetime and validators of a 2xx or 304 response, following
+// RFC 9111 for a private cache. `storable` is false for no-store.
+CacheEntry cacheMetadata(const cpr::Header& header, bool& storable) {
+    CacheEntry entry;
+    storable = true;
+    const Timestamp now = util::now();
+
+    if (auto it = header.find("ETag"); it != header.end()) {
+        entry.etag = it->second;
+    }
+    if (auto it = header.find("Last-Modified"); it != header.end()) {
+        entry.modified = util::parseTimestamp(it->second.c_str());
+    }
+
+    std::optional<long long> maxAge;
+    bool noCache = false;
+    if (auto it = header.find("Cache-Control"); it != header.end()) {
+        std::string directives = it->second;
+        std::transform(directives.begin(), directives.end(),
+                       directives.begin(), [](unsigned char c) {
+                           return static_cast<char>(std::tolower(c));
+                       });
+        std::size_t pos = 0;
+        while (pos < directives.size()) {
+            std::size_t end = directives.find(',', pos);
+            if (end == std::string::npos) {
+                end = directives.size();
+            }
+            std::string directive = directives.substr(pos, end - pos);
+            directive.erase(0, directive.find_first_not_of(" \t"));
+            directive.erase(directive.find_last_not_of(" \t") + 1);
+            pos = end + 1;
+
+            if (directive == "no-store") {
+                storable = false;
+            } else if (directive == "no-cache") {
+                noCache = true;
+            } else if (directive == "must-revalidate") {
+                entry.mustRevalidate = true;
+            } else if (directive.rfind("max-age=", 0) == 0) {
+                try {
+                    maxAge = std::stoll(directive.substr(8));
+                } catch (const std::exception&) {
+                    // Malformed: treat as already stale.
+                    maxAge = 0;
+                }
+            }
+        }
+    }
+
+    if (noCache) {
+        entry.expires = now;
+    } else if (maxAge) {
+        long long age = 0;
+        if (auto it = header.find("Age"); it != header.end()) {
+            age = std::atoll(it->second.c_str());
+        }
+        entry.expires = now + Seconds(std::max(0LL, *maxAge - age));
+    } else if (auto it = header.find("Expires"); it != header.end()) {
+        // Unparseable dates come back as the epoch, i.e. already expired.
+        entry.expires = util::parseTimestamp(it->second.c_str());
+    } else if (entry.modified && *entry.modified < now) {
+        // Heuristic freshness: a tenth of the time since the last change.
+        entry.expires = now + (now - *entry.modified) / 10;
+    }
+    return entry;
+}
+
+// Content encodings libcurl can decode in this build. It inflates bodies as
+// they stream in, on the fetch worker, so mbgl only ever sees plain bytes.
+// Advertising one it cannot decode would fail the transfer instead.
+std::string acceptedEncodings() {
+    const curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+    if (!info || !(info->features & CURL_VERSION_LIBZ)) {
+        return {};
+    }
+    std::string encodings = "gzip, deflate";
+#ifdef CURL_VERSION_BROTLI
+    if (info->features & CURL_VERSION_BROTLI) {
+        encodings += ", br";
+    }
+#endif
+#ifdef CURL_VERSION_ZSTD
+    if (info->features & CURL_VERSION_ZSTD) {
+        encodings += ", zstd";
+    }
+#endif
+    return encodings;
+}
+
+std::optional<std::string> headerValue(const cpr::Header& header,
+                                       const char* name) {
+    if (auto it = header.find(name); it != header.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+// Retry-After is either delta-seconds or an HTTP date; some tile servers
+// send x-rate-limit-reset (epoch seconds, or with some servers a delay)
+// instead. A date that does not parse counts as no hint.
+std::optional<Timestamp> retryAfter(const cpr::Header& header) {
+    if (auto value = headerValue(header, "Retry-After")) {
+        if (!value->empty() &&
+            std::all_of(value->begin(), value->end(), [](unsigned char c) {
+                return std::isdigit(c);
+            })) {
+            return util::now() + Seconds(std::atoll(value->c_str()));
+        }
+        // parseTimestamp() returns the epoch for anything it cannot read.
+        const Timestamp date = util::parseTimestamp(value->c_str());
+        if (date.time_since_epoch() == Timestamp::duration::zero()) {
+            return std::nullopt;
+        }
+        return date;
+    }
+    if (auto value = headerValue(header, "x-rate-limit-reset")) {
+        const long long seconds = std::atoll(value->c_str());
+        if (seconds < kEpochResetThreshold) {
+            return util::now() + Seconds(seconds);
+        }
+        return Timestamp(Seconds(seconds));
+    }
+    return std::nullopt;
+}
+
+// Authority part of an http(s) URL, e.g. "tiles.example.com:8080"; empty for
+// anything else, which is not subject to per-host limits.
+std::string hostOf(const std::string& url) {
+    const auto scheme = url.find("://");
+    if (scheme == std::string::npos || url.rfind("http", 0) != 0) {
+        return {};
+    }
+    const auto start = scheme + 3;
+    const auto end = url.find_first_of("/?#", start);
+    return url.substr(start, end == std::string::npos ? end : end - start);
+}
+
+// Zoom levels a tile source has tiles for; TileJSON's defaults.
+struct ZoomRange {
+    std::uint8_t min = 0;
+    std::uint8_t max = 22;
+};
+
+// Index of the quote closing the JSON string that opens at `begin`, or npos.
+std::size_t jsonStringEnd(const std::string& json, std::size_t begin) {
+    for (std::size_t i = begin + 1; i < json.size(); ++i) {
+        if (json[i] == '\\') {
+            ++i;
+        } else if (json[i] == '"') {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+// Top-level members of a JSON object, as raw value text. Just enough JSON to
+// read a TileJSON document; nested values are left as they are.
+std::map<std::string, std::string> jsonMembers(const std::string& json) {
+    std::map<std::string, std::string> members;
+    int depth = 0;
+    std::string key;
+    std::size_t value = std::string::npos;
+    for (std::size_t i = 0; i < json.size(); ++i) {
+        const char c = json[i];
+        if (c == '"') {
+            const std::size_t end = jsonStringEnd(json, i);
+            if (end == std::string::npos) {
+                break;
+            }
+            if (depth == 1 && value == std::string::npos) {
+                key = json.substr(i + 1, end - i - 1);
+            }
+            i = end;
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']' || (c == ',' && depth == 1)) {
+            if (depth == 1 && value != std::string::npos) {
+                members[key] = json.substr(value, i - value);
+                value = std::string::npos;
+            }
+            if (c != ',') {
+                --depth;
+            }
+        } else if (c == ':' && depth == 1) {
+            value = i + 1;
+        }
+    }
+    return members;
+}
+
+// The strings of a JSON array. Only the escapes that show up in URLs ("\/")
+// are undone properly.
+std::vector<std::string> jsonStrings(const std::string& array) {
+    std::vector<std::string> strings;
+    for (auto i = array.find('"'); i != std::string::npos;
+         i = array.find('"', i + 1)) {
+        const std::size_t end = jsonStringEnd(array, i);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string value;
+        for (std::size_t j = i + 1; j < end; ++j) {
+            if (array[j] == '\\') {
+                ++j;
+            }
+            value += array[j];
+        }
+        strings.push_back(std::move(value));
+        i = end;
+    }
+    return strings;
+}
+
+// Zoom range a TileJSON document declares, for each of its tile URL
+// templates.
+std::map<std::string, ZoomRange> tileJsonZoomRanges(const std::string& json) {
+    const auto members = jsonMembers(json);
+    const auto tiles = members.find("tiles");
+    if (tiles == members.end()) {
+        return {};
+    }
+    const auto zoom = [&members](const char* name, std::uint8_t fallback) {
+        const auto it = members.find(name);
+        if (it == members.end()) {
+            return fallback;
+        }
+        return static_cast<std::uint8_t>(
+            std::clamp(std::atof(it->second.c_str()), 0.0, 30.0));
+    };
+    const ZoomRange range{zoom("minzoom", ZoomRange{}.min),
+                          zoom("maxzoom", ZoomRange{}.max)};
+    std::map<std::string, ZoomRange> ranges;
+    for (auto& url : jsonStrings(tiles->second)) {
+        ranges[std::move(url)] = range;
+    }
+    return ranges;
+}
+
+Response fromCacheEntry(const CacheEntry& entry) {
+    Response response;
+    response.data = entry.data;
+    response.etag = entry.etag;
+    response.modified = entry.modified;
+    response.expires = entry.expires;
+    response.mustRevalidate = entry.mustRevalidate;
+    return response;
+}
+
+// Maps statuses the way mbgl's own HTTP file source does, which the rest of
+// mbgl relies on: a missing tile is empty rather than an error, and only
+// server-side and connection failures are worth retrying. `body` holds what
+// the write callback received; on success it becomes the response data as
+// is.
+Response toResponse(const cpr::Response& r, Resource::Kind kind,
+                    std::shared_ptr<std::string> body) {
+    Response response;
+    const std::string status =
+        "HTTP status code " + std::to_string(r.status_code);
+
+    if (r.error.code != cpr::ErrorCode::OK) {
+        response.error = std::make_unique<Response::Error>(
+            Response::Error::Reason::Connection, r.error.message);
+    } else if (r.status_code == 204 ||
+               (r.status_code == 404 && kind == Resource::Kind::Tile)) {
+        response.noContent = true;
+    } else if (r.status_code == 304) {
+        response.notModified = true;
+    } else if (r.status_code == 404) {
+        response.error = std::make_unique<Response::Error>(
+            Response::Error::Reason::NotFound, status);
+    } else if (r.status_code == 429 || r.status_code == 503) {
+        // A 503 without a hint when to come back is an ordinary server
+        // error.
+        const auto retry = retryAfter(r.header);
+        response.error = std::make_unique<Response::Error>(
+            r.status_code == 429 || retry ? Response::Error::Reason::RateLimit
+                                          : Response::Error::Reason::Server,
+            status, retry);
+    } else if (r.status_code >= 500 && r.status_code < 600) {
+        response.error = std::make_unique<Response::Error>(
+            Response::Error::Reason::Server, status);
+    } else if (r.status_code >= 200 && r.status_code < 300) {
+        response.data = std::move(body);
+    } else {
+        response.error = std::make_unique<Response::Error>(
+            Response::Error::Reason::Other, status);
+    }
+
+    return response;
+}
+
+// Lower ranks are fetched first: the style and its sources gate everything
+// else, sprites and glyphs gate symbol placement, tiles come last.
+int kindRank(Resource::Kind kind) {
+    switch (kind) {
+    case Resource::Kind::Style:
+        return 0;
+    case Resource::Kind::Source:
+        return 1;
+    case Resource::Kind::SpriteJSON:
+    case Resource::Kind::SpriteImage:
+        return 2;
+    case Resource::Kind::Glyphs:
+        return 3;
+    case Resource::Kind::Tile:
+        return 4;
+    default:
+        return 5;
+    }
+}
+
+// Camera position in normalized Web Mercator coordinates ([0, 1] on both
+// axes), which scale to tile coordinates at any zoom.
+struct Viewport {
+    double x = 0.5;
+    double y = 0.5;
+    double zoom = 0.0;
+};
+
+Viewport toViewport(const LatLng& center, double zoom) {
+    const MercatorPoint point =
+        project_mercator(center.latitude(), center.longitude());
+    return Viewport{point.x, point.y, zoom};
+}
+
+// Distance in tiles between a tile and the camera center at the tile's own
+// zoom level, plus one tile per zoom level away from the camera zoom.
+double tileDistance(const Resource::TileData& tile, const Viewport& viewport) {
+    const double scale = std::ldexp(1.0, tile.z);
+    double dx = std::abs(tile.x + 0.5 - viewport.x * scale);
+    dx = std::min(dx, scale - dx);  // the world wraps horizontally
+    const double dy = tile.y + 0.5 - viewport.y * scale;
+    return std::hypot(dx, dy) + std::abs(tile.z - std::floor(viewport.zoom));
+}
+
+// Keeps the shared instance alive for as long as mbgl holds the network file
+// source it handed out, and lets setResourceOptions() etc. reach it.
+class ForwardingFileSource final : public FileSource {
+public:
+    explicit ForwardingFileSource(std::shared_ptr<CustomFileSource> target_)
+        : target(std::move(target_)) {
+    }
+
+    std::unique_ptr<AsyncRequest> request(const Resource& resource,
+                                          Callback callback) override {
+        return target->request(resource, std::move(callback));
+    }
+    bool canRequest(const Resource& resource) const override {
+        return target->canRequest(resource);
+    }
+    void setResourceOptions(ResourceOptions options) override {
+        target->setResourceOptions(std::move(options));
+    }
+    ResourceOptions getResourceOptions() override {
+        return target->getResourceOptions();
+    }
+    void setClientOptions(ClientOptions options) override {
+        target->setClientOptions(std::move(options));
+    }
+    ClientOptions getClientOptions() override {
+        return target->getClientOptions();
+    }
+    void setResourceTransform(ResourceTransform transform) override {
+        target->setResourceTransform(std::move(transform));
+    }
+
+private:
+    std::shared_ptr<CustomFileSource> target;
+};
+
+}  // namespace
+
+// Shared between a CancellableRequest and the workers serving it. The mutex
+// orders cancellation against delivery: once the request object is gone,
+// its callback is never entered. It is recursive because mbgl commonly
+// drops the request from inside its own callback.
+struct RequestState {
+    explicit RequestState(FileSource::Callback callback_)
+        : callback(std::move(callback_)) {
+    }
+
+    // Called with the first response and again after every retry or
+    // refresh, for as long as the request is alive.
+    const FileSource::Callback callback;
+    std::atomic_bool cancelled{false};
+    std::recursive_mutex deliveryMutex;
+};
+
 // Concrete implementation of AsyncRequest that supports cancellation.
 class CancellableRequest : public AsyncRequest {
 public:
-    CancellableRequest()
-        : cancelled(std::make_shared<std::atomic_bool>(false)) {
+    explicit CancellableRequest(FileSource::Callback callback)
+        : state(std::make_shared<RequestState>(std::move(callback))) {
     }
     ~CancellableRequest() override {
-        cancelled->store(true);
+        std::lock_guard<std::recursive_mutex> lock(state->deliveryMutex);
+        state->cancelled.store(true);
     }
-    std::shared_ptr<std::atomic_bool> cancelled;
+    std::shared_ptr<RequestState> state;
 };
 
-class CustomFileSource::Impl {
+// Fixed-size pool of fetch workers. Pending requests wait in a queue ordered
+// by resource kind and, for tiles, by distance to the current viewport, so
+// after a long pan the tiles for where the camera is now are fetched before
+// the ones it flew over. Each worker reuses one cpr::Session for its whole
+// lifetime so connections stay alive (and HTTP/2 is negotiated over TLS)
+// across tiles instead of being set up per request. Requests stay open after
+// their first response: failures are retried and expiring responses
+// refreshed by queueing them again with a start time (see respond()).
+class CustomFileSource::Impl
+    : public std::enable_shared_from_this<CustomFileSource::Impl> {
 public:
-    Impl() = default;
+    explicit Impl(const FetchOptions& options)
+        : maxConnectionsPerHost(
+              std::max<std::size_t>(1, options.maxConnectionsPerHost)),
+          maxLowPriorityTransfers(
+              std::max<std::size_t>(1, options.workerCount / 2)),
+          memoryCache(options.memoryCacheBytes),
+          maxCacheBytes(options.maxCacheBytes) {
+        if (options.maxBytesPerSecond > 0) {
+            bandwidth = std::make_unique<TokenBucket>(
+                options.maxBytesPerSecond,
+                std::max<std::uint64_t>(options.maxBytesPerSecond,
+                                        kMinBandwidthBurst));
+        }
+        if (!options.cachePath.empty()) {
+            openDiskCache(options.cachePath);
+        }
+        const std::size_t workerCount =
+            std::max<std::size_t>(1, options.workerCount);
+        workers.reserve(workerCount);
+        for (std::size_t i = 0; i < workerCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
     ~Impl() {
-        std::lock_guard<std::mutex> lock(threadsMutex);
-        for (auto& thread : threads) {
-            if (thread.joinable()) {
-                thread.join();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
             }
         }
     }
 
-    void request(const Resource& resource, Callback callback,
-                 std::shared_ptr<std::atomic_bool> cancelled) {
-        std::lock_guard<std::mutex> lock(threadsMutex);
-        threads.emplace_back([url = resource.url,
-                              callback = std::move(callback),
-                              cancelled = std::move(cancelled)]() {
-            cpr::Response r = cpr::Get(cpr::Url{url});
-            Response response;
+    // `scheduler` belongs to the requesting thread; the resource transform
+    // may answer on another one.
+    void request(Resource resource, std::shared_ptr<RequestState> state,
+                 Scheduler* scheduler) {
+        ResourceTransform transform;
+        {
+            std::lock_guard<std::mutex> lock(transformMutex);
+            transform = resourceTransform;
+        }
+        if (!transform) {
+            start(std::move(resource), std::move(state), scheduler);
+            return;
+        }
+        const Resource::Kind kind = resource.kind;
+        const std::string url = resource.url;
+        transform.transform(
+            kind, url,
+            [self = weak_from_this(), resource = std::move(resource),
+             state = std::move(state),
+             scheduler](const std::string& transformed) mutable {
+                auto impl = self.lock();
+                if (!impl || state->cancelled.load()) {
+                    return;
+                }
+                resource.url = transformed;
+                impl->start(std::move(resource), std::move(state), scheduler);
+            });
+    }
 
-            if (r.error.code != cpr::ErrorCode::OK) {
-                response.error = std::make_unique<Response::Error>(
-                    Response::Error::Reason::Connection, r.error.message);
-            } else if (r.status_code < 200 || r.status_code >= 300) {
-                response.error = std::make_unique<Response::Error>(
-                    Response::Error::Reason::Server,
-                    "HTTP status code " + std::to_string(r.status_code));
-            } else {
-                response.data = std::make_shared<std::string>(r.text);
-            }
+    void setResourceTransform(ResourceTransform transform) {
+        std::lock_guard<std::mutex> lock(transformMutex);
+        resourceTransform = std::move(transform);
+    }
+
+    std::size_t prefetch(const std::vector<TileCoordinate>& tiles) {
+        std::size_t queued = 0;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            // Each call describes where the camera is headed now; whatever
+            // is left of the previous one is no longer worth fetching.
+            queue.erase(
+                std::remove_if(queue.begin(), queue.end(),
+                               [this](const std::shared_ptr<Task>& task) {
+                                   std::lock_guard<std::mutex> taskLock(
+                                       task->mutex);
+                                   if (!task->warmsCache ||
+                                       !task->allCancelled()) {
+                                       return false;
+                                   }
+                                   pending.erase(task->key);
+                                   return true;
+                               }),
+                queue.end());
 
-            if (!cancelled->load()) {
-                callback(response);
+            for (const auto& wanted : tiles) {
+                for (const auto& [urlTemplate, pixelRatio] : tileTemplates) {
+                    // What MapLibre would load for this tile from a source
+                    // with a narrower zoom range.
+                    const auto zooms = tileZooms.find(urlTemplate);
+                    const ZoomRange range =
+                        zooms == tileZooms.end() ? ZoomRange{} : zooms->second;
+                    const auto tile =
+                        source_tile(wanted, range.min, range.max);
+                    if (!tile) {
+                        continue;
+                    }
+                    Resource resource = Resource::tile(
+                        urlTemplate, pixelRatio, static_cast<int32_t>(tile->x),
+                        static_cast<int32_t>(tile->y),
+                        static_cast<int8_t>(tile->z), Tileset::Scheme::XYZ);
+                    resource.priority = Resource::Priority::Low;
+                    std::string key = coalescingKey(resource);
+                    if (pending.count(key)) {
+                        continue;
+                    }
+                    auto cached = memoryCache.get(resource.url);
+                    if (cached && cached->isFresh(util::now())) {
+                        continue;
+                    }
+                    auto task = std::make_shared<Task>(
+                        resource, std::move(key), nextSequence++,
+                        std::move(cached), true);
+                    pending[task->key] = task;
+                    queue.push_back(std::move(task));
+                    ++queued;
+                }
             }
-        });
+        }
+        if (queued > 0) {
+            queueCondition.notify_all();
+        }
+        return queued;
+    }
+
+    std::size_t workerCount() const {
+        return workers.size();
+    }
+
+    MemoryCache::Stats memoryCacheStats() const {
+        return memoryCache.stats();
+    }
+
+    TransferStats transferStats() const {
+        TransferStats stats;
+        stats.transfers = transfers.load(std::memory_order_relaxed);
+        stats.wireBytes = wireBytes.load(std::memory_order_relaxed);
+        stats.decodedBytes = decodedBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void setViewport(const LatLng& center, double zoom) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        viewport = toViewport(center, zoom);
+    }
+
+    // Only the first path sticks: all maps share this source, and switching
+    // databases under running requests would gain nothing.
+    void openDiskCache(const std::string& path) {
+        if (path.empty() || path == ":memory:") {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(diskCacheMutex);
+        if (!diskCache) {
+            diskCache = std::make_shared<DiskCache>(path, maxCacheBytes);
+        }
+    }
+
+    std::uint64_t addResponseListener(std::function<void()> listener) {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        const std::uint64_t id = nextListenerId++;
+        listeners.emplace(id, std::move(listener));
+        return id;
+    }
+
+    // Once this returns, the listener is not running and will not run again.
+    void removeResponseListener(std::uint64_t id) {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        listeners.erase(id);
     }
 
 private:
-    std::mutex threadsMutex;
-    std::vector<std::thread> threads;
+    using Clock = std::chrono::steady_clock;
+
+    struct Waiter {
+        std::shared_ptr<RequestState> state;
+        // Scheduler of the requesting thread, if it has one; responses are
+        // handed back on it so mbgl sees them on the thread that asked.
+        Scheduler* scheduler;
+        // The request as it is sent next time: validators of the last
+        // response replace those it came with, as in mbgl's own network
+        // file source.
+        Resource resource;
+        std::uint32_t failedRequests = 0;
+        std::uint32_t expiredRequests = 0;
+        // Body last delivered, so that a refresh returning the same buffer
+        // is reported as notModified instead of being parsed again.
+        std::shared_ptr<const std::string> lastData;
+    };
+
+    // One download, shared by every request for the same resource made
+    // while it is queued or running: a style reload or several sources
+    // naming the same sprite or glyph range then cost a single transfer.
+    struct Task {
+        Task(const Resource& resource_, std::string key_,
+             std::uint64_t sequence_, std::optional<CacheEntry> cached_,
+             bool warmsCache_ = false)
+            : resource(resource_),
+              key(std::move(key_)),
+              host(hostOf(resource_.url)),
+              sequence(sequence_),
+              warmsCache(warmsCache_),
+              cached(std::move(cached_)),
+              lowPriority(warmsCache_ ||
+                          resource_.priority == Resource::Priority::Low) {
+        }
+
+        // Must be called with `mutex` held.
+        bool allCancelled() const {
+            return std::all_of(waiters.begin(), waiters.end(),
+                               [](const Waiter& waiter) {
+                                   return waiter.state->cancelled.load();
+                               });
+        }
+
+        // Must be called with `mutex` held. Prefetches are wanted for the
+        // cache even once nobody is waiting for them.
+        bool unwanted() const {
+            return !warmsCache && allCancelled();
+        }
+
+        const Resource resource;
+        const std::string key;
+        const std::string host;
+        const std::uint64_t sequence;
+        // Queued by prefetch() to fill the caches, not by a request.
+        const bool warmsCache;
+        // Memory-cache entry found when the request was made, usually stale.
+        std::optional<CacheEntry> cached;
+
+        // Guarded by queueMutex. Low-priority tasks run after all others
+        // and on at most maxLowPriorityTransfers workers at once. Retries
+        // and refreshes are not taken before notBefore.
+        bool lowPriority;
+        bool runningLowPriority = false;
+        Clock::time_point notBefore;
+        bool started = false;
+        // Queued again by respond(): the memory cache is looked at when the
+        // task runs rather than when it was scheduled.
+        bool lookUpCache = false;
+        // Answers of 429 (or 503 with Retry-After) so far; only the worker
+        // running the task touches it.
+        std::uint32_t rateLimitedAttempts = 0;
+
+        std::mutex mutex;
+        std::vector<Waiter> waiters;
+        // Set when the transfer was aborted because every waiter cancelled;
+        // later requests start a new task instead of joining this one.
+        bool abandoned = false;
+    };
+
+    // Requests only share a download if they would send the same request:
+    // same URL and byte range, and the same validators from mbgl's cache
+    // (a 304 answer is only meaningful to a requester holding the body).
+    static std::string coalescingKey(const Resource& resource) {
+        std::string key = resource.url;
+        if (resource.dataRange) {
+            key += "\nrange=" + std::to_string(resource.dataRange->first) +
+                   "-" + std::to_string(resource.dataRange->second);
+        }
+        if (resource.priorEtag) {
+            key += "\netag=" + *resource.priorEtag;
+        }
+        if (resource.priorModified) {
+            key += "\nmodified=" +
+                   std::to_string(resource.priorModified->time_since_epoch()
+                                      .count());
+        }
+        return key;
+    }
+
+    bool runsBefore(const Task& a, const Task& b) const {
+        if (a.lowPriority != b.lowPriority) {
+            return b.lowPriority;
+        }
+        // Local archive reads take microseconds; don't queue them behind
+        // network round trips.
+        const bool localA = TileArchives::isArchiveUrl(a.resource.url);
+        const bool localB = TileArchives::isArchiveUrl(b.resource.url);
+        if (localA != localB) {
+            return localA;
+        }
+        const int rankA = kindRank(a.resource.kind);
+        const int rankB = kindRank(b.resource.kind);
+        if (rankA != rankB) {
+            return rankA < rankB;
+        }
+        if (a.resource.tileData && b.resource.tileData) {
+            const double distanceA =
+                tileDistance(*a.resource.tileData, viewport);
+            const double distanceB =
+                tileDistance(*b.resource.tileData, viewport);
+            if (distanceA != distanceB) {
+                return distanceA < distanceB;
+            }
+        }
+        return a.sequence < b.sequence;
+    }
+
+    // Remembers the zoom range of the tile sources a TileJSON describes, for
+    // prefetch().
+    void noteTileJson(const std::string& json) {
+        auto ranges = tileJsonZoomRanges(json);
+        if (ranges.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto& [urlTemplate, range] : ranges) {
+            tileZooms[urlTemplate] = range;
+        }
+    }
+
+    // Must be called with queueMutex held. The end of the host's back-off
+    // after a 429, if it has not passed yet.
+    std::optional<Clock::time_point> backedOffUntil(const Task& task,
+                                                    Clock::time_point now) {
+        auto it = task.host.empty() ? hosts.end() : hosts.find(task.host);
+        if (it != hosts.end() && it->second.retryAt &&
+            *it->second.retryAt > now) {
+            return it->second.retryAt;
+        }
+        return std::nullopt;
+    }
+
+    // Must be called with queueMutex held.
+    bool hostHasRoom(const Task& task) {
+        if (task.host.empty()) {
+            return true;
+        }
+        auto it = hosts.find(task.host);
+        return it == hosts.end() ||
+               it->second.active < maxConnectionsPerHost;
+    }
+
+    // Starts (or joins) the download for `waiter`, not before `notBefore`.
+    // `cached` is the memory-cache entry for its URL, if any; a repeated
+    // request looks it up when it runs instead.
+    void enqueue(Waiter waiter, std::optional<CacheEntry> cached,
+                 Clock::time_point notBefore, bool repeated) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            const Resource& resource = waiter.resource;
+            if (resource.tileData &&
+                !TileArchives::isArchiveUrl(resource.url)) {
+                tileTemplates[resource.tileData->urlTemplate] =
+                    resource.tileData->pixelRatio;
+            }
+            std::string key = coalescingKey(resource);
+            bool joined = false;
+            if (auto it = pending.find(key); it != pending.end()) {
+                Task& task = *it->second;
+                std::lock_guard<std::mutex> taskLock(task.mutex);
+                if (!task.abandoned) {
+                    // Someone needs a prefetched tile now.
+                    if (resource.priority != Resource::Priority::Low) {
+                        task.lowPriority = false;
+                    }
+                    // A waiting retry is fetched as soon as anyone needs it.
+                    if (!task.started) {
+                        task.notBefore = std::min(task.notBefore, notBefore);
+                        if (!repeated) {
+                            task.lookUpCache = false;
+                            task.cached = std::move(cached);
+                        }
+                    }
+                    task.waiters.push_back(std::move(waiter));
+                    joined = true;
+                }
+            }
+            if (!joined) {
+                auto task = std::make_shared<Task>(resource, std::move(key),
+                                                   nextSequence++,
+                                                   std::move(cached));
+                task->notBefore = notBefore;
+                task->lookUpCache = repeated;
+                task->waiters.push_back(std::move(waiter));
+                pending[task->key] = task;
+                queue.push_back(std::move(task));
+            }
+        }
+        // Also wakes workers sleeping until a later start time.
+        queueCondition.notify_one();
+    }
+
+    void start(Resource resource, std::shared_ptr<RequestState> state,
+               Scheduler* scheduler) {
+        // Archive reads are cheaper than a cache lookup would save.
+        std::optional<CacheEntry> cached;
+        if (!TileArchives::isArchiveUrl(resource.url) &&
+            !resource.dataRange) {
+            cached = memoryCache.get(resource.url);
+        }
+        Waiter waiter{std::move(state), scheduler, std::move(resource), 0, 0,
+                      nullptr};
+        // A fresh hit is answered right away through the caller's run loop
+        // (never synchronously from inside request()), skipping the queue.
+        if (cached && scheduler && cached->isFresh(util::now())) {
+            respond(std::move(waiter), fromCacheEntry(*cached));
+            return;
+        }
+        enqueue(std::move(waiter), std::move(cached), Clock::now(), false);
+    }
+
+    // Hands `response` to the waiter, then, while the request is alive,
+    // queues it again the way mbgl's OnlineFileSource would: after a
+    // retryable failure, or when the response expires (retry_policy.hpp).
+    // mbgl leaves both to its network file source, which this one replaces.
+    void respond(Waiter waiter, Response response) {
+        const Timestamp now = util::now();
+        waiter.failedRequests = response.error ? waiter.failedRequests + 1 : 0;
+        // Already stale on arrival: asking again right away would get the
+        // same answer, so back off instead.
+        waiter.expiredRequests = response.expires && *response.expires <= now
+                                     ? waiter.expiredRequests + 1
+                                     : 0;
+        if (!response.error) {
+            if (response.etag) {
+                waiter.resource.priorEtag = response.etag;
+            }
+            if (response.modified) {
+                waiter.resource.priorModified = response.modified;
+            }
+            waiter.resource.priorExpires = response.expires;
+        }
+        if (response.data && response.data == waiter.lastData) {
+            response.data.reset();
+            response.notModified = true;
+        } else if (response.data) {
+            if (waiter.resource.kind == Resource::Kind::Source) {
+                noteTileJson(*response.data);
+            }
+            waiter.lastData = response.data;
+        }
+
+        std::optional<Duration> next = expirationTimeout(
+            response.expires, waiter.expiredRequests, now);
+        if (response.error) {
+            const auto retry = errorRetryTimeout(
+                response.error->reason, waiter.failedRequests,
+                response.error->retryAfter, now);
+            if (retry && (!next || *retry < *next)) {
+                next = retry;
+            }
+        }
+        deliver(waiter, std::move(response));
+        if (next && !waiter.state->cancelled.load()) {
+            enqueue(std::move(waiter), std::nullopt, Clock::now() + *next,
+                    true);
+        }
+    }
+
+    // Must be called with queueMutex held. The viewport changes under the
+    // queue, so the best task is looked up on demand instead of being kept in
+    // a heap with stale keys; cancelled tasks are discarded along the way.
+    // Tasks for hosts that already have maxConnectionsPerHost transfers
+    // running wait for one of those to finish, those for a host that rate
+    // limited us wait for its back-off to pass. `due` is set to the earliest
+    // time a task that is not due yet may start.
+    std::shared_ptr<Task> takeNextTask(std::optional<Clock::time_point>& due) {
+        queue.erase(std::remove_if(queue.begin(), queue.end(),
+                                   [this](const std::shared_ptr<Task>& task) {
+                                       std::lock_guard<std::mutex> lock(
+                                           task->mutex);
+                                       if (!task->unwanted()) {
+                                           return false;
+                                       }
+                                       pending.erase(task->key);
+                                       return true;
+                                   }),
+                    queue.end());
+        const Clock::time_point now = Clock::now();
+        auto best = queue.end();
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            auto notBefore = std::max((*it)->notBefore, now);
+            if (const auto until = backedOffUntil(**it, now)) {
+                notBefore = std::max(notBefore, *until);
+            }
+            if (notBefore > now) {
+                if (!due || notBefore < *due) {
+                    due = notBefore;
+                }
+                continue;
+            }
+            if ((!(*it)->lowPriority ||
+                 lowPriorityActive < maxLowPriorityTransfers) &&
+                hostHasRoom(**it) &&
+                (best == queue.end() || runsBefore(**it, **best))) {
+                best = it;
+            }
+        }
+        if (best == queue.end()) {
+            return nullptr;
+        }
+        std::shared_ptr<Task> task = std::move(*best);
+        *best = std::move(queue.back());
+        queue.pop_back();
+        task->started = true;
+        if (!task->host.empty()) {
+            ++hosts[task->host].active;
+        }
+        if (task->lowPriority) {
+            task->runningLowPriority = true;
+            ++lowPriorityActive;
+        }
+        return task;
+    }
+
+    // A task stays joinable until its response is ready; from then on, new
+    // requests for the same resource start their own download. Returns
+    // whether anyone was waiting for the response.
+    bool finish(const std::shared_ptr<Task>& task, Response response) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (auto it = pending.find(task->key);
+                it != pending.end() && it->second == task) {
+                pending.erase(it);
+            }
+            if (task->runningLowPriority) {
+                --lowPriorityActive;
+            }
+            if (auto it = hosts.find(task->host); it != hosts.end()) {
+                HostState& host = it->second;
+                --host.active;
+                if (host.active == 0 &&
+                    (!host.retryAt || *host.retryAt <= Clock::now())) {
+                    hosts.erase(it);
+                }
+            }
+        }
+        // The host has room again; a task for it may be waiting.
+        queueCondition.notify_one();
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(task->mutex);
+            waiters.swap(task->waiters);
+        }
+        for (std::size_t i = 0; i + 1 < waiters.size(); ++i) {
+            respond(std::move(waiters[i]), response);
+        }
+        if (waiters.empty()) {
+            return false;
+        }
+        respond(std::move(waiters.back()), std::move(response));
+        return true;
+    }
+
+    void workerLoop() {
+        cpr::Session session;
+        session.SetOption(
+            cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS});
+        session.SetOption(cpr::ConnectTimeout{kConnectTimeout});
+        sharedCurl.attach(session);
+        if (const std::string encodings = acceptedEncodings();
+            !encodings.empty()) {
+            session.SetOption(cpr::AcceptEncoding{{encodings}});
+        }
+
+        for (;;) {
+            std::shared_ptr<Task> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                for (;;) {
+                    if (stopping) {
+                        return;
+                    }
+                    std::optional<Clock::time_point> due;
+                    if ((task = takeNextTask(due))) {
+                        break;
+                    }
+                    if (due) {
+                        queueCondition.wait_until(lock, *due);
+                    } else {
+                        queueCondition.wait(lock);
+                    }
+                }
+            }
+
+            // Abort the transfer as soon as every request waiting for it is
+            // dropped or the file source shuts down, instead of downloading
+            // a body nobody will read.
+            const std::function<bool()> wanted = [this, task] {
+                if (stopping.load()) {
+                    return false;
+                }
+                std::lock_guard<std::mutex> lock(task->mutex);
+                if (task->unwanted()) {
+                    task->abandoned = true;
+                }
+                return !task->abandoned;
+            };
+            session.SetOption(cpr::ProgressCallback(
+                [wanted](auto, auto, auto, auto, intptr_t) -> bool {
+                    return wanted();
+                }));
+            std::optional<CacheEntry> cached = std::move(task->cached);
+            if (task->lookUpCache &&
+                !TileArchives::isArchiveUrl(task->resource.url) &&
+                !task->resource.dataRange) {
+                cached = memoryCache.get(task->resource.url);
+            }
+            std::optional<CacheEntry> fetched;
+            Response response = fetch(session, task->resource,
+                                      std::move(cached), fetched, wanted);
+            if (response.error && !task->host.empty() &&
+                response.error->reason == Response::Error::Reason::RateLimit &&
+                ++task->rateLimitedAttempts < kMaxRateLimitedAttempts) {
+                requeue(task);
+                continue;
+            }
+            if (finish(task, std::move(response))) {
+                notifyListeners();
+            } else if (fetched) {
+                // Nobody took it (a prefetch), so mbgl never stores it in its
+                // own cache; keep it in ours until it is asked for.
+                if (const auto cache = currentDiskCache()) {
+                    cache->put(task->resource.url, *fetched);
+                }
+            }
+        }
+    }
+
+    // Set when a host answered 429 (or 503 with Retry-After); until then,
+    // none of its tasks are started (see takeNextTask()). Never shorter than
+    // kMinRetryAfter, so a server asking for no wait at all is not hammered.
+    void backOff(const std::string& host, std::optional<Timestamp> until) {
+        const Duration wait =
+            until ? std::max<Duration>(kMinRetryAfter, *until - util::now())
+                  : Duration(kDefaultRetryAfter);
+        SLINT_MAPLIBRE_LOG(Info, "CustomFileSource",
+                           "rate limited by " << host << ", backing off");
+        std::lock_guard<std::mutex> lock(queueMutex);
+        hosts[host].retryAt = Clock::now() + wait;
+    }
+
+    // A rate-limited task goes back into the queue instead of failing its
+    // requests. It stays joinable and is reissued once the host's back-off
+    // has passed, and no sooner than an exponential per-task delay; the
+    // requests see the RateLimit error only once kMaxRateLimitedAttempts
+    // attempts were refused.
+    void requeue(const std::shared_ptr<Task>& task) {
+        const auto delay = Duration(kMinRetryAfter) *
+                           (std::int64_t{1} << (task->rateLimitedAttempts - 1));
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            task->notBefore = Clock::now() + delay;
+            if (task->runningLowPriority) {
+                task->runningLowPriority = false;
+                --lowPriorityActive;
+            }
+            if (auto it = hosts.find(task->host); it != hosts.end()) {
+                --it->second.active;
+            }
+            task->started = false;
+            task->lookUpCache = true;
+            queue.push_back(task);
+        }
+        queueCondition.notify_all();
+    }
+
+    // Takes `bytes` from the bandwidth budget and waits until it covers
+    // them, in short slices so that cancellation and shutdown still abort
+    // the transfer promptly. Returns false if the transfer should stop.
+    bool throttle(std::size_t bytes, const std::function<bool()>& wanted) {
+        using ThrottleClock = TokenBucket::Clock;
+        const auto until = ThrottleClock::now() + bandwidth->take(bytes);
+        for (auto now = ThrottleClock::now(); now < until;
+             now = ThrottleClock::now()) {
+            if (!wanted()) {
+                return false;
+            }
+            std::this_thread::sleep_for(
+                std::min<ThrottleClock::duration>(until - now, kThrottleSlice));
+        }
+        return true;
+    }
+
+    std::shared_ptr<DiskCache> currentDiskCache() {
+        std::lock_guard<std::mutex> lock(diskCacheMutex);
+        if (diskCache && diskCache->isOpen()) {
+            return diskCache;
+        }
+        return nullptr;
+    }
+
+    // Serves fresh cache hits without a request, revalidates stale ones
+    // with a conditional GET, and falls back to a stale copy when the
+    // network or the server fails or rate-limits us. `cached` is the
+    // memory-cache entry, if any; otherwise the disk cache is consulted and
+    // promotes into memory. A body downloaded for a resource that may be
+    // stored persistently is also left in `fetched`. The transfer stops
+    // once `wanted` returns false.
+    Response fetch(cpr::Session& session, const Resource& resource,
+                   std::optional<CacheEntry> cached,
+                   std::optional<CacheEntry>& fetched,
+                   const std::function<bool()>& wanted) {
+        const std::string& url = resource.url;
+        if (TileArchives::isArchiveUrl(url)) {
+            return archives.fetch(resource);
+        }
+        // The caches are keyed by URL and hold whole bodies; byte ranges
+        // (e.g. PMTiles over HTTP) go straight to the network.
+        const auto cache =
+            resource.dataRange ? nullptr : currentDiskCache();
+        if (!cached && cache) {
+            cached = cache->get(url);
+            if (cached) {
+                memoryCache.put(url, *cached);
+            }
+        }
+        if (cached && cached->isFresh(util::now())) {
+            return fromCacheEntry(*cached);
+        }
+
+        const std::string host = hostOf(url);
+
+        // Our own validators first; otherwise those of mbgl's cache, in
+        // which case a 304 is reported back to it as notModified.
+        const auto etag = cached ? cached->etag : resource.priorEtag;
+        const auto modified =
+            cached ? cached->modified : resource.priorModified;
+        cpr::Header header;
+        if (etag) {
+            header["If-None-Match"] = *etag;
+        } else if (modified) {
+            header["If-Modified-Since"] = util::rfc1123(*modified);
+        }
+        if (resource.dataRange) {
+            header["Range"] =
+                "bytes=" + std::to_string(resource.dataRange->first) + "-" +
+                std::to_string(resource.dataRange->second);
+        }
+        session.SetHeader(header);
+        session.SetOption(cpr::Url{url});
+
+        // Stream the (already decoded) body straight into the string mbgl
+        // will get, rather than letting cpr buffer it in Response::text and
+        // copying it out afterwards. Content-Length is the encoded size, so
+        // for compressed responses the reservation is only a lower bound.
+        // The callback stays installed on the reused session after this
+        // transfer, so it owns what it uses: a share of the body and its own
+        // copy of `wanted`, rather than references into this call.
+        auto body = std::make_shared<std::string>();
+        CURL* handle = session.GetCurlHolder()->handle;
+        session.SetOption(cpr::WriteCallback(
+            [this, sink = body, handle, wanted](auto data,
+                                                intptr_t) -> bool {
+                if (sink->empty()) {
+                    curl_off_t length = -1;
+                    if (curl_easy_getinfo(handle,
+                                          CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                                          &length) == CURLE_OK &&
+                        length > 0) {
+                        sink->reserve(static_cast<std::size_t>(length));
+                    }
+                }
+                sink->append(data.data(), data.size());
+                if (bandwidth && !throttle(data.size(), wanted)) {
+                    return false;
+                }
+                return !stopping.load();
+            }));
+        const cpr::Response r = session.Get();
+        const bool transferred = r.error.code == cpr::ErrorCode::OK;
+        if (transferred) {
+            // downloaded_bytes counts the body as received, before libcurl
+            // decodes it.
+            transfers.fetch_add(1, std::memory_order_relaxed);
+            wireBytes.fetch_add(
+                static_cast<std::uint64_t>(std::max<cpr::cpr_off_t>(
+                    0, r.downloaded_bytes)),
+                std::memory_order_relaxed);
+            decodedBytes.fetch_add(body->size(), std::memory_order_relaxed);
+        }
+        const bool rateLimited =
+            transferred && (r.status_code == 429 || r.status_code == 503);
+        if (rateLimited) {
+            const auto retry = retryAfter(r.header);
+            if (retry || r.status_code == 429) {
+                backOff(host, retry);
+            }
+        }
+
+        if (transferred && r.status_code == 304 && (etag || modified)) {
+            bool storable = true;
+            CacheEntry validators = cacheMetadata(r.header, storable);
+            if (!cached) {
+                Response response;
+                response.notModified = true;
+                response.etag = validators.etag ? validators.etag : etag;
+                response.modified = validators.modified;
+                response.expires = validators.expires;
+                response.mustRevalidate = validators.mustRevalidate;
+                return response;
+            }
+            if (cache) {
+                cache->refresh(url, validators);
+            }
+            cached->expires = validators.expires;
+            cached->mustRevalidate = validators.mustRevalidate;
+            if (validators.etag) {
+                cached->etag = validators.etag;
+            }
+            if (validators.modified) {
+                cached->modified = validators.modified;
+            }
+            memoryCache.put(url, *cached);
+            return fromCacheEntry(*cached);
+        }
+
+        if (cached && !cached->mustRevalidate &&
+            (!transferred || rateLimited || r.status_code >= 500)) {
+            SLINT_MAPLIBRE_LOG(Debug, "CustomFileSource",
+                               "network failed, serving stale " << url);
+            return fromCacheEntry(*cached);
+        }
+
+        Response response = toResponse(r, resource.kind, std::move(body));
+        if (response.noContent) {
+            // Not cached here, but mbgl refreshes it when it expires.
+            bool storable = true;
+            const CacheEntry entry = cacheMetadata(r.header, storable);
+            response.etag = entry.etag;
+            response.modified = entry.modified;
+            response.expires = entry.expires;
+        }
+        if (response.data) {
+            bool storable = true;
+            CacheEntry entry = cacheMetadata(r.header, storable);
+            response.etag = entry.etag;
+            response.modified = entry.modified;
+            response.expires = entry.expires;
+            response.mustRevalidate = entry.mustRevalidate;
+            if (storable && !resource.dataRange) {
+                entry.data = response.data;
+                if (resource.storagePolicy ==
+                    Resource::StoragePolicy::Permanent) {
+                    fetched = entry;
+                }
+                memoryCache.put(url, std::move(entry));
+            }
+        }
+        return response;
+    }
+
+    void notifyListeners() {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        for (const auto& entry : listeners) {
+            entry.second();
+        }
+    }
+
+    static void deliver(const Waiter& waiter, Response response) {
+        std::lock_guard<std::recursive_mutex> lock(
+            waiter.state->deliveryMutex);
+        if (waiter.state->cancelled.load()) {
+            return;
+        }
+        if (!waiter.scheduler) {
+            waiter.state->callback(std::move(response));
+            return;
+        }
+        // Cancellation happens on the scheduler's thread too, so checking
+        // the flag again there is race-free. While the request is alive,
+        // its owner (and so the scheduler) is alive as well.
+        waiter.scheduler->schedule(
+            [state = waiter.state, response = std::move(response)]() {
+                if (!state->cancelled.load()) {
+                    state->callback(response);
+                }
+            });
+    }
+
+    SharedCurlState sharedCurl;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::vector<std::shared_ptr<Task>> queue;
+    // Queued and running tasks by coalescingKey(), for requests to join.
+    std::unordered_map<std::string, std::shared_ptr<Task>> pending;
+    struct HostState {
+        std::size_t active = 0;
+        std::optional<Clock::time_point> retryAt;
+    };
+    std::unordered_map<std::string, HostState> hosts;
+    const std::size_t maxConnectionsPerHost;
+    const std::size_t maxLowPriorityTransfers;
+    std::size_t lowPriorityActive = 0;
+    // URL templates of the tile sources seen so far, with their pixel
+    // ratio; prefetch() expands tile coordinates against all of them.
+    std::map<std::string, std::uint8_t> tileTemplates;
+    // Zoom ranges from the TileJSON of those sources, where it came through
+    // here; the others are assumed to cover all zoom levels.
+    std::map<std::string, ZoomRange> tileZooms;
+    std::uint64_t nextSequence = 0;
+    Viewport viewport;
+    std::atomic_bool stopping{false};
+
+    std::atomic<std::uint64_t> transfers{0};
+    std::atomic<std::uint64_t> wireBytes{0};
+    std::atomic<std::uint64_t> decodedBytes{0};
+
+    // Null when the download rate is unlimited.
+    std::unique_ptr<TokenBucket> bandwidth;
+
+    MemoryCache memoryCache;
+    const std::uint64_t maxCacheBytes;
+    std::mutex diskCacheMutex;
+    std::shared_ptr<DiskCache> diskCache;
+    TileArchives archives;
+
+    std::mutex listenerMutex;
+    std::map<std::uint64_t, std::function<void()>> listeners;
+    std::uint64_t nextListenerId = 1;
+
+    std::mutex transformMutex;
+    ResourceTransform resourceTransform;
+
+    // Declared last so the workers are started after, and joined before,
+    // everything they use.
+    std::vector<std::thread> workers;
 };
 
-CustomFileSource::CustomFileSource() : impl(std::make_unique<Impl>()) {
+CustomFileSource::CustomFileSource() : CustomFileSource(FetchOptions{}) {
+}
+
+CustomFileSource::CustomFileSource(FetchOptions options)
+    : impl(std::make_shared<Impl>(options)) {
 }
 
 CustomFileSource::~CustomFileSource() = default;
 
+std::shared_ptr<CustomFileSource> CustomFileSource::installDefault() {
+    static std::mutex mutex;
+    static std::weak_ptr<CustomFileSource> current;
+    static bool registered = false;
+
+    std::shared_ptr<CustomFileSource> fileSource;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto existing = current.lock()) {
+            return existing;
+        }
+        fileSource = std::make_shared<CustomFileSource>();
+        current = fileSource;
+        if (registered) {
+            return fileSource;
+        }
+        registered = true;
+    }
+
+    // Registered outside our lock: the manager calls the factory with its
+    // own lock held, and the factory takes ours.
+    FileSourceManager::get()->registerFileSourceFactory(
+        FileSourceType::Network,
+        [](const ResourceOptions& resourceOptions,
+           const ClientOptions& clientOptions) -> std::unique_ptr<FileSource> {
+            std::shared_ptr<CustomFileSource> target;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                target = current.lock();
+            }
+            if (!target) {
+                target = std::make_shared<CustomFileSource>();
+            }
+            target->setResourceOptions(resourceOptions.clone());
+            target->setClientOptions(clientOptions.clone());
+            return std::make_unique<ForwardingFileSource>(std::move(target));
+        });
+    return fileSource;
+}
+
 std::unique_ptr<AsyncRequest> CustomFileSource::request(
     const Resource& resource, Callback callback) {
-    auto req = std::make_unique<CancellableRequest>();
-    impl->request(resource, std::move(callback), req->cancelled);
+    auto req = std::make_unique<CancellableRequest>(std::move(callback));
+    impl->request(resource, req->state, Scheduler::GetCurrent());
     return req;
 }
 
 bool CustomFileSource::canRequest(const Resource& resource) const {
     const std::string& url = resource.url;
+    if (TileArchives::isArchiveUrl(url)) {
+        return resource.kind == Resource::Kind::Source ||
+               resource.kind == Resource::Kind::Tile;
+    }
     if (url.rfind("http://", 0) != 0 && url.rfind("https://", 0) != 0) {
         return false;
     }
@@ -94,6 +1516,13 @@ bool CustomFileSource::canRequest(const Resource& resource) const {
 }
 
 void CustomFileSource::setResourceOptions(ResourceOptions options) {
+    const std::filesystem::path mbglCache(options.cachePath());
+    if (!mbglCache.empty() && mbglCache != ":memory:") {
+        std::filesystem::path path = mbglCache;
+        path.replace_filename(mbglCache.stem().string() + "-http" +
+                              mbglCache.extension().string());
+        impl->openDiskCache(path.string());
+    }
     resourceOptions = std::move(options);
 }
 
@@ -109,4 +1538,38 @@ ClientOptions CustomFileSource::getClientOptions() {
     return std::move(clientOptions);
 }
 
+void CustomFileSource::setResourceTransform(ResourceTransform transform) {
+    impl->setResourceTransform(std::move(transform));
+}
+
+void CustomFileSource::setViewport(const LatLng& center, double zoom) {
+    impl->setViewport(center, zoom);
+}
+
+std::size_t CustomFileSource::workerCount() const {
+    return impl->workerCount();
+}
+
+MemoryCache::Stats CustomFileSource::memoryCacheStats() const {
+    return impl->memoryCacheStats();
+}
+
+std::size_t CustomFileSource::prefetch(
+    const std::vector<TileCoordinate>& tiles) {
+    return impl->prefetch(tiles);
+}
+
+CustomFileSource::TransferStats CustomFileSource::transferStats() const {
+    return impl->transferStats();
+}
+
+std::uint64_t CustomFileSource::addResponseListener(
+    std::function<void()> listener) {
+    return impl->addResponseListener(std::move(listener));
+}
+
+void CustomFileSource::removeResponseListener(std::uint64_t id) {
+    impl->removeResponseListener(id);
+}
+
 }  // namespace mbgl
@@ -1,20 +1,61 @@
 #pragma once
 
 #include <cpr/cpr.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <mbgl/storage/file_source.hpp>
 #include <mbgl/storage/resource_options.hpp>
+#include <mbgl/storage/resource_transform.hpp>
 #include <mbgl/util/client_options.hpp>
+#include <mbgl/util/geo.hpp>
 #include <mbgl/util/run_loop.hpp>
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "memory_cache.hpp"
+#include "tile_cover.hpp"
 
 namespace mbgl {
 
 class CustomFileSource : public FileSource {
 public:
+    struct FetchOptions {
+        // Number of fetch workers. Each worker keeps one persistent HTTP
+        // session, so this is also the upper bound on open connections.
+        std::size_t workerCount = 6;
+        // At most this many transfers run against one host at a time; the
+        // remaining workers serve other hosts (glyphs, sprites, other tile
+        // servers) meanwhile.
+        std::size_t maxConnectionsPerHost = 4;
+        // Download rate shared by all workers, in bytes per second. 0 means
+        // unlimited.
+        std::uint64_t maxBytesPerSecond = 0;
+        // Persistent cache (see DiskCache) of the responses mbgl never sees,
+        // i.e. prefetched tiles; everything handed to mbgl is stored in
+        // mbgl's own cache database. Empty: derived from the first
+        // ResourceOptions::cachePath() set on this source, e.g.
+        // "cache.sqlite" -> "cache-http.sqlite"; mbgl owns the former file
+        // and recreates it on schema changes, so the two are kept apart.
+        // ":memory:" disables the disk cache.
+        std::string cachePath;
+        std::uint64_t maxCacheBytes = 256 * 1024 * 1024;
+        // Budget of the in-memory LRU in front of the disk cache.
+        std::uint64_t memoryCacheBytes = 64 * 1024 * 1024;
+    };
+
     CustomFileSource();
+    explicit CustomFileSource(FetchOptions options);
     ~CustomFileSource() override;
 
+    // Returns the process-wide instance that mbgl::FileSourceManager hands out
+    // as the network file source, creating and registering it if no map
+    // currently holds one. Maps created afterwards fetch through it. Like
+    // the OnlineFileSource it replaces, it retries failed requests and
+    // refreshes expiring responses for as long as a request is alive.
+    static std::shared_ptr<CustomFileSource> installDefault();
+
     std::unique_ptr<AsyncRequest> request(const Resource&, Callback) override;
     bool canRequest(const Resource&) const override;
 
@@ -22,10 +63,51 @@ public:
     ResourceOptions getResourceOptions() override;
     void setClientOptions(ClientOptions options) override;
     ClientOptions getClientOptions() override;
+    // Applied to every request URL before it is fetched. The transform may
+    // answer asynchronously; retries and refreshes reuse its result.
+    void setResourceTransform(ResourceTransform transform) override;
+
+    // Pending tile requests are served nearest-first around this camera
+    // position. Call it whenever the camera moves.
+    void setViewport(const LatLng& center, double zoom);
+
+    // Fetches the given tiles (XYZ) of every tile source requested so far
+    // into the caches, behind all regular requests and on at most half of
+    // the workers. Replaces whatever a previous call still has queued.
+    // Sources whose TileJSON came through this file source only get the
+    // tiles MapLibre would load from them: none below their minzoom, the
+    // ancestor at their maxzoom above it. Returns the number of tile
+    // requests queued.
+    std::size_t prefetch(const std::vector<TileCoordinate>& tiles);
+
+    // Number of fetch workers; fixed for the lifetime of the source.
+    std::size_t workerCount() const;
+
+    // Hit/miss/eviction counters and current size of the memory cache.
+    MemoryCache::Stats memoryCacheStats() const;
+
+    // Totals over all completed network transfers. Bodies are requested
+    // with gzip/deflate (and br/zstd where libcurl supports them), so
+    // wireBytes is usually well below decodedBytes.
+    struct TransferStats {
+        std::uint64_t transfers = 0;
+        // Response bodies as received, before content decoding.
+        std::uint64_t wireBytes = 0;
+        // The same bodies after decoding, as handed to mbgl.
+        std::uint64_t decodedBytes = 0;
+    };
+    TransferStats transferStats() const;
+
+    // Listeners run on a fetch worker each time a response has been handed
+    // back to the requesting thread's run loop, so an embedder that only
+    // pumps that loop on demand knows it has work. Must not call back into
+    // the file source.
+    std::uint64_t addResponseListener(std::function<void()> listener);
+    void removeResponseListener(std::uint64_t id);
 
 private:
     class Impl;
-    std::unique_ptr<Impl> impl;
+    std::shared_ptr<Impl> impl;
     ResourceOptions resourceOptions;
     ClientOptions clientOptions;
 };
@@ -0,0 +1,337 @@
+#include "disk_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <sqlite3.h>
+#include <vector>
+
+#include "log.hpp"
+
+namespace mbgl {
+
+namespace {
+
+// `accessed` is a counter rather than a wall-clock time so that entries
+// touched within the same second still evict in LRU order. The body is the
+// last column so that size and eviction scans never read its overflow pages.
+constexpr const char* kSchema =
+    "CREATE TABLE IF NOT EXISTS http_cache ("
+    "  url TEXT PRIMARY KEY NOT NULL,"
+    "  size INTEGER NOT NULL,"
+    "  accessed INTEGER NOT NULL,"
+    "  expires INTEGER,"
+    "  must_revalidate INTEGER NOT NULL,"
+    "  etag TEXT,"
+    "  modified INTEGER,"
+    "  data BLOB NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS http_cache_accessed"
+    "  ON http_cache (accessed);";
+
+// Evict down to this fraction of the budget so a full cache does not run a
+// DELETE after every insert.
+constexpr double kEvictTarget = 0.9;
+
+// Reads whose access times are written back together.
+constexpr std::size_t kTouchBatch = 64;
+
+std::int64_t toSeconds(Timestamp time) {
+    return time.time_since_epoch().count();
+}
+
+Timestamp fromSeconds(std::int64_t seconds) {
+    return Timestamp(Seconds(seconds));
+}
+
+void bindOptionalTime(sqlite3_stmt* stmt, int index,
+                      const std::optional<Timestamp>& time) {
+    if (time) {
+        sqlite3_bind_int64(stmt, index, toSeconds(*time));
+    } else {
+        sqlite3_bind_null(stmt, index);
+    }
+}
+
+void bindOptionalText(sqlite3_stmt* stmt, int index,
+                      const std::optional<std::string>& text) {
+    if (text) {
+        sqlite3_bind_text(stmt, index, text->data(),
+                          static_cast<int>(text->size()), SQLITE_TRANSIENT);
+    } else {
+        sqlite3_bind_null(stmt, index);
+    }
+}
+
+std::optional<Timestamp> columnOptionalTime(sqlite3_stmt* stmt, int index) {
+    if (sqlite3_column_type(stmt, index) == SQLITE_NULL) {
+        return std::nullopt;
+    }
+    return fromSeconds(sqlite3_column_int64(stmt, index));
+}
+
+// Resets the statement on scope exit so it never holds a read lock.
+class StatementScope {
+public:
+    explicit StatementScope(sqlite3_stmt* stmt_) : stmt(stmt_) {
+    }
+    ~StatementScope() {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+private:
+    sqlite3_stmt* stmt;
+};
+
+}  // namespace
+
+DiskCache::DiskCache(const std::string& path, std::uint64_t maxBytes_)
+    : maxBytes(maxBytes_) {
+    if (sqlite3_open_v2(path.c_str(), &db,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                            SQLITE_OPEN_NOMUTEX,
+                        nullptr) != SQLITE_OK) {
+        SLINT_MAPLIBRE_LOG(Warning, "DiskCache",
+                           "cannot open " << path << ": "
+                                          << sqlite3_errmsg(db));
+        close();
+        return;
+    }
+    // Other processes (a second demo instance) may hold the lock briefly.
+    sqlite3_busy_timeout(db, 1000);
+
+    // WAL lets readers proceed while a response is written; losing the last
+    // few writes on power loss only costs a refetch.
+    if (!exec("PRAGMA journal_mode = WAL;") ||
+        !exec("PRAGMA synchronous = NORMAL;") || !exec(kSchema)) {
+        close();
+        return;
+    }
+
+    const auto prepare = [this](const char* sql, sqlite3_stmt** stmt) {
+        if (sqlite3_prepare_v2(db, sql, -1, stmt, nullptr) != SQLITE_OK) {
+            SLINT_MAPLIBRE_LOG(Warning, "DiskCache",
+                               "prepare failed: " << sqlite3_errmsg(db));
+            return false;
+        }
+        return true;
+    };
+    if (!prepare("SELECT data, etag, modified, expires, must_revalidate "
+                 "FROM http_cache WHERE url = ?1",
+                 &selectStmt) ||
+        !prepare("UPDATE http_cache SET accessed = "
+                 "(SELECT IFNULL(MAX(accessed), 0) + 1 FROM http_cache) "
+                 "WHERE url = ?1",
+                 &touchStmt) ||
+        !prepare("INSERT OR REPLACE INTO http_cache "
+                 "(url, data, etag, modified, expires, must_revalidate, "
+                 "size, accessed) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, "
+                 "(SELECT IFNULL(MAX(accessed), 0) + 1 FROM http_cache))",
+                 &upsertStmt) ||
+        !prepare("UPDATE http_cache SET etag = IFNULL(?2, etag), "
+                 "modified = IFNULL(?3, modified), expires = ?4, "
+                 "must_revalidate = ?5 WHERE url = ?1",
+                 &refreshStmt) ||
+        !prepare("SELECT url, size FROM http_cache ORDER BY accessed ASC",
+                 &oldestStmt) ||
+        !prepare("DELETE FROM http_cache WHERE url = ?1", &deleteStmt) ||
+        !prepare("SELECT IFNULL(SUM(size), 0) FROM http_cache", &sumStmt)) {
+        close();
+        return;
+    }
+
+    countBytes();
+    SLINT_MAPLIBRE_LOG(Info, "DiskCache",
+                       "opened " << path << " (" << totalBytes << " bytes)");
+}
+
+DiskCache::~DiskCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (db) {
+            flushTouches();
+        }
+    }
+    close();
+}
+
+bool DiskCache::isOpen() const {
+    return db != nullptr;
+}
+
+std::optional<DiskCache::Entry> DiskCache::get(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!db) {
+        return std::nullopt;
+    }
+
+    Entry entry;
+    {
+        StatementScope scope(selectStmt);
+        sqlite3_bind_text(selectStmt, 1, url.data(),
+                          static_cast<int>(url.size()), SQLITE_STATIC);
+        if (sqlite3_step(selectStmt) != SQLITE_ROW) {
+            return std::nullopt;
+        }
+        const auto* blob =
+            static_cast<const char*>(sqlite3_column_blob(selectStmt, 0));
+        const int length = sqlite3_column_bytes(selectStmt, 0);
+        entry.data = std::make_shared<const std::string>(
+            blob ? std::string(blob, static_cast<std::size_t>(length))
+                 : std::string());
+        if (sqlite3_column_type(selectStmt, 1) != SQLITE_NULL) {
+            entry.etag = std::string(reinterpret_cast<const char*>(
+                sqlite3_column_text(selectStmt, 1)));
+        }
+        entry.modified = columnOptionalTime(selectStmt, 2);
+        entry.expires = columnOptionalTime(selectStmt, 3);
+        entry.mustRevalidate = sqlite3_column_int(selectStmt, 4) != 0;
+    }
+
+    touched.push_back(url);
+    if (touched.size() >= kTouchBatch) {
+        flushTouches();
+    }
+    return entry;
+}
+
+void DiskCache::put(const std::string& url, const Entry& entry) {
+    if (!entry.data) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!db || entry.data->size() > maxBytes) {
+        return;
+    }
+    // Earlier reads count as older than this write, and eviction below
+    // must see them.
+    flushTouches();
+
+    {
+        StatementScope scope(upsertStmt);
+        sqlite3_bind_text(upsertStmt, 1, url.data(),
+                          static_cast<int>(url.size()), SQLITE_STATIC);
+        sqlite3_bind_blob(upsertStmt, 2, entry.data->data(),
+                          static_cast<int>(entry.data->size()),
+                          SQLITE_STATIC);
+        bindOptionalText(upsertStmt, 3, entry.etag);
+        bindOptionalTime(upsertStmt, 4, entry.modified);
+        bindOptionalTime(upsertStmt, 5, entry.expires);
+        sqlite3_bind_int(upsertStmt, 6, entry.mustRevalidate ? 1 : 0);
+        sqlite3_bind_int64(upsertStmt, 7,
+                           static_cast<sqlite3_int64>(entry.data->size()));
+        if (sqlite3_step(upsertStmt) != SQLITE_DONE) {
+            SLINT_MAPLIBRE_LOG(Warning, "DiskCache",
+                               "write failed: " << sqlite3_errmsg(db));
+            return;
+        }
+    }
+    // A replaced row is counted twice until eviction recounts; that only
+    // makes eviction start slightly early.
+    totalBytes += entry.data->size();
+    if (totalBytes > maxBytes) {
+        countBytes();
+        if (totalBytes > maxBytes) {
+            evict();
+        }
+    }
+}
+
+void DiskCache::refresh(const std::string& url, const Entry& validators) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!db) {
+        return;
+    }
+    StatementScope scope(refreshStmt);
+    sqlite3_bind_text(refreshStmt, 1, url.data(),
+                      static_cast<int>(url.size()), SQLITE_STATIC);
+    bindOptionalText(refreshStmt, 2, validators.etag);
+    bindOptionalTime(refreshStmt, 3, validators.modified);
+    bindOptionalTime(refreshStmt, 4, validators.expires);
+    sqlite3_bind_int(refreshStmt, 5, validators.mustRevalidate ? 1 : 0);
+    sqlite3_step(refreshStmt);
+}
+
+std::uint64_t DiskCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalBytes;
+}
+
+void DiskCache::close() {
+    for (sqlite3_stmt** stmt : {&selectStmt, &touchStmt, &upsertStmt,
+                                &refreshStmt, &oldestStmt, &deleteStmt,
+                                &sumStmt}) {
+        sqlite3_finalize(*stmt);
+        *stmt = nullptr;
+    }
+    sqlite3_close(db);
+    db = nullptr;
+}
+
+bool DiskCache::exec(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        SLINT_MAPLIBRE_LOG(Warning, "DiskCache",
+                           "'" << sql << "' failed: "
+                               << (error ? error : "unknown error"));
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+// Must be called with the mutex held.
+void DiskCache::flushTouches() {
+    if (touched.empty()) {
+        return;
+    }
+    exec("BEGIN;");
+    for (const auto& url : touched) {
+        StatementScope scope(touchStmt);
+        sqlite3_bind_text(touchStmt, 1, url.data(),
+                          static_cast<int>(url.size()), SQLITE_STATIC);
+        sqlite3_step(touchStmt);
+    }
+    exec("COMMIT;");
+    touched.clear();
+}
+
+// Must be called with the mutex held (or from the constructor).
+void DiskCache::countBytes() {
+    StatementScope scope(sumStmt);
+    if (sqlite3_step(sumStmt) == SQLITE_ROW) {
+        totalBytes =
+            static_cast<std::uint64_t>(sqlite3_column_int64(sumStmt, 0));
+    }
+}
+
+// Must be called with the mutex held.
+void DiskCache::evict() {
+    const auto target = static_cast<std::uint64_t>(maxBytes * kEvictTarget);
+    std::vector<std::string> victims;
+    {
+        StatementScope scope(oldestStmt);
+        std::uint64_t remaining = totalBytes;
+        while (remaining > target && sqlite3_step(oldestStmt) == SQLITE_ROW) {
+            victims.emplace_back(reinterpret_cast<const char*>(
+                sqlite3_column_text(oldestStmt, 0)));
+            const auto size =
+                static_cast<std::uint64_t>(sqlite3_column_int64(oldestStmt, 1));
+            remaining -= std::min(remaining, size);
+        }
+    }
+
+    exec("BEGIN;");
+    for (const auto& url : victims) {
+        StatementScope scope(deleteStmt);
+        sqlite3_bind_text(deleteStmt, 1, url.data(),
+                          static_cast<int>(url.size()), SQLITE_STATIC);
+        sqlite3_step(deleteStmt);
+    }
+    exec("COMMIT;");
+    countBytes();
+    SLINT_MAPLIBRE_LOG(Debug, "DiskCache",
+                       "evicted " << victims.size() << " entries, "
+                                  << totalBytes << " bytes left");
+}
+
+}  // namespace mbgl
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cache_entry.hpp"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace mbgl {
+
+// Persistent HTTP response cache keyed by URL, stored in its own SQLite
+// database. Entries keep the validators (ETag, Last-Modified) and the
+// freshness lifetime the server sent, so CustomFileSource can serve fresh
+// entries without touching the network, revalidate stale ones with a
+// conditional request, and fall back to them while offline.
+//
+// Reads only note the URL; access order is written back in one transaction
+// per batch of reads (and before any write), not with an UPDATE per read.
+//
+// All methods are thread-safe. Failures (unwritable path, corrupt file) are
+// logged and turn the cache into a no-op rather than failing requests.
+class DiskCache {
+public:
+    using Entry = CacheEntry;
+
+    // Opens or creates the database at `path`. Least recently used entries
+    // are evicted once the stored bodies exceed `maxBytes`.
+    DiskCache(const std::string& path, std::uint64_t maxBytes);
+    ~DiskCache();
+
+    DiskCache(const DiskCache&) = delete;
+    DiskCache& operator=(const DiskCache&) = delete;
+
+    bool isOpen() const;
+
+    std::optional<Entry> get(const std::string& url);
+    void put(const std::string& url, const Entry& entry);
+
+    // Records a successful revalidation (HTTP 304): keeps the body and
+    // replaces the freshness lifetime and validators.
+    void refresh(const std::string& url, const Entry& validators);
+
+    // Total size of the stored bodies in bytes.
+    std::uint64_t size();
+
+private:
+    bool exec(const char* sql);
+    void close();
+    void flushTouches();
+    void countBytes();
+    void evict();
+
+    std::mutex mutex;
+    sqlite3* db = nullptr;
+    sqlite3_stmt* selectStmt = nullptr;
+    sqlite3_stmt* touchStmt = nullptr;
+    sqlite3_stmt* upsertStmt = nullptr;
+    sqlite3_stmt* refreshStmt = nullptr;
+    sqlite3_stmt* oldestStmt = nullptr;
+    sqlite3_stmt* deleteStmt = nullptr;
+    sqlite3_stmt* sumStmt = nullptr;
+    std::uint64_t maxBytes;
+    std::uint64_t totalBytes = 0;
+    // URLs read since the last flushTouches(), oldest first.
+    std::vector<std::string> touched;
+};
+
+}  // namespace mbgl
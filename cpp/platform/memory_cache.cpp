@@ -0,0 +1,84 @@
+#include "memory_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace mbgl {
+
+MemoryCache::MemoryCache(std::uint64_t maxBytes, std::size_t shardCount) {
+    shardCount = std::max<std::size_t>(1, shardCount);
+    shards.reserve(shardCount);
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+    shardBudget = maxBytes / shardCount;
+}
+
+std::optional<CacheEntry> MemoryCache::get(const std::string& url) {
+    Shard& shard = shardFor(url);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(url);
+    if (it == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    shard.order.splice(shard.order.begin(), shard.order, it->second);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second->second;
+}
+
+void MemoryCache::put(const std::string& url, CacheEntry entry) {
+    if (!entry.data) {
+        return;
+    }
+    const std::uint64_t size = cost(url, entry);
+    Shard& shard = shardFor(url);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (auto it = shard.index.find(url); it != shard.index.end()) {
+        shard.bytes -= cost(url, it->second->second);
+        shard.order.erase(it->second);
+        shard.index.erase(it);
+    }
+    if (size > shardBudget) {
+        return;
+    }
+
+    shard.order.emplace_front(url, std::move(entry));
+    shard.index.emplace(url, shard.order.begin());
+    shard.bytes += size;
+
+    while (shard.bytes > shardBudget) {
+        auto& victim = shard.order.back();
+        shard.bytes -= cost(victim.first, victim.second);
+        shard.index.erase(victim.first);
+        shard.order.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+MemoryCache::Stats MemoryCache::stats() const {
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.bytes += shard->bytes;
+        stats.entries += shard->index.size();
+    }
+    return stats;
+}
+
+std::uint64_t MemoryCache::cost(const std::string& url,
+                                const CacheEntry& entry) {
+    // The key is stored twice (list and index); count the body and the
+    // bookkeeping roughly, which is what the budget is meant to bound.
+    return entry.data->size() + 2 * url.size() + 128;
+}
+
+MemoryCache::Shard& MemoryCache::shardFor(const std::string& url) {
+    return *shards[std::hash<std::string>{}(url) % shards.size()];
+}
+
+}  // namespace mbgl
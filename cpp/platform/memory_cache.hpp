@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache_entry.hpp"
+
+namespace mbgl {
+
+// Byte-bounded in-memory LRU of response bodies in front of the disk cache
+// and the network. Bodies are shared, so a hit hands out the same buffer
+// without copying it. URLs are spread over independently locked shards so
+// fetch workers and the requesting thread rarely contend; each shard evicts
+// its own least recently used entries once it exceeds its share of the
+// budget.
+class MemoryCache {
+public:
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t entries = 0;
+    };
+
+    explicit MemoryCache(std::uint64_t maxBytes, std::size_t shardCount = 16);
+
+    MemoryCache(const MemoryCache&) = delete;
+    MemoryCache& operator=(const MemoryCache&) = delete;
+
+    std::optional<CacheEntry> get(const std::string& url);
+    // Inserts or replaces. Entries larger than a shard's budget are not kept.
+    void put(const std::string& url, CacheEntry entry);
+
+    Stats stats() const;
+
+private:
+    struct Shard {
+        using Order = std::list<std::pair<std::string, CacheEntry>>;
+
+        std::mutex mutex;
+        // Most recently used first.
+        Order order;
+        std::unordered_map<std::string, Order::iterator> index;
+        std::uint64_t bytes = 0;
+    };
+
+    static std::uint64_t cost(const std::string& url, const CacheEntry& entry);
+    Shard& shardFor(const std::string& url);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::uint64_t shardBudget;
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> evictions{0};
+};
+
+}  // namespace mbgl
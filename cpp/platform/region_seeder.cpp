@@ -0,0 +1,252 @@
+#include "region_seeder.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <mbgl/storage/file_source_manager.hpp>
+#include <mbgl/storage/response.hpp>
+#include <mbgl/style/source.hpp>
+#include <mbgl/style/style.hpp>
+#include <mbgl/style/types.hpp>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "log.hpp"
+#include "tile_cover.hpp"
+
+namespace mbgl {
+
+// Shared with the callbacks and observers on the database thread, which can
+// outlive a seed() call. `generation` changes with every seed() and
+// cancel(); callbacks of an older generation are dropped.
+struct RegionSeeder::State {
+    std::mutex mutex;
+    std::uint64_t generation = 0;
+    std::optional<OfflineRegion> region;
+    ProgressCallback callback;
+    Progress progress;
+};
+
+namespace {
+
+// Identifies a region in the offline database, so seeding it again resumes
+// the stored download instead of creating a second region.
+OfflineRegionMetadata regionKey(const RegionSeeder::Region& region) {
+    std::ostringstream key;
+    key.precision(17);
+    key << "slint-seed|" << region.styleUrl << '|' << region.bounds.south()
+        << ',' << region.bounds.west() << ',' << region.bounds.north() << ','
+        << region.bounds.east() << '|' << region.minZoom << '-'
+        << region.maxZoom << '@' << region.pixelRatio;
+    const std::string text = key.str();
+    return OfflineRegionMetadata(text.begin(), text.end());
+}
+
+std::string describe(const std::exception_ptr& error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "unknown error";
+    }
+}
+
+}  // namespace
+
+class RegionSeeder::Observer : public OfflineRegionObserver {
+public:
+    Observer(std::shared_ptr<State> state_, std::uint64_t generation_)
+        : state(std::move(state_)), generation(generation_) {
+    }
+
+    void statusChanged(OfflineRegionStatus status) override {
+        ProgressCallback callback;
+        Progress progress;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->generation != generation) {
+                return;
+            }
+            auto& p = state->progress;
+            p.complete = status.complete();
+            p.active = !p.complete && status.downloadState ==
+                                          OfflineRegionDownloadState::Active;
+            p.completedResources = status.completedResourceCount;
+            p.requiredResources = status.requiredResourceCount;
+            p.requiredResourcesPrecise = status.requiredResourceCountIsPrecise;
+            p.completedBytes = status.completedResourceSize;
+            if (p.complete) {
+                p.error.clear();
+            }
+            callback = state->callback;
+            progress = p;
+        }
+        if (callback) {
+            callback(progress);
+        }
+    }
+
+    // The download keeps the failed request alive and the network file
+    // source (CustomFileSource) retries it; remember the failure so the
+    // next progress report explains a stalled count.
+    void responseError(Response::Error error) override {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->generation == generation) {
+            state->progress.error = error.message;
+        }
+    }
+
+private:
+    std::shared_ptr<State> state;
+    std::uint64_t generation;
+};
+
+RegionSeeder::RegionSeeder(const ResourceOptions& resourceOptions,
+                           const ClientOptions& clientOptions)
+    : database(std::static_pointer_cast<DatabaseFileSource>(
+          FileSourceManager::get()->getFileSource(
+              FileSourceType::Database, resourceOptions, clientOptions))),
+      state(std::make_shared<State>()) {
+}
+
+RegionSeeder::~RegionSeeder() {
+    cancel();
+}
+
+RegionSeeder::Estimate RegionSeeder::estimate(const Region& region,
+                                              std::size_t tileSources,
+                                              std::uint64_t averageTileBytes) {
+    Estimate result;
+    result.tiles =
+        region_tile_count(region.bounds.south(), region.bounds.west(),
+                          region.bounds.north(), region.bounds.east(),
+                          region.minZoom, region.maxZoom) *
+        tileSources;
+    result.bytes = result.tiles * averageTileBytes;
+    return result;
+}
+
+std::size_t RegionSeeder::tileSources(style::Style& style) {
+    const auto sources = style.getSources();
+    const auto count = std::count_if(
+        sources.begin(), sources.end(), [](const style::Source* source) {
+            switch (source->getType()) {
+                case style::SourceType::Vector:
+                case style::SourceType::Raster:
+                case style::SourceType::RasterDEM:
+                    return true;
+                default:
+                    return false;
+            }
+        });
+    return std::max<std::size_t>(1, static_cast<std::size_t>(count));
+}
+
+void RegionSeeder::seed(const Region& region, ProgressCallback callback) {
+    if (!database) {
+        return;
+    }
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->region) {
+            database->setOfflineRegionDownloadState(
+                *state->region, OfflineRegionDownloadState::Inactive);
+            state->region.reset();
+        }
+        generation = ++state->generation;
+        state->callback = std::move(callback);
+        state->progress = Progress{};
+        state->progress.active = true;
+    }
+
+    // The callbacks run on the database thread; holding the file source
+    // there would let its last reference be dropped on its own thread.
+    std::weak_ptr<DatabaseFileSource> weakDatabase = database;
+    auto sharedState = state;
+
+    auto fail = [sharedState, generation](const std::string& message) {
+        ProgressCallback callback;
+        Progress progress;
+        {
+            std::lock_guard<std::mutex> lock(sharedState->mutex);
+            if (sharedState->generation != generation) {
+                return;
+            }
+            sharedState->progress.active = false;
+            sharedState->progress.error = message;
+            callback = sharedState->callback;
+            progress = sharedState->progress;
+        }
+        SLINT_MAPLIBRE_LOG(Warning, "RegionSeeder",
+                           "Seeding failed: " << message);
+        if (callback) {
+            callback(progress);
+        }
+    };
+
+    auto start = [weakDatabase, sharedState,
+                  generation](OfflineRegion offlineRegion) {
+        auto database = weakDatabase.lock();
+        if (!database) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(sharedState->mutex);
+        if (sharedState->generation != generation) {
+            return;
+        }
+        database->setOfflineRegionObserver(
+            offlineRegion, std::make_unique<Observer>(sharedState, generation));
+        database->setOfflineRegionDownloadState(
+            offlineRegion, OfflineRegionDownloadState::Active);
+        sharedState->region = std::move(offlineRegion);
+    };
+
+    OfflineTilePyramidRegionDefinition definition(
+        region.styleUrl, region.bounds, region.minZoom, region.maxZoom,
+        region.pixelRatio, false);
+    OfflineRegionMetadata key = regionKey(region);
+
+    database->listOfflineRegions(
+        [weakDatabase, definition, key, start,
+         fail](expected<OfflineRegions, std::exception_ptr> regions) {
+            if (!regions) {
+                fail(describe(regions.error()));
+                return;
+            }
+            for (auto& existing : *regions) {
+                if (existing.getMetadata() == key) {
+                    start(std::move(existing));
+                    return;
+                }
+            }
+            auto database = weakDatabase.lock();
+            if (!database) {
+                return;
+            }
+            database->createOfflineRegion(
+                definition, key,
+                [start,
+                 fail](expected<OfflineRegion, std::exception_ptr> created) {
+                    if (!created) {
+                        fail(describe(created.error()));
+                        return;
+                    }
+                    start(std::move(*created));
+                });
+        });
+}
+
+void RegionSeeder::cancel() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    ++state->generation;
+    if (state->region && database) {
+        database->setOfflineRegionDownloadState(
+            *state->region, OfflineRegionDownloadState::Inactive);
+    }
+    state->region.reset();
+    state->progress.active = false;
+}
+
+}  // namespace mbgl
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mbgl/storage/database_file_source.hpp>
+#include <mbgl/storage/offline.hpp>
+#include <mbgl/storage/resource_options.hpp>
+#include <mbgl/util/client_options.hpp>
+#include <mbgl/util/geo.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace mbgl {
+
+namespace style {
+class Style;
+}  // namespace style
+
+// Downloads a bounding box over a zoom range (style, sprites, glyphs and
+// the tiles of every source) into mbgl's offline database, the persistent
+// cache at ResourceOptions::cachePath(). Seeded resources are never evicted
+// and are served to every map using that cache path, online or not.
+//
+// Regions are keyed by style URL, bounds and zoom range and stored with
+// their progress: seeding the same region again, in this process or after a
+// restart, resumes it and only fetches what is missing or expired. Requests
+// go to the network file source at low priority, so at most half of its
+// workers (and its per-host and bandwidth limits) are spent on seeding and
+// the visible map keeps loading first.
+class RegionSeeder {
+public:
+    struct Region {
+        std::string styleUrl;
+        LatLngBounds bounds = LatLngBounds::world();
+        double minZoom = 0.0;
+        double maxZoom = 14.0;
+        float pixelRatio = 1.0f;
+    };
+
+    struct Estimate {
+        std::uint64_t tiles = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    struct Progress {
+        bool active = false;
+        bool complete = false;
+        std::uint64_t completedResources = 0;
+        // Grows while the style and tilesets are read, until
+        // requiredResourcesPrecise is set.
+        std::uint64_t requiredResources = 0;
+        bool requiredResourcesPrecise = false;
+        std::uint64_t completedBytes = 0;
+        // Last failed request. Seeding keeps going; the network file source
+        // retries the request until it goes through.
+        std::string error;
+    };
+    // Runs on mbgl's database thread.
+    using ProgressCallback = std::function<void(const Progress&)>;
+
+    RegionSeeder(const ResourceOptions& resourceOptions,
+                 const ClientOptions& clientOptions);
+    // Pauses a running download; seeding the region again resumes it.
+    ~RegionSeeder();
+
+    RegionSeeder(const RegionSeeder&) = delete;
+    RegionSeeder& operator=(const RegionSeeder&) = delete;
+
+    // Rough download size before starting: tiles per tile source times the
+    // number of tile sources, at `averageTileBytes` each. Styles, sprites
+    // and glyphs are not counted.
+    static Estimate estimate(const Region& region, std::size_t tileSources,
+                             std::uint64_t averageTileBytes);
+    // Vector, raster and raster-dem sources of a style; at least one, so a
+    // style that is still loading gives a lower bound.
+    static std::size_t tileSources(style::Style& style);
+    // Stand-in for the average tile size until tiles have been downloaded.
+    static constexpr std::uint64_t kTypicalTileBytes = 32 * 1024;
+
+    // Starts (or resumes) seeding `region`, replacing any region this
+    // seeder is currently downloading. Progress is reported as resources
+    // complete and once more when the region is done or fails to start.
+    void seed(const Region& region, ProgressCallback callback);
+
+    // Pauses the current download. What has been stored stays stored.
+    void cancel();
+
+private:
+    class Observer;
+    struct State;
+
+    std::shared_ptr<DatabaseFileSource> database;
+    std::shared_ptr<State> state;
+};
+
+}  // namespace mbgl
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mbgl/storage/response.hpp>
+#include <mbgl/util/chrono.hpp>
+#include <optional>
+
+namespace mbgl {
+
+// When CustomFileSource asks again for a resource whose request is still
+// alive. mbgl leaves this to its network file source (OnlineFileSource
+// normally): tiles on screen and offline downloads keep their request open
+// after an error and expect it to be retried, and expect refreshed data once
+// the response expires. The timings are the ones mbgl's own file source
+// uses. No value means the request is not repeated.
+
+// After `failedRequests` consecutive failures, the last for `reason`.
+inline std::optional<Duration> errorRetryTimeout(
+    Response::Error::Reason reason, std::uint32_t failedRequests,
+    std::optional<Timestamp> retryAfter, Timestamp now) {
+    const std::uint32_t failed = std::max<std::uint32_t>(1, failedRequests);
+    switch (reason) {
+        case Response::Error::Reason::Server:
+            // One second three times, then exponential backoff.
+            return Seconds(std::int64_t{1}
+                           << (failed <= 3 ? 0 : std::min(failed - 3, 31u)));
+        case Response::Error::Reason::Connection:
+            return Seconds(std::int64_t{1} << std::min(failed - 1, 31u));
+        case Response::Error::Reason::RateLimit:
+            if (retryAfter) {
+                return std::max<Duration>(Duration::zero(),
+                                          *retryAfter - now);
+            }
+            return Seconds(5);
+        default:
+            // Success, NotFound and Other are final.
+            return std::nullopt;
+    }
+}
+
+// For a response expiring at `expires`. `expiredRequests` counts the
+// consecutive responses that were already expired when they arrived (a
+// server sending stale data); those are asked for again with exponential
+// backoff rather than immediately.
+inline std::optional<Duration> expirationTimeout(
+    std::optional<Timestamp> expires, std::uint32_t expiredRequests,
+    Timestamp now) {
+    if (expiredRequests > 0) {
+        return Seconds(std::int64_t{1} << std::min(expiredRequests - 1, 31u));
+    }
+    if (expires) {
+        return std::max<Duration>(Duration::zero(), *expires - now);
+    }
+    return std::nullopt;
+}
+
+}  // namespace mbgl
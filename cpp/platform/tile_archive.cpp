@@ -0,0 +1,781 @@
+#include "tile_archive.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <sqlite3.h>
+#include <vector>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "log.hpp"
+
+namespace mbgl {
+
+// One open archive, shared by all requests for it.
+class TileArchive {
+public:
+    struct Info {
+        int minzoom = 0;
+        int maxzoom = 22;
+        std::optional<std::array<double, 4>> bounds;
+        std::optional<std::array<double, 3>> center;
+        // Members of a JSON object (without the braces) to copy into the
+        // TileJSON, e.g. vector_layers.
+        std::string extraJson;
+    };
+
+    virtual ~TileArchive() = default;
+    virtual const Info& info() const = 0;
+    // No value: the archive has no tile at this position.
+    virtual std::optional<std::string> tile(std::uint8_t z, std::uint32_t x,
+                                            std::uint32_t y) = 0;
+};
+
+namespace {
+
+std::string jsonEscape(const std::string& value) {
+    std::string out;
+    out.reserve(value.size() + 2);
+    out += '"';
+    for (const char c : value) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x",
+                              static_cast<unsigned>(c));
+                out += buffer;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+// The members of a JSON object, i.e. the text between its outer braces.
+std::string objectMembers(const std::string& json) {
+    const auto begin = json.find('{');
+    const auto end = json.rfind('}');
+    if (begin == std::string::npos || end == std::string::npos ||
+        end <= begin) {
+        return {};
+    }
+    std::string members = json.substr(begin + 1, end - begin - 1);
+    if (members.find_first_not_of(" \t\r\n") == std::string::npos) {
+        return {};
+    }
+    return members;
+}
+
+std::string buildTileJSON(const std::string& archiveUrl,
+                          const TileArchive::Info& info) {
+    std::string json = "{";
+    // Archive metadata first so our own fields win on duplicate keys.
+    if (!info.extraJson.empty()) {
+        json += info.extraJson;
+        json += ',';
+    }
+    json += "\"tilejson\":\"3.0.0\",\"scheme\":\"xyz\",\"tiles\":[";
+    json += jsonEscape(archiveUrl + "/{z}/{x}/{y}");
+    json += "],\"minzoom\":" + std::to_string(info.minzoom);
+    json += ",\"maxzoom\":" + std::to_string(info.maxzoom);
+    const auto number = [](double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.7g", value);
+        return std::string(buffer);
+    };
+    if (info.bounds) {
+        json += ",\"bounds\":[";
+        for (std::size_t i = 0; i < 4; ++i) {
+            json += (i ? "," : "") + number((*info.bounds)[i]);
+        }
+        json += ']';
+    }
+    if (info.center) {
+        json += ",\"center\":[";
+        for (std::size_t i = 0; i < 3; ++i) {
+            json += (i ? "," : "") + number((*info.center)[i]);
+        }
+        json += ']';
+    }
+    json += '}';
+    return json;
+}
+
+bool isGzip(const char* data, std::size_t size) {
+    return size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
+           static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+// Inflates gzip or zlib data.
+std::optional<std::string> inflateData(const char* data, std::size_t size) {
+    z_stream stream{};
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return std::nullopt;
+    }
+    std::string out(std::max<std::size_t>(size * 4, 1024), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (stream.total_out == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        stream.next_out = reinterpret_cast<Bytef*>(out.data()) +
+                          stream.total_out;
+        stream.avail_out = static_cast<uInt>(out.size() - stream.total_out);
+        status = inflate(&stream, Z_NO_FLUSH);
+    }
+    const auto produced = stream.total_out;
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        return std::nullopt;
+    }
+    out.resize(produced);
+    return out;
+}
+
+std::string tileBytes(const char* data, std::size_t size, bool gzipped) {
+    if (gzipped || isGzip(data, size)) {
+        if (auto inflated = inflateData(data, size)) {
+            return std::move(*inflated);
+        }
+    }
+    return std::string(data, size);
+}
+
+// --- MBTiles ---
+
+class MBTilesArchive final : public TileArchive {
+public:
+    static std::unique_ptr<MBTilesArchive> open(const std::string& path) {
+        sqlite3* db = nullptr;
+        // immutable=1: no locking or change detection; the archive is
+        // treated as a read-only asset for as long as it is open.
+        const std::string uri = "file:" + path + "?immutable=1";
+        if (sqlite3_open_v2(uri.c_str(), &db,
+                            SQLITE_OPEN_READONLY | SQLITE_OPEN_URI |
+                                SQLITE_OPEN_NOMUTEX,
+                            nullptr) != SQLITE_OK) {
+            sqlite3_close(db);
+            return nullptr;
+        }
+        auto archive = std::unique_ptr<MBTilesArchive>(new MBTilesArchive(db));
+        if (!archive->prepare()) {
+            return nullptr;
+        }
+        return archive;
+    }
+
+    ~MBTilesArchive() override {
+        sqlite3_finalize(tileStmt);
+        sqlite3_close(db);
+    }
+
+    const TileArchive::Info& info() const override {
+        return archiveInfo;
+    }
+
+    std::optional<std::string> tile(std::uint8_t z, std::uint32_t x,
+                                    std::uint32_t y) override {
+        std::string stored;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // MBTiles rows count from the bottom (TMS).
+            const std::int64_t row = (std::int64_t{1} << z) - 1 - y;
+            sqlite3_bind_int(tileStmt, 1, z);
+            sqlite3_bind_int64(tileStmt, 2, x);
+            sqlite3_bind_int64(tileStmt, 3, row);
+            const bool found = sqlite3_step(tileStmt) == SQLITE_ROW;
+            if (found) {
+                const auto* blob = static_cast<const char*>(
+                    sqlite3_column_blob(tileStmt, 0));
+                stored.assign(blob ? blob : "",
+                              static_cast<std::size_t>(
+                                  sqlite3_column_bytes(tileStmt, 0)));
+            }
+            sqlite3_reset(tileStmt);
+            if (!found) {
+                return std::nullopt;
+            }
+        }
+        // Inflate outside the lock so other workers can read meanwhile.
+        if (isGzip(stored.data(), stored.size())) {
+            return tileBytes(stored.data(), stored.size(), true);
+        }
+        return stored;
+    }
+
+private:
+    explicit MBTilesArchive(sqlite3* db_) : db(db_) {
+    }
+
+    bool prepare() {
+        // Map the whole archive (up to 1 GiB) instead of copying pages
+        // through SQLite's page cache.
+        sqlite3_exec(db, "PRAGMA mmap_size = 1073741824;", nullptr, nullptr,
+                     nullptr);
+        if (sqlite3_prepare_v2(db,
+                               "SELECT tile_data FROM tiles WHERE "
+                               "zoom_level = ?1 AND tile_column = ?2 AND "
+                               "tile_row = ?3",
+                               -1, &tileStmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT name, value FROM metadata", -1,
+                               &stmt, nullptr) != SQLITE_OK) {
+            return true;  // metadata is optional
+        }
+        std::string extra;
+        const auto append = [&extra](const std::string& member) {
+            if (!member.empty()) {
+                extra += extra.empty() ? "" : ",";
+                extra += member;
+            }
+        };
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const auto* name = sqlite3_column_text(stmt, 0);
+            const auto* value = sqlite3_column_text(stmt, 1);
+            if (!name || !value) {
+                continue;
+            }
+            const std::string key(reinterpret_cast<const char*>(name));
+            const std::string text(reinterpret_cast<const char*>(value));
+            if (key == "minzoom") {
+                archiveInfo.minzoom = std::atoi(text.c_str());
+            } else if (key == "maxzoom") {
+                archiveInfo.maxzoom = std::atoi(text.c_str());
+            } else if (key == "bounds") {
+                std::array<double, 4> b{};
+                if (std::sscanf(text.c_str(), "%lf,%lf,%lf,%lf", &b[0], &b[1],
+                                &b[2], &b[3]) == 4) {
+                    archiveInfo.bounds = b;
+                }
+            } else if (key == "center") {
+                std::array<double, 3> c{};
+                if (std::sscanf(text.c_str(), "%lf,%lf,%lf", &c[0], &c[1],
+                                &c[2]) == 3) {
+                    archiveInfo.center = c;
+                }
+            } else if (key == "json") {
+                append(objectMembers(text));
+            } else if (key == "name" || key == "attribution" ||
+                       key == "description") {
+                append(jsonEscape(key) + ":" + jsonEscape(text));
+            }
+        }
+        sqlite3_finalize(stmt);
+        archiveInfo.extraJson = std::move(extra);
+        return true;
+    }
+
+    std::mutex mutex;
+    sqlite3* db;
+    sqlite3_stmt* tileStmt = nullptr;
+    Info archiveInfo;
+};
+
+// --- PMTiles ---
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    static std::unique_ptr<MappedFile> open(const std::string& path) {
+        auto file = std::unique_ptr<MappedFile>(new MappedFile());
+#ifdef _WIN32
+        file->handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                   nullptr, OPEN_EXISTING,
+                                   FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file->handle == INVALID_HANDLE_VALUE) {
+            return nullptr;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file->handle, &size) || size.QuadPart == 0) {
+            return nullptr;
+        }
+        file->length = static_cast<std::size_t>(size.QuadPart);
+        file->mapping = CreateFileMappingA(file->handle, nullptr,
+                                           PAGE_READONLY, 0, 0, nullptr);
+        if (!file->mapping) {
+            return nullptr;
+        }
+        file->bytes = static_cast<const std::uint8_t*>(
+            MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        file->length = static_cast<std::size_t>(st.st_size);
+        void* address =
+            mmap(nullptr, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return nullptr;
+        }
+        // Tiles are read in no particular order.
+        madvise(address, file->length, MADV_RANDOM);
+        file->bytes = static_cast<const std::uint8_t*>(address);
+#endif
+        if (!file->bytes) {
+            return nullptr;
+        }
+        return file;
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) {
+            UnmapViewOfFile(bytes);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle);
+        }
+#else
+        if (bytes) {
+            munmap(const_cast<std::uint8_t*>(bytes), length);
+        }
+#endif
+    }
+
+    const std::uint8_t* data() const {
+        return bytes;
+    }
+    std::size_t size() const {
+        return length;
+    }
+
+    // Whether [offset, offset + count) lies inside the file.
+    bool contains(std::uint64_t offset, std::uint64_t count) const {
+        return offset <= length && count <= length - offset;
+    }
+
+private:
+    MappedFile() = default;
+
+    const std::uint8_t* bytes = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+template <typename T>
+T readLE(const std::uint8_t* p) {
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool readVarint(const std::uint8_t*& p, const std::uint8_t* end,
+                std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const std::uint8_t byte = *p++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+class PMTilesArchive final : public TileArchive {
+public:
+    static std::unique_ptr<PMTilesArchive> open(const std::string& path) {
+        auto file = MappedFile::open(path);
+        if (!file || file->size() < kHeaderSize ||
+            std::memcmp(file->data(), "PMTiles", 7) != 0 ||
+            file->data()[7] != 3) {
+            return nullptr;
+        }
+        std::unique_ptr<PMTilesArchive> archive(
+            new PMTilesArchive(std::move(file)));
+        if (!archive->readHeader()) {
+            return nullptr;
+        }
+        return archive;
+    }
+
+    const TileArchive::Info& info() const override {
+        return archiveInfo;
+    }
+
+    std::optional<std::string> tile(std::uint8_t z, std::uint32_t x,
+                                    std::uint32_t y) override {
+        if (z < archiveInfo.minzoom || z > archiveInfo.maxzoom) {
+            return std::nullopt;
+        }
+        const std::uint64_t id = pmtilesTileId(z, x, y);
+        std::shared_ptr<const Directory> directory = root;
+        // The spec limits the tree to three levels below the root.
+        for (int depth = 0; depth < 4 && directory; ++depth) {
+            auto it = std::upper_bound(
+                directory->begin(), directory->end(), id,
+                [](std::uint64_t value, const Entry& entry) {
+                    return value < entry.tileId;
+                });
+            if (it == directory->begin()) {
+                return std::nullopt;
+            }
+            const Entry& entry = *std::prev(it);
+            if (entry.runLength > 0) {
+                if (id >= entry.tileId + entry.runLength ||
+                    !file->contains(tileDataOffset + entry.offset,
+                                    entry.length)) {
+                    return std::nullopt;
+                }
+                const auto* bytes = reinterpret_cast<const char*>(
+                    file->data() + tileDataOffset + entry.offset);
+                return tileBytes(bytes, entry.length, tileCompression == 2);
+            }
+            directory = leafDirectory(leafOffset + entry.offset, entry.length);
+        }
+        return std::nullopt;
+    }
+
+private:
+    static constexpr std::size_t kHeaderSize = 127;
+    // Compression codes from the PMTiles v3 header.
+    static constexpr std::uint8_t kCompressionNone = 1;
+    static constexpr std::uint8_t kCompressionGzip = 2;
+
+    struct Entry {
+        std::uint64_t tileId;
+        std::uint64_t offset;
+        std::uint32_t length;
+        // 0 marks a leaf directory rather than tile data.
+        std::uint32_t runLength;
+    };
+    using Directory = std::vector<Entry>;
+
+    explicit PMTilesArchive(std::unique_ptr<MappedFile> file_)
+        : file(std::move(file_)) {
+    }
+
+    bool readHeader() {
+        const std::uint8_t* h = file->data();
+        const auto rootOffset = readLE<std::uint64_t>(h + 8);
+        const auto rootLength = readLE<std::uint64_t>(h + 16);
+        const auto metadataOffset = readLE<std::uint64_t>(h + 24);
+        const auto metadataLength = readLE<std::uint64_t>(h + 32);
+        leafOffset = readLE<std::uint64_t>(h + 40);
+        tileDataOffset = readLE<std::uint64_t>(h + 56);
+        internalCompression = h[97];
+        tileCompression = h[98];
+        archiveInfo.minzoom = h[100];
+        archiveInfo.maxzoom = h[101];
+        const auto degrees = [h](std::size_t offset) {
+            return readLE<std::int32_t>(h + offset) / 1e7;
+        };
+        archiveInfo.bounds = std::array<double, 4>{degrees(102), degrees(106),
+                                                   degrees(110), degrees(114)};
+        archiveInfo.center =
+            std::array<double, 3>{degrees(119), degrees(123), double(h[118])};
+
+        if (internalCompression != kCompressionNone &&
+            internalCompression != kCompressionGzip) {
+            SLINT_MAPLIBRE_LOG(Warning, "TileArchive",
+                               "unsupported PMTiles directory compression "
+                                   << int(internalCompression));
+            return false;
+        }
+        if (tileCompression != kCompressionNone &&
+            tileCompression != kCompressionGzip && tileCompression != 0) {
+            SLINT_MAPLIBRE_LOG(Warning, "TileArchive",
+                               "unsupported PMTiles tile compression "
+                                   << int(tileCompression));
+            return false;
+        }
+
+        root = parseDirectory(rootOffset, rootLength);
+        if (!root) {
+            return false;
+        }
+        if (metadataLength > 0) {
+            if (auto metadata = section(metadataOffset, metadataLength)) {
+                archiveInfo.extraJson = objectMembers(*metadata);
+            }
+        }
+        return true;
+    }
+
+    // A directory or metadata section, decompressed.
+    std::optional<std::string> section(std::uint64_t offset,
+                                       std::uint64_t length) const {
+        if (!file->contains(offset, length)) {
+            return std::nullopt;
+        }
+        const auto* bytes =
+            reinterpret_cast<const char*>(file->data() + offset);
+        if (internalCompression == kCompressionGzip) {
+            return inflateData(bytes, length);
+        }
+        return std::string(bytes, length);
+    }
+
+    std::shared_ptr<const Directory> parseDirectory(
+        std::uint64_t offset, std::uint64_t length) const {
+        const auto bytes = section(offset, length);
+        if (!bytes) {
+            return nullptr;
+        }
+        const auto* p = reinterpret_cast<const std::uint8_t*>(bytes->data());
+        const auto* end = p + bytes->size();
+
+        std::uint64_t count = 0;
+        if (!readVarint(p, end, count) || count > bytes->size()) {
+            return nullptr;
+        }
+        auto directory = std::make_shared<Directory>(count);
+        std::uint64_t value = 0;
+        std::uint64_t lastId = 0;
+        for (auto& entry : *directory) {
+            if (!readVarint(p, end, value)) {
+                return nullptr;
+            }
+            lastId += value;
+            entry.tileId = lastId;
+        }
+        for (auto& entry : *directory) {
+            if (!readVarint(p, end, value)) {
+                return nullptr;
+            }
+            entry.runLength = static_cast<std::uint32_t>(value);
+        }
+        for (auto& entry : *directory) {
+            if (!readVarint(p, end, value)) {
+                return nullptr;
+            }
+            entry.length = static_cast<std::uint32_t>(value);
+        }
+        for (std::size_t i = 0; i < directory->size(); ++i) {
+            if (!readVarint(p, end, value)) {
+                return nullptr;
+            }
+            auto& entry = (*directory)[i];
+            // 0 means "directly after the previous entry".
+            if (value == 0 && i > 0) {
+                const auto& previous = (*directory)[i - 1];
+                entry.offset = previous.offset + previous.length;
+            } else {
+                entry.offset = value - 1;
+            }
+        }
+        return directory;
+    }
+
+    std::shared_ptr<const Directory> leafDirectory(std::uint64_t offset,
+                                                   std::uint64_t length) {
+        {
+            std::lock_guard<std::mutex> lock(leafMutex);
+            if (auto it = leaves.find(offset); it != leaves.end()) {
+                return it->second;
+            }
+        }
+        auto directory = parseDirectory(offset, length);
+        if (directory) {
+            std::lock_guard<std::mutex> lock(leafMutex);
+            // Leaves around the viewport are few; start over rather than
+            // tracking recency once many have been visited.
+            if (leaves.size() >= kMaxCachedLeaves) {
+                leaves.clear();
+            }
+            leaves.emplace(offset, directory);
+        }
+        return directory;
+    }
+
+    static constexpr std::size_t kMaxCachedLeaves = 64;
+
+    std::unique_ptr<MappedFile> file;
+    std::uint64_t leafOffset = 0;
+    std::uint64_t tileDataOffset = 0;
+    std::uint8_t internalCompression = 0;
+    std::uint8_t tileCompression = 0;
+    Info archiveInfo;
+    std::shared_ptr<const Directory> root;
+
+    std::mutex leafMutex;
+    std::map<std::uint64_t, std::shared_ptr<const Directory>> leaves;
+};
+
+// Splits "scheme://path[/z/x/y]". On Windows "/C:/..." becomes "C:/...".
+struct ArchiveUrl {
+    std::string scheme;
+    std::string archive;  // the URL without the tile suffix
+    std::string path;
+    std::optional<std::array<std::uint32_t, 3>> zxy;
+};
+
+std::optional<ArchiveUrl> parseArchiveUrl(const std::string& url,
+                                          bool isTile) {
+    const auto schemeEnd = url.find("://");
+    if (schemeEnd == std::string::npos) {
+        return std::nullopt;
+    }
+    ArchiveUrl parsed;
+    parsed.scheme = url.substr(0, schemeEnd);
+    parsed.archive = url;
+    if (isTile) {
+        std::array<std::uint32_t, 3> zxy{};
+        std::size_t end = url.size();
+        for (int i = 2; i >= 0; --i) {
+            const auto slash = url.rfind('/', end - 1);
+            if (slash == std::string::npos || slash <= schemeEnd + 2) {
+                return std::nullopt;
+            }
+            const char* first = url.data() + slash + 1;
+            const char* last = url.data() + end;
+            const auto result = std::from_chars(first, last, zxy[i]);
+            if (result.ec != std::errc() || result.ptr != last) {
+                return std::nullopt;
+            }
+            end = slash;
+        }
+        parsed.zxy = zxy;
+        parsed.archive = url.substr(0, end);
+    }
+    parsed.path = parsed.archive.substr(schemeEnd + 3);
+#ifdef _WIN32
+    if (parsed.path.size() > 2 && parsed.path[0] == '/' &&
+        parsed.path[2] == ':') {
+        parsed.path.erase(0, 1);
+    }
+#endif
+    return parsed;
+}
+
+}  // namespace
+
+std::uint64_t pmtilesTileId(std::uint8_t z, std::uint32_t x,
+                            std::uint32_t y) {
+    std::uint64_t id = ((std::uint64_t{1} << (2 * z)) - 1) / 3;
+    for (std::uint32_t s = z ? (std::uint32_t{1} << (z - 1)) : 0; s > 0;
+         s >>= 1) {
+        const std::uint32_t rx = (x & s) ? 1 : 0;
+        const std::uint32_t ry = (y & s) ? 1 : 0;
+        id += std::uint64_t{s} * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return id;
+}
+
+TileArchives::TileArchives() = default;
+TileArchives::~TileArchives() = default;
+
+bool TileArchives::isArchiveUrl(const std::string& url) {
+    return url.rfind("mbtiles://", 0) == 0 || url.rfind("pmtiles://", 0) == 0;
+}
+
+Response TileArchives::fetch(const Resource& resource) {
+    Response response;
+    const bool isTile = resource.kind == Resource::Kind::Tile;
+    const auto url = parseArchiveUrl(resource.url, isTile);
+    if (!url) {
+        response.error = std::make_unique<Response::Error>(
+            Response::Error::Reason::Other,
+            "malformed archive URL " + resource.url);
+        return response;
+    }
+    auto archive = open(url->scheme, url->path);
+    if (!archive) {
+        response.error = std::make_unique<Response::Error>(
+            Response::Error::Reason::NotFound,
+            "cannot open archive " + url->path);
+        return response;
+    }
+
+    if (!isTile) {
+        response.data = std::make_shared<const std::string>(
+            buildTileJSON(url->archive, archive->info()));
+        return response;
+    }
+    const auto& zxy = *url->zxy;
+    if (zxy[0] > 30) {
+        response.noContent = true;
+        return response;
+    }
+    if (auto tile = archive->tile(static_cast<std::uint8_t>(zxy[0]), zxy[1],
+                                  zxy[2])) {
+        response.data = std::make_shared<const std::string>(std::move(*tile));
+    } else {
+        response.noContent = true;
+    }
+    return response;
+}
+
+std::shared_ptr<TileArchive> TileArchives::open(const std::string& scheme,
+                                                const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string key = scheme + ":" + path;
+    if (auto it = archives.find(key); it != archives.end()) {
+        return it->second;
+    }
+    std::shared_ptr<TileArchive> archive;
+    if (scheme == "mbtiles") {
+        archive = MBTilesArchive::open(path);
+    } else if (scheme == "pmtiles") {
+        archive = PMTilesArchive::open(path);
+    }
+    if (archive) {
+        SLINT_MAPLIBRE_LOG(Info, "TileArchive", "opened " << path);
+        // Failures are not remembered, so an archive copied into place
+        // later is picked up by the next request.
+        archives.emplace(key, archive);
+    } else {
+        SLINT_MAPLIBRE_LOG(Warning, "TileArchive", "cannot open " << path);
+    }
+    return archive;
+}
+
+}  // namespace mbgl
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mbgl/storage/resource.hpp>
+#include <mbgl/storage/response.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace mbgl {
+
+class TileArchive;
+
+// Offline tiles from local MBTiles and PMTiles (v3) archives, addressed as
+//
+//   mbtiles:///path/to/file.mbtiles            -> TileJSON for the archive
+//   mbtiles:///path/to/file.mbtiles/{z}/{x}/{y} -> tile data
+//
+// and likewise with pmtiles://. The TileJSON points its tile template back
+// at the archive, so a style source only needs the archive URL. MBTiles is
+// read through SQLite with memory-mapped I/O; PMTiles is memory-mapped and
+// its directories are walked in place. Gzip-compressed tiles are inflated
+// before they are handed to mbgl. Archives stay open until the TileArchives
+// object is destroyed.
+class TileArchives {
+public:
+    TileArchives();
+    ~TileArchives();
+
+    static bool isArchiveUrl(const std::string& url);
+
+    // Thread-safe; runs on a fetch worker.
+    Response fetch(const Resource& resource);
+
+private:
+    std::shared_ptr<TileArchive> open(const std::string& scheme,
+                                      const std::string& path);
+
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<TileArchive>> archives;
+};
+
+// PMTiles tile ID: tiles of all lower zoom levels, then the Hilbert index of
+// (x, y) within zoom level z.
+std::uint64_t pmtilesTileId(std::uint8_t z, std::uint32_t x, std::uint32_t y);
+
+}  // namespace mbgl
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace mbgl {
+
+// Download budget of `rate` bytes per second, shared by all fetch workers,
+// that allows bursts of up to `burst` bytes. Bytes are reported after they
+// have arrived and the caller sleeps for the returned delay: libcurl's write
+// callback cannot hand data back, so the bucket goes into debt rather than
+// refusing, and the sleep stalls the socket until the debt is repaid.
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(std::uint64_t rate_, std::uint64_t burst_,
+                Clock::time_point now = Clock::now())
+        : rate(static_cast<double>(std::max<std::uint64_t>(1, rate_))),
+          burst(static_cast<double>(burst_)),
+          tokens(burst),
+          last(now) {
+    }
+
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket& operator=(const TokenBucket&) = delete;
+
+    Clock::duration take(std::uint64_t bytes, Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (now > last) {
+            const double elapsed =
+                std::chrono::duration<double>(now - last).count();
+            tokens = std::min(burst, tokens + elapsed * rate);
+            last = now;
+        }
+        tokens -= static_cast<double>(bytes);
+        if (tokens >= 0) {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(-tokens / rate));
+    }
+
+    Clock::duration take(std::uint64_t bytes) {
+        return take(bytes, Clock::now());
+    }
+
+private:
+    std::mutex mutex;
+    const double rate;
+    const double burst;
+    double tokens;
+    Clock::time_point last;
+};
+
+}  // namespace mbgl
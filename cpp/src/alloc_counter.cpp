@@ -0,0 +1,107 @@
+#include "alloc_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<std::uint64_t> allocations{0};
+std::atomic<std::uint64_t> bytes{0};
+
+void count(std::size_t size) {
+    alloc_counter::note(size);
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void* allocate(std::size_t size) {
+    count(size);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* allocate_aligned(std::size_t size, std::align_val_t alignment) {
+    count(size);
+    const auto align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    // The CRT has no aligned_alloc; its aligned blocks need _aligned_free.
+    if (void* p = _aligned_malloc(std::max<std::size_t>(size, 1), align)) {
+        return p;
+    }
+#else
+    // aligned_alloc wants a multiple of the alignment.
+    const std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) /
+                                align * align;
+    if (void* p = std::aligned_alloc(align, rounded)) {
+        return p;
+    }
+#endif
+    throw std::bad_alloc();
+}
+
+void free_aligned(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+}  // namespace
+
+namespace alloc_counter {
+
+void start() {
+    counting = true;
+}
+
+void stop() {
+    counting = false;
+}
+
+Counts counts() {
+    return {allocations.load(), bytes.load()};
+}
+
+void reset() {
+    allocations = 0;
+    bytes = 0;
+}
+
+}  // namespace alloc_counter
+
+// The array and nothrow forms forward to these by default.
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    free_aligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    free_aligned(p);
+}
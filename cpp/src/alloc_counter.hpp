@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counts heap allocations made through operator new. Linking
+// alloc_counter.cpp replaces the global allocation functions of the whole
+// executable, so only the perf tests and benchmarks do; everywhere else the
+// counts stay at zero and FrameStats reports no allocations.
+namespace alloc_counter {
+
+struct Counts {
+    std::uint64_t allocations = 0;
+    std::uint64_t bytes = 0;
+
+    Counts& operator+=(const Counts& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        return *this;
+    }
+    Counts operator-(const Counts& other) const {
+        return {allocations - other.allocations, bytes - other.bytes};
+    }
+};
+
+// Allocations made by each thread since it started. Constant-initialized,
+// so the allocation functions can update it from any thread at any time.
+inline thread_local Counts thread_counts;
+
+// Called by the replacement operator new for every allocation.
+inline void note(std::size_t size) noexcept {
+    ++thread_counts.allocations;
+    thread_counts.bytes += size;
+}
+
+// The calling thread's allocations so far; subtract two readings to count
+// the allocations of a scope.
+inline Counts this_thread() noexcept {
+    return thread_counts;
+}
+
+// Allocations on every thread are counted between start() and stop().
+// Defined in alloc_counter.cpp.
+void start();
+void stop();
+Counts counts();
+void reset();
+
+}  // namespace alloc_counter
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "alloc_counter.hpp"
+
+// Where a displayed frame's time goes. Each stage keeps its most recent
+// samples in a ring, from which percentiles are computed on demand, so the
+// numbers follow the device's current behaviour rather than its lifetime
+// average.
+enum class FrameStage : std::size_t {
+    // Pumping mbgl's run loop: input, camera, tile and style work. Time
+    // spent rendering from inside the loop is booked under Render instead.
+    RunLoop,
+    // mbgl drawing the scene.
+    Render,
+    // Copying the rendered image from the GPU.
+    Readback,
+    // Un-premultiplying into the buffer handed to Slint.
+    Convert,
+    // Handing the frame to Slint, recorded by the embedder.
+    Upload,
+    // Everything recorded since the previous end_frame().
+    Frame,
+};
+
+// Thread-safe: stages are usually recorded on the render thread and read on
+// the UI thread.
+//
+// Each stage also counts the heap allocations its recording thread made
+// while in it (MapLibre's worker threads are not attributed), provided the
+// executable links alloc_counter.cpp. The goal for a steady-state frame is
+// none at all.
+class FrameStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t kStageCount =
+        static_cast<std::size_t>(FrameStage::Frame) + 1;
+
+    struct Summary {
+        std::size_t samples = 0;
+        double p50_ms = 0.0;
+        double p95_ms = 0.0;
+        double p99_ms = 0.0;
+        double max_ms = 0.0;
+    };
+
+    using Allocations = alloc_counter::Counts;
+
+    // Records the time, and this thread's allocations, from construction to
+    // destruction of the scope.
+    class Timer {
+    public:
+        Timer(FrameStats& stats, FrameStage stage)
+            : stats_(stats),
+              stage_(stage),
+              start_(Clock::now()),
+              allocations_(alloc_counter::this_thread()) {
+        }
+        ~Timer() {
+            stats_.record(stage_, Clock::now() - start_,
+                          alloc_counter::this_thread() - allocations_);
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        FrameStats& stats_;
+        FrameStage stage_;
+        Clock::time_point start_;
+        Allocations allocations_;
+    };
+
+    // Percentiles over the last `window` samples of each stage.
+    explicit FrameStats(std::size_t window = 240)
+        : window_(std::max<std::size_t>(1, window)) {
+    }
+
+    Timer time(FrameStage stage) {
+        return Timer(*this, stage);
+    }
+
+    // Adds a sample; it also counts towards the current frame's total.
+    void record(FrameStage stage, Clock::duration elapsed,
+                Allocations allocations = {}) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            elapsed)
+                            .count();
+        std::lock_guard<std::mutex> lock(mutex_);
+        push(stage, ns);
+        if (stage != FrameStage::Frame) {
+            frame_ns_ += ns;
+            allocations_[index(stage)] += allocations;
+            frame_allocations_ += allocations;
+        }
+    }
+
+    // Closes the current frame: its stage times are recorded as one Frame
+    // sample. Call once a frame has been handed to the display.
+    void end_frame() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        push(FrameStage::Frame, frame_ns_);
+        frame_ns_ = 0;
+        allocations_[index(FrameStage::Frame)] += frame_allocations_;
+        ++frames_;
+        if (frame_allocations_.allocations > 0) {
+            ++allocating_frames_;
+        }
+        frame_allocations_ = {};
+    }
+
+    // Heap allocations made inside a stage since construction or the last
+    // reset(). For Frame, the total of the frames closed by end_frame().
+    Allocations allocations(FrameStage stage) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return allocations_[index(stage)];
+    }
+
+    // Frames closed by end_frame() since construction or the last reset(),
+    // and how many of them allocated at all.
+    std::uint64_t frames() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frames_;
+    }
+    std::uint64_t allocating_frames() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return allocating_frames_;
+    }
+
+    // Counts pixel data copied on the way to the display (readback,
+    // conversion) or otherwise passed over in full, so extra copies and
+    // scans show up as a number and not only as time.
+    void add_copied_bytes(std::uint64_t bytes) {
+        copied_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Total since construction or the last reset().
+    std::uint64_t copied_bytes() const {
+        return copied_bytes_.load(std::memory_order_relaxed);
+    }
+
+    Summary summary(FrameStage stage) const {
+        std::vector<double> ms;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto& samples = rings_[index(stage)].samples;
+            ms.reserve(samples.size());
+            for (const std::int64_t ns : samples) {
+                ms.push_back(to_ms(ns));
+            }
+        }
+        return summarize(std::move(ms));
+    }
+
+    // Nearest-rank percentiles of any latencies in milliseconds, e.g. the
+    // benchmarks' request latencies.
+    static Summary summarize(std::vector<double> ms) {
+        Summary result;
+        result.samples = ms.size();
+        if (ms.empty()) {
+            return result;
+        }
+        std::sort(ms.begin(), ms.end());
+        auto percentile = [&](double p) {
+            const auto rank = static_cast<std::size_t>(
+                std::max(1.0, std::ceil(p / 100.0 * ms.size())));
+            return ms[rank - 1];
+        };
+        result.p50_ms = percentile(50.0);
+        result.p95_ms = percentile(95.0);
+        result.p99_ms = percentile(99.0);
+        result.max_ms = ms.back();
+        return result;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_ = {};
+        frame_ns_ = 0;
+        copied_bytes_ = 0;
+        allocations_ = {};
+        frame_allocations_ = {};
+        frames_ = 0;
+        allocating_frames_ = 0;
+    }
+
+private:
+    struct Ring {
+        std::vector<std::int64_t> samples;
+        std::size_t next = 0;
+    };
+
+    static std::size_t index(FrameStage stage) {
+        return static_cast<std::size_t>(stage);
+    }
+
+    static double to_ms(std::int64_t ns) {
+        return static_cast<double>(ns) / 1e6;
+    }
+
+    void push(FrameStage stage, std::int64_t ns) {
+        Ring& ring = rings_[index(stage)];
+        if (ring.samples.size() < window_) {
+            ring.samples.push_back(ns);
+        } else {
+            ring.samples[ring.next] = ns;
+        }
+        ring.next = (ring.next + 1) % window_;
+    }
+
+    const std::size_t window_;
+    mutable std::mutex mutex_;
+    std::array<Ring, kStageCount> rings_{};
+    std::int64_t frame_ns_ = 0;
+    std::atomic<std::uint64_t> copied_bytes_{0};
+    std::array<Allocations, kStageCount> allocations_{};
+    Allocations frame_allocations_;
+    std::uint64_t frames_ = 0;
+    std::uint64_t allocating_frames_ = 0;
+};
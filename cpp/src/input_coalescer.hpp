@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+#include <optional>
+
+// Accumulates drag and wheel input between ticks so the map sees one camera
+// change per frame instead of one per pointer event.
+//
+// Pans and anchored zooms are both similarity transforms of the screen
+// (p -> scale * p + offset), so any sequence of them folds into a single
+// one. take() hands that back either as a plain move or, if the zoom
+// changed, as a single scale about the transform's fixed point.
+class InputCoalescer {
+public:
+    struct Gesture {
+        // true: scaleBy(scale, {x, y}); false: moveBy({x, y}).
+        bool is_scale = false;
+        double scale = 1.0;
+        double x = 0.0;
+        double y = 0.0;
+    };
+
+    void pan(double dx, double dy) {
+        offset_x_ += dx;
+        offset_y_ += dy;
+        pending_ = true;
+    }
+
+    // Scale by `factor` around the screen point (x, y).
+    void zoom(double factor, double x, double y) {
+        scale_ *= factor;
+        offset_x_ = factor * offset_x_ + (1.0 - factor) * x;
+        offset_y_ = factor * offset_y_ + (1.0 - factor) * y;
+        pending_ = true;
+    }
+
+    bool empty() const {
+        return !pending_;
+    }
+
+    // Returns the accumulated change, if any, and resets.
+    std::optional<Gesture> take() {
+        if (!pending_) {
+            return std::nullopt;
+        }
+        Gesture gesture;
+        if (std::abs(1.0 - scale_) > 1e-9) {
+            // Fixed point a of p -> s * p + t: a = t / (1 - s).
+            gesture.is_scale = true;
+            gesture.scale = scale_;
+            gesture.x = offset_x_ / (1.0 - scale_);
+            gesture.y = offset_y_ / (1.0 - scale_);
+        } else {
+            gesture.x = offset_x_;
+            gesture.y = offset_y_;
+        }
+        *this = InputCoalescer{};
+        return gesture;
+    }
+
+private:
+    double scale_ = 1.0;
+    double offset_x_ = 0.0;
+    double offset_y_ = 0.0;
+    bool pending_ = false;
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Recorded user interaction: what the MMapAdapter callbacks received, with
+// timestamps, in a compact binary file that a headless replayer can feed
+// back into SlintMapLibre (see apply_trace_event()).
+//
+// File layout: the 8-byte magic "SMLTRACE", a version byte, then records of
+//   varint   microseconds since the previous record
+//   u8       kind
+//   f32 x N  arguments (N per kind, little endian)
+//   u8       flag                  (DoubleClick only)
+//   varint + bytes  text           (StyleChange and InitialState only)
+// A mouse move takes about 10 bytes. Version 2 added InitialState, which the
+// application records once the map is initialized, before any interaction.
+struct TraceEvent {
+    enum class Kind : std::uint8_t {
+        MousePress = 0,     // x, y
+        MouseRelease = 1,   // x, y
+        MouseMove = 2,      // x, y
+        WheelZoom = 3,      // x, y, delta
+        DoubleClick = 4,    // x, y; flag: shift
+        FlyTo = 5,          // lat, lon, zoom
+        StyleChange = 6,    // text: url
+        PitchChange = 7,    // pitch in degrees
+        BearingChange = 8,  // bearing in degrees
+        Resize = 9,         // width, height
+        // lat, lon, zoom, bearing, pitch in degrees; text: style url
+        InitialState = 10,
+    };
+
+    TraceEvent() = default;
+    TraceEvent(Kind kind_, std::array<float, 5> args_ = {},
+               bool flag_ = false, std::string text_ = {})
+        : kind(kind_), args(args_), flag(flag_), text(std::move(text_)) {
+    }
+
+    Kind kind = Kind::MouseMove;
+    std::array<float, 5> args{};
+    bool flag = false;
+    std::string text;
+    // Since the start of the recording.
+    std::chrono::microseconds time{0};
+};
+
+inline constexpr char kTraceMagic[8] = {'S', 'M', 'L', 'T',
+                                        'R', 'A', 'C', 'E'};
+inline constexpr std::uint8_t kTraceVersion = 2;
+
+inline std::size_t trace_arg_count(TraceEvent::Kind kind) {
+    switch (kind) {
+        case TraceEvent::Kind::WheelZoom:
+        case TraceEvent::Kind::FlyTo:
+            return 3;
+        case TraceEvent::Kind::StyleChange:
+            return 0;
+        case TraceEvent::Kind::PitchChange:
+        case TraceEvent::Kind::BearingChange:
+            return 1;
+        case TraceEvent::Kind::InitialState:
+            return 5;
+        default:
+            return 2;
+    }
+}
+
+// Appends one record, timed relative to `previous`.
+inline void encode_trace_event(std::string& out, const TraceEvent& event,
+                               std::chrono::microseconds previous) {
+    auto put_varint = [&out](std::uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    };
+    const auto delta = event.time > previous ? event.time - previous
+                                             : std::chrono::microseconds(0);
+    put_varint(static_cast<std::uint64_t>(delta.count()));
+    out += static_cast<char>(event.kind);
+    for (std::size_t i = 0; i < trace_arg_count(event.kind); ++i) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &event.args[i], sizeof(bits));
+        for (int shift = 0; shift < 32; shift += 8) {
+            out += static_cast<char>((bits >> shift) & 0xff);
+        }
+    }
+    if (event.kind == TraceEvent::Kind::DoubleClick) {
+        out += static_cast<char>(event.flag ? 1 : 0);
+    }
+    if (event.kind == TraceEvent::Kind::StyleChange ||
+        event.kind == TraceEvent::Kind::InitialState) {
+        put_varint(event.text.size());
+        out += event.text;
+    }
+}
+
+// Parses a whole trace file's contents. Throws std::runtime_error on a
+// wrong magic, an unknown version or kind, or a truncated record.
+inline std::vector<TraceEvent> decode_trace(const std::string& data) {
+    if (data.size() < sizeof(kTraceMagic) + 1 ||
+        std::memcmp(data.data(), kTraceMagic, sizeof(kTraceMagic)) != 0) {
+        throw std::runtime_error("not an interaction trace");
+    }
+    if (static_cast<std::uint8_t>(data[sizeof(kTraceMagic)]) !=
+        kTraceVersion) {
+        throw std::runtime_error("unsupported interaction trace version");
+    }
+    std::size_t pos = sizeof(kTraceMagic) + 1;
+    auto need = [&](std::size_t bytes) {
+        if (data.size() - pos < bytes) {
+            throw std::runtime_error("truncated interaction trace");
+        }
+    };
+    auto get_byte = [&]() {
+        need(1);
+        return static_cast<std::uint8_t>(data[pos++]);
+    };
+    auto get_varint = [&]() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const std::uint8_t byte = get_byte();
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("malformed interaction trace");
+    };
+
+    std::vector<TraceEvent> events;
+    std::chrono::microseconds time{0};
+    while (pos < data.size()) {
+        TraceEvent event;
+        time += std::chrono::microseconds(get_varint());
+        event.time = time;
+        const std::uint8_t kind = get_byte();
+        if (kind >
+            static_cast<std::uint8_t>(TraceEvent::Kind::InitialState)) {
+            throw std::runtime_error("unknown interaction trace event");
+        }
+        event.kind = static_cast<TraceEvent::Kind>(kind);
+        for (std::size_t i = 0; i < trace_arg_count(event.kind); ++i) {
+            std::uint32_t bits = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                bits |= static_cast<std::uint32_t>(get_byte()) << shift;
+            }
+            std::memcpy(&event.args[i], &bits, sizeof(bits));
+        }
+        if (event.kind == TraceEvent::Kind::DoubleClick) {
+            event.flag = get_byte() != 0;
+        }
+        if (event.kind == TraceEvent::Kind::StyleChange ||
+            event.kind == TraceEvent::Kind::InitialState) {
+            const auto length = get_varint();
+            need(length);
+            event.text = data.substr(pos, length);
+            pos += length;
+        }
+        events.push_back(std::move(event));
+    }
+    return events;
+}
+
+inline std::vector<TraceEvent> read_trace(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    const std::string data((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+    return decode_trace(data);
+}
+
+// Writes events to a trace file as they happen, stamping them with the time
+// since construction. Meant for the UI thread, where the adapter callbacks
+// run.
+class TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Throws std::runtime_error if the file cannot be created.
+    explicit TraceRecorder(const std::string& path)
+        : out_(path, std::ios::binary | std::ios::trunc),
+          start_(Clock::now()) {
+        if (!out_) {
+            throw std::runtime_error("cannot create " + path);
+        }
+        out_.write(kTraceMagic, sizeof(kTraceMagic));
+        out_.put(static_cast<char>(kTraceVersion));
+    }
+
+    ~TraceRecorder() {
+        flush();
+    }
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    void record(TraceEvent event) {
+        event.time = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start_);
+        encode_trace_event(buffer_, event, last_);
+        last_ = event.time;
+        // Pointer moves come in bursts; write in batches.
+        if (buffer_.size() >= 4096) {
+            flush();
+        }
+    }
+
+    void flush() {
+        out_.write(buffer_.data(),
+                   static_cast<std::streamsize>(buffer_.size()));
+        out_.flush();
+        buffer_.clear();
+    }
+
+private:
+    std::ofstream out_;
+    Clock::time_point start_;
+    std::chrono::microseconds last_{0};
+    std::string buffer_;
+};
+
+// Performs an event on a map with SlintMapLibre's interface, converting the
+// adapter's values the way the application does. Resize only resizes; the
+// caller initializes the map, and restores InitialState before replaying.
+template <typename Map>
+void apply_trace_event(Map& map, const TraceEvent& event) {
+    const auto& a = event.args;
+    switch (event.kind) {
+        case TraceEvent::Kind::MousePress:
+            map.handle_mouse_press(a[0], a[1]);
+            break;
+        case TraceEvent::Kind::MouseRelease:
+            map.handle_mouse_release(a[0], a[1]);
+            break;
+        case TraceEvent::Kind::MouseMove:
+            map.handle_mouse_move(a[0], a[1], true);
+            break;
+        case TraceEvent::Kind::WheelZoom:
+            map.handle_wheel_zoom(a[0], a[1], a[2]);
+            break;
+        case TraceEvent::Kind::DoubleClick:
+            map.handle_double_click(a[0], a[1], event.flag);
+            break;
+        case TraceEvent::Kind::FlyTo:
+            map.fly_to(static_cast<double>(a[0]), static_cast<double>(a[1]),
+                       static_cast<double>(a[2]));
+            break;
+        case TraceEvent::Kind::StyleChange:
+            map.setStyleUrl(event.text);
+            break;
+        case TraceEvent::Kind::PitchChange:
+            // The map takes the pitch slider's 0..100 for 0..60 degrees.
+            map.set_pitch(static_cast<int>(a[0] / 60.0f * 100.0f));
+            break;
+        case TraceEvent::Kind::BearingChange:
+            map.set_bearing(a[0] / 360.0f * 100.0f);
+            break;
+        case TraceEvent::Kind::Resize:
+            map.resize(static_cast<int>(a[0]), static_cast<int>(a[1]));
+            break;
+        case TraceEvent::Kind::InitialState:
+            break;
+    }
+}
@@ -0,0 +1,77 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace slint_maplibre::log {
+
+namespace {
+
+Level level_from_environment() {
+    const char* value = std::getenv("SLINT_MAPLIBRE_LOG");
+    if (!value) {
+        return Level::Info;
+    }
+    std::string name(value);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    if (name == "trace") return Level::Trace;
+    if (name == "debug") return Level::Debug;
+    if (name == "info") return Level::Info;
+    if (name == "warn" || name == "warning") return Level::Warning;
+    if (name == "error") return Level::Error;
+    if (name == "off" || name == "none") return Level::Off;
+    return Level::Info;
+}
+
+std::atomic<Level>& threshold() {
+    static std::atomic<Level> value{level_from_environment()};
+    return value;
+}
+
+const char* level_name(Level at) {
+    switch (at) {
+        case Level::Trace:
+            return "trace";
+        case Level::Debug:
+            return "debug";
+        case Level::Info:
+            return "info";
+        case Level::Warning:
+            return "warning";
+        case Level::Error:
+            return "error";
+        default:
+            return "";
+    }
+}
+
+}  // namespace
+
+Level level() {
+    return threshold().load(std::memory_order_relaxed);
+}
+
+void set_level(Level value) {
+    threshold().store(value, std::memory_order_relaxed);
+}
+
+void write(Level at, std::string_view tag, std::string_view message) {
+    std::string line;
+    line.reserve(tag.size() + message.size() + 16);
+    line += '[';
+    line += tag;
+    line += "] ";
+    line += level_name(at);
+    line += ": ";
+    line += message;
+    line += '\n';
+    std::fwrite(line.data(), 1, line.size(), stderr);
+}
+
+}  // namespace slint_maplibre::log
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <sstream>
+#include <string_view>
+
+// Lowest level that is compiled in at all (0 = trace ... 4 = error).
+// Statements below it cost nothing, not even the runtime level check.
+// Release builds drop trace logging unless told otherwise.
+#ifndef SLINT_MAPLIBRE_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define SLINT_MAPLIBRE_LOG_MIN_LEVEL 1
+#else
+#define SLINT_MAPLIBRE_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+namespace slint_maplibre::log {
+
+enum class Level { Trace = 0, Debug, Info, Warning, Error, Off };
+
+// Runtime threshold. Defaults to Info, or to the SLINT_MAPLIBRE_LOG
+// environment variable (trace, debug, info, warning, error, off) when set.
+Level level();
+void set_level(Level level);
+
+inline bool enabled(Level at) {
+    return static_cast<int>(at) >= static_cast<int>(level());
+}
+
+// Writes one line to stderr as a single write, without flushing stdout.
+void write(Level at, std::string_view tag, std::string_view message);
+
+}  // namespace slint_maplibre::log
+
+// SLINT_MAPLIBRE_LOG(Debug, "SlintMapLibre", "size " << w << "x" << h);
+// The message is only formatted when the level is enabled.
+#define SLINT_MAPLIBRE_LOG(LEVEL, TAG, MESSAGE)                               \
+    do {                                                                      \
+        constexpr auto slint_maplibre_log_level_ =                            \
+            ::slint_maplibre::log::Level::LEVEL;                              \
+        if constexpr (static_cast<int>(slint_maplibre_log_level_) >=          \
+                      SLINT_MAPLIBRE_LOG_MIN_LEVEL) {                         \
+            if (::slint_maplibre::log::enabled(slint_maplibre_log_level_)) {  \
+                std::ostringstream slint_maplibre_log_stream_;                \
+                slint_maplibre_log_stream_ << MESSAGE;                        \
+                ::slint_maplibre::log::write(                                 \
+                    slint_maplibre_log_level_, TAG,                           \
+                    slint_maplibre_log_stream_.str());                        \
+            }                                                                 \
+        }                                                                     \
+    } while (false)
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "tile_cover.hpp"
+
+// Predicts where a drag is heading and lists the tiles just beyond the
+// viewport in that direction, so they are cached before they scroll into
+// view. Fed with every applied pan; the velocity is smoothed so a single
+// jittery event does not swing the prediction.
+class PanPrefetcher {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Most tiles requested per plan; 0 disables prediction.
+        std::size_t budget = 16;
+        // How far ahead of the motion to look.
+        std::chrono::milliseconds lookahead{500};
+        // Minimum time between two plans.
+        std::chrono::milliseconds interval{150};
+        // Slower drags (screen px/s) are not worth predicting.
+        double min_speed = 100.0;
+    };
+
+    PanPrefetcher() = default;
+    explicit PanPrefetcher(Options options) : options_(options) {
+    }
+
+    void set_budget(std::size_t budget) {
+        options_.budget = budget;
+    }
+
+    // The map content moved by (dx, dy) screen px at `now`, with the map
+    // rotated by `bearing` degrees.
+    void add_pan(double dx, double dy, double bearing, Clock::time_point now) {
+        // The camera moves against the content; rotate into map axes
+        // (x east, y south).
+        const double rad = bearing * M_PI / 180.0;
+        const double wx = -dx * std::cos(rad) + dy * std::sin(rad);
+        const double wy = -dx * std::sin(rad) - dy * std::cos(rad);
+        if (last_pan_ && now > *last_pan_) {
+            const double dt = seconds(now - *last_pan_);
+            if (!moving_ || dt > seconds(options_.lookahead)) {
+                // First sample, or the drag paused: start from this one
+                // rather than average across the gap.
+                vx_ = wx / dt;
+                vy_ = wy / dt;
+                moving_ = true;
+            } else {
+                constexpr double kSmoothing = 0.5;
+                vx_ += kSmoothing * (wx / dt - vx_);
+                vy_ += kSmoothing * (wy / dt - vy_);
+            }
+        }
+        last_pan_ = now;
+    }
+
+    // Forget the current drag (pointer pressed or released).
+    void reset() {
+        *this = PanPrefetcher(options_);
+    }
+
+    // Camera velocity in screen px/s along the map axes.
+    double speed() const {
+        return std::hypot(vx_, vy_);
+    }
+
+    // Tiles that come into view if the drag keeps going, the first to
+    // appear first; empty when nothing is worth fetching right now.
+    std::vector<TileCoordinate> plan(MercatorPoint center, double zoom,
+                                     double width, double height,
+                                     Clock::time_point now) {
+        if (options_.budget == 0 || !last_pan_ ||
+            now - *last_pan_ > options_.interval ||
+            (last_plan_ && now - *last_plan_ < options_.interval) ||
+            speed() < options_.min_speed) {
+            return {};
+        }
+        last_plan_ = now;
+
+        const double world_px = 512.0 * std::exp2(zoom);
+        const double ahead = seconds(options_.lookahead) / world_px;
+        MercatorPoint predicted{center.x + vx_ * ahead,
+                                center.y + vy_ * ahead};
+        predicted.x -= std::floor(predicted.x);
+        predicted.y = std::clamp(predicted.y, 0.0, 1.0);
+
+        const std::uint8_t z = cover_zoom(zoom);
+        const auto visible = tile_cover(center, zoom, width, height, z);
+        const auto upcoming = tile_cover(predicted, zoom, width, height, z);
+
+        // Order by distance from where the camera is now: those tiles
+        // cross the viewport edge first.
+        const double tiles = std::ldexp(1.0, z);
+        auto distance = [&](const TileCoordinate& tile) {
+            double dx = std::abs(tile.x + 0.5 - center.x * tiles);
+            dx = std::min(dx, tiles - dx);
+            const double dy = tile.y + 0.5 - center.y * tiles;
+            return dx * dx + dy * dy;
+        };
+        std::vector<TileCoordinate> result;
+        for (const auto& tile : upcoming) {
+            if (std::find(visible.begin(), visible.end(), tile) ==
+                visible.end()) {
+                result.push_back(tile);
+            }
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [&](const TileCoordinate& a, const TileCoordinate& b) {
+                             return distance(a) < distance(b);
+                         });
+        if (result.size() > options_.budget) {
+            result.resize(options_.budget);
+        }
+        return result;
+    }
+
+private:
+    template <typename Duration>
+    static double seconds(Duration duration) {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    Options options_;
+    double vx_ = 0.0;
+    double vy_ = 0.0;
+    bool moving_ = false;
+    std::optional<Clock::time_point> last_pan_;
+    std::optional<Clock::time_point> last_plan_;
+};
@@ -0,0 +1,284 @@
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define SLINT_MAPLIBRE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SLINT_MAPLIBRE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(SLINT_MAPLIBRE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SLINT_MAPLIBRE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SLINT_MAPLIBRE_TARGET(isa)
+#endif
+
+namespace slint_maplibre {
+
+namespace {
+
+// The vector kernels divide in single precision and truncate. The numerator
+// (at most 255 * 255 + 127) is exact in a float, and a non-integral quotient
+// n / a is at least 1/255 away from the next integer, far more than the
+// division's rounding error, so truncation matches the integer formula.
+inline uint8_t unpremultiply_channel(uint8_t c, uint8_t a) {
+    return static_cast<uint8_t>(std::min(255, (255 * c + a / 2) / a));
+}
+
+void unpremultiply_scalar(const uint8_t* src, uint8_t* dst,
+                          std::size_t pixel_count) {
+    for (std::size_t i = 0; i < pixel_count; ++i, src += 4, dst += 4) {
+        const uint8_t a = src[3];
+        if (a == 255 || a == 0) {
+            std::memcpy(dst, src, 4);
+            continue;
+        }
+        dst[0] = unpremultiply_channel(src[0], a);
+        dst[1] = unpremultiply_channel(src[1], a);
+        dst[2] = unpremultiply_channel(src[2], a);
+        dst[3] = a;
+    }
+}
+
+#if defined(SLINT_MAPLIBRE_X86)
+
+// One pixel per 32-bit lane: (255 * c + a / 2) / a for r, g, b and a.
+SLINT_MAPLIBRE_TARGET("sse4.1")
+inline __m128i divide_pixel_sse41(__m128i p) {
+    const __m128i a = _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(p, 8), p),
+                                    _mm_srli_epi32(a, 1));
+    return _mm_cvttps_epi32(
+        _mm_div_ps(_mm_cvtepi32_ps(n), _mm_cvtepi32_ps(a)));
+}
+
+SLINT_MAPLIBRE_TARGET("sse4.1")
+void unpremultiply_sse41(const uint8_t* src, uint8_t* dst,
+                         std::size_t pixel_count) {
+    const __m128i alpha_bytes = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4, src += 16, dst += 16) {
+        const __m128i px =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i alpha = _mm_and_si128(px, alpha_bytes);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_bytes)) ==
+            0xFFFF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), px);
+            continue;
+        }
+        const __m128i q0 = divide_pixel_sse41(_mm_cvtepu8_epi32(px));
+        const __m128i q1 =
+            divide_pixel_sse41(_mm_cvtepu8_epi32(_mm_srli_si128(px, 4)));
+        const __m128i q2 =
+            divide_pixel_sse41(_mm_cvtepu8_epi32(_mm_srli_si128(px, 8)));
+        const __m128i q3 =
+            divide_pixel_sse41(_mm_cvtepu8_epi32(_mm_srli_si128(px, 12)));
+        // Saturating packs clamp out-of-range quotients to 255.
+        const __m128i out = _mm_packus_epi16(_mm_packs_epi32(q0, q1),
+                                             _mm_packs_epi32(q2, q3));
+        // Keep alpha, and whole pixels whose alpha is zero, from the source.
+        const __m128i keep =
+            _mm_or_si128(_mm_cmpeq_epi32(alpha, zero), alpha_bytes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                         _mm_blendv_epi8(out, px, keep));
+    }
+    unpremultiply_scalar(src, dst, pixel_count - i);
+}
+
+// Two pixels from `src`, one per 128-bit lane.
+SLINT_MAPLIBRE_TARGET("avx2")
+inline __m256i divide_pixels_avx2(const uint8_t* src) {
+    const __m256i p = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+    const __m256i a = _mm256_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i n = _mm256_add_epi32(
+        _mm256_sub_epi32(_mm256_slli_epi32(p, 8), p), _mm256_srli_epi32(a, 1));
+    return _mm256_cvttps_epi32(
+        _mm256_div_ps(_mm256_cvtepi32_ps(n), _mm256_cvtepi32_ps(a)));
+}
+
+SLINT_MAPLIBRE_TARGET("avx2")
+void unpremultiply_avx2(const uint8_t* src, uint8_t* dst,
+                        std::size_t pixel_count) {
+    const __m256i alpha_bytes =
+        _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m256i zero = _mm256_setzero_si256();
+    // The in-lane packs leave even pixels in the low lane and odd pixels in
+    // the high lane; this puts them back in order.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    std::size_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8, src += 32, dst += 32) {
+        const __m256i px =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        const __m256i alpha = _mm256_and_si256(px, alpha_bytes);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alpha_bytes)) ==
+            -1) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), px);
+            continue;
+        }
+        const __m256i q01 = divide_pixels_avx2(src);
+        const __m256i q23 = divide_pixels_avx2(src + 8);
+        const __m256i q45 = divide_pixels_avx2(src + 16);
+        const __m256i q67 = divide_pixels_avx2(src + 24);
+        const __m256i out = _mm256_permutevar8x32_epi32(
+            _mm256_packus_epi16(_mm256_packs_epi32(q01, q23),
+                                _mm256_packs_epi32(q45, q67)),
+            order);
+        const __m256i keep =
+            _mm256_or_si256(_mm256_cmpeq_epi32(alpha, zero), alpha_bytes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),
+                            _mm256_blendv_epi8(out, px, keep));
+    }
+    unpremultiply_sse41(src, dst, pixel_count - i);
+}
+
+bool cpu_has(PixelKernel kernel) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx2 = false;
+    if (osxsave && max_leaf >= 7 && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    return kernel == PixelKernel::Avx2 ? avx2 && sse41 : sse41;
+#else
+    __builtin_cpu_init();
+    return kernel == PixelKernel::Avx2 ? __builtin_cpu_supports("avx2")
+                                       : __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+#endif  // SLINT_MAPLIBRE_X86
+
+#if defined(SLINT_MAPLIBRE_NEON)
+
+// Unpremultiplies one deinterleaved channel of 16 pixels.
+inline uint8x16_t divide_channel_neon(uint8x16_t c, uint8x16_t a,
+                                      const float32x4_t (&alpha)[4]) {
+    const uint8x16_t half = vshrq_n_u8(a, 1);
+    const uint8x8_t scale = vdup_n_u8(255);
+    // 255 * c + a / 2 fits in 16 bits.
+    const uint16x8_t n_lo =
+        vaddw_u8(vmull_u8(vget_low_u8(c), scale), vget_low_u8(half));
+    const uint16x8_t n_hi =
+        vaddw_u8(vmull_u8(vget_high_u8(c), scale), vget_high_u8(half));
+    auto divide = [](uint16x4_t n, float32x4_t d) {
+        return vqmovn_u32(
+            vcvtq_u32_f32(vdivq_f32(vcvtq_f32_u32(vmovl_u16(n)), d)));
+    };
+    const uint16x8_t q_lo = vcombine_u16(divide(vget_low_u16(n_lo), alpha[0]),
+                                         divide(vget_high_u16(n_lo), alpha[1]));
+    const uint16x8_t q_hi = vcombine_u16(divide(vget_low_u16(n_hi), alpha[2]),
+                                         divide(vget_high_u16(n_hi), alpha[3]));
+    const uint8x16_t out = vcombine_u8(vqmovn_u16(q_lo), vqmovn_u16(q_hi));
+    return vbslq_u8(vceqq_u8(a, vdupq_n_u8(0)), c, out);
+}
+
+void unpremultiply_neon(const uint8_t* src, uint8_t* dst,
+                        std::size_t pixel_count) {
+    std::size_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16, src += 64, dst += 64) {
+        uint8x16x4_t px = vld4q_u8(src);
+        if (vminvq_u8(px.val[3]) == 255) {
+            vst4q_u8(dst, px);
+            continue;
+        }
+        const uint16x8_t a_lo = vmovl_u8(vget_low_u8(px.val[3]));
+        const uint16x8_t a_hi = vmovl_u8(vget_high_u8(px.val[3]));
+        const float32x4_t alpha[4] = {
+            vcvtq_f32_u32(vmovl_u16(vget_low_u16(a_lo))),
+            vcvtq_f32_u32(vmovl_u16(vget_high_u16(a_lo))),
+            vcvtq_f32_u32(vmovl_u16(vget_low_u16(a_hi))),
+            vcvtq_f32_u32(vmovl_u16(vget_high_u16(a_hi))),
+        };
+        px.val[0] = divide_channel_neon(px.val[0], px.val[3], alpha);
+        px.val[1] = divide_channel_neon(px.val[1], px.val[3], alpha);
+        px.val[2] = divide_channel_neon(px.val[2], px.val[3], alpha);
+        vst4q_u8(dst, px);
+    }
+    unpremultiply_scalar(src, dst, pixel_count - i);
+}
+
+#endif  // SLINT_MAPLIBRE_NEON
+
+using Kernel = void (*)(const uint8_t*, uint8_t*, std::size_t);
+
+Kernel kernel_function(PixelKernel kernel) {
+    if (!pixel_kernel_supported(kernel)) {
+        return unpremultiply_scalar;
+    }
+    switch (kernel) {
+#if defined(SLINT_MAPLIBRE_X86)
+        case PixelKernel::Sse41:
+            return unpremultiply_sse41;
+        case PixelKernel::Avx2:
+            return unpremultiply_avx2;
+#endif
+#if defined(SLINT_MAPLIBRE_NEON)
+        case PixelKernel::Neon:
+            return unpremultiply_neon;
+#endif
+        default:
+            return unpremultiply_scalar;
+    }
+}
+
+}  // namespace
+
+bool pixel_kernel_supported(PixelKernel kernel) {
+    switch (kernel) {
+        case PixelKernel::Scalar:
+            return true;
+#if defined(SLINT_MAPLIBRE_X86)
+        case PixelKernel::Sse41:
+        case PixelKernel::Avx2: {
+            static const bool sse41 = cpu_has(PixelKernel::Sse41);
+            static const bool avx2 = cpu_has(PixelKernel::Avx2);
+            return kernel == PixelKernel::Avx2 ? avx2 : sse41;
+        }
+#endif
+#if defined(SLINT_MAPLIBRE_NEON)
+        case PixelKernel::Neon:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+PixelKernel best_pixel_kernel() {
+    for (PixelKernel kernel :
+         {PixelKernel::Avx2, PixelKernel::Sse41, PixelKernel::Neon}) {
+        if (pixel_kernel_supported(kernel)) {
+            return kernel;
+        }
+    }
+    return PixelKernel::Scalar;
+}
+
+void unpremultiply_rgba8(const uint8_t* src, uint8_t* dst,
+                         std::size_t pixel_count) {
+    static const Kernel kernel = kernel_function(best_pixel_kernel());
+    kernel(src, dst, pixel_count);
+}
+
+void unpremultiply_rgba8(PixelKernel kernel, const uint8_t* src, uint8_t* dst,
+                         std::size_t pixel_count) {
+    kernel_function(kernel)(src, dst, pixel_count);
+}
+
+}  // namespace slint_maplibre
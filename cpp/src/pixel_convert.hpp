@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace slint_maplibre {
+
+// Instruction-set variants of the pixel conversion kernels.
+enum class PixelKernel { Scalar, Sse41, Avx2, Neon };
+
+// Whether the running CPU can execute `kernel`.
+bool pixel_kernel_supported(PixelKernel kernel);
+
+// The fastest supported kernel; what the dispatching overload uses.
+PixelKernel best_pixel_kernel();
+
+// Converts `pixel_count` premultiplied RGBA8 pixels from `src` into straight
+// alpha in `dst`, rounding exactly like mbgl::util::unpremultiply. Fully
+// transparent pixels are copied unchanged. `src` and `dst` must not overlap.
+void unpremultiply_rgba8(const uint8_t* src, uint8_t* dst,
+                         std::size_t pixel_count);
+
+// Same, forcing a specific kernel. Unsupported kernels fall back to scalar.
+void unpremultiply_rgba8(PixelKernel kernel, const uint8_t* src, uint8_t* dst,
+                         std::size_t pixel_count);
+
+}  // namespace slint_maplibre
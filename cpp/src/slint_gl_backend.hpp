@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <mbgl/gfx/renderable.hpp>
 #include <mbgl/gl/renderable_resource.hpp>
 #include <mbgl/gl/renderer_backend.hpp>
@@ -79,7 +80,9 @@ private:
 };
 
 // RendererFrontend mirroring GLFWRendererFrontend, but render() is driven
-// explicitly from Slint's BeforeRendering callback.
+// explicitly from Slint's BeforeRendering callback. The map calls update()
+// whenever anything visible changed; the update callback is how the owner
+// learns that the next Slint frame has to render the map.
 class SlintGLFrontend final : public mbgl::RendererFrontend {
 public:
     SlintGLFrontend(std::unique_ptr<mbgl::Renderer> renderer_,
@@ -100,6 +103,12 @@ public:
 
     void update(std::shared_ptr<mbgl::UpdateParameters> params) override {
         updateParameters = std::move(params);
+        if (onUpdate)
+            onUpdate();
+    }
+
+    void setUpdateCallback(std::function<void()> callback) {
+        onUpdate = std::move(callback);
     }
 
     const mbgl::TaggedScheduler& getThreadPool() const override {
@@ -116,4 +125,5 @@ private:
     mbgl::gfx::RendererBackend& backend;
     std::unique_ptr<mbgl::Renderer> renderer;
     std::shared_ptr<mbgl::UpdateParameters> updateParameters;
+    std::function<void()> onUpdate;
 };
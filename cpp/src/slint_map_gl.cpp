@@ -4,7 +4,6 @@
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
-#include <iostream>
 #include <mbgl/map/camera.hpp>
 #include <mbgl/map/map_options.hpp>
 #include <mbgl/renderer/renderer.hpp>
@@ -13,14 +12,21 @@
 #include <mbgl/util/chrono.hpp>
 #include <mbgl/util/geo.hpp>
 
+#include "log.hpp"
+#include "tile_cover.hpp"
+
 SlintMapGL::~SlintMapGL() {
     // Orderly shutdown: detach observer, then drop map before frontend/backend.
+    if (file_source && file_source_listener) {
+        file_source->removeResponseListener(file_source_listener);
+    }
     if (frontend) {
         frontend->setObserver(noop_observer);
     }
     map.reset();
     frontend.reset();
     backend.reset();
+    file_source.reset();
     run_loop.reset();
 }
 
@@ -37,12 +43,22 @@ void SlintMapGL::setup(uint32_t fbo, int w, int h,
     auto renderer = std::make_unique<mbgl::Renderer>(*backend, 1.0f);
     frontend = std::make_unique<SlintGLFrontend>(std::move(renderer), *backend);
 
-    observer =
-        std::make_unique<SlintGLRendererObserver>([this]() { repaint = true; });
-    frontend->setObserver(*observer);
+    // Every map change (camera, style, tiles, running transitions) reaches
+    // the frontend as an update; that is what marks the texture stale.
+    frontend->setUpdateCallback([this]() {
+        repaint = true;
+        wake();
+    });
+
+    // Route the map's network requests through our fetch pool.
+    file_source = mbgl::CustomFileSource::installDefault();
+    file_source_listener =
+        file_source->addResponseListener([this]() { wake(); });
 
     mbgl::ResourceOptions ro;
     ro.withCachePath("cache.sqlite").withAssetPath(".");
+    region_seeder =
+        std::make_unique<mbgl::RegionSeeder>(ro, mbgl::ClientOptions());
 
     map = std::make_unique<mbgl::Map>(
         *frontend, *this,
@@ -52,32 +68,106 @@ void SlintMapGL::setup(uint32_t fbo, int w, int h,
             .withPixelRatio(1.0f),
         ro);
 
-    std::cout << "[SlintMapGL] setup fbo=" << fbo << " size=" << w << "x" << h
-              << " style=" << styleUrl << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "SlintMapGL",
+                       "setup fbo=" << fbo << " size=" << w << "x" << h
+                                    << " style=" << styleUrl);
 
     if (const char* e = std::getenv("MAPLIBRE_FLY_MS")) {
         int v = std::atoi(e);
         if (v > 0)
             fly_ms_ = v;
     }
+    if (const char* e = std::getenv("MAPLIBRE_PAN_PREFETCH_TILES")) {
+        int v = std::atoi(e);
+        if (v >= 0)
+            pan_prefetcher.set_budget(static_cast<std::size_t>(v));
+    }
 
     map->getStyle().loadURL(styleUrl);
     map->jumpTo(mbgl::CameraOptions()
                     .withCenter(mbgl::LatLng{35.681, 139.767})
                     .withZoom(10.0));
+    wake();
 }
 
-void SlintMapGL::render() {
+bool SlintMapGL::run_map_loop() {
+    ticks_paused = true;
+    const auto timer = stats->time(FrameStage::RunLoop);
+    apply_pending_input();
     if (run_loop) {
         run_loop->runOnce();
     }
-    if (frontend) {
+    // Transitions and fades keep calling the frontend's update(), which sets
+    // repaint, so this stays true until the map settles.
+    const bool busy = map && (!map_idle.load() || repaint.load());
+    if (busy) {
+        ticks_paused = false;
+    }
+    return busy;
+}
+
+void SlintMapGL::apply_pending_input() {
+    const auto gesture = pending_input.take();
+    if (!gesture || !map) {
+        return;
+    }
+    if (gesture->is_scale) {
+        map->scaleBy(gesture->scale,
+                     mbgl::ScreenCoordinate{gesture->x, gesture->y});
+    } else {
+        map->moveBy({gesture->x, gesture->y});
+        prefetch_pan(gesture->x, gesture->y);
+    }
+}
+
+void SlintMapGL::prefetch_pan(double dx, double dy) {
+    if (!file_source) {
+        return;
+    }
+    const auto now = PanPrefetcher::Clock::now();
+    const auto cam = map->getCameraOptions();
+    pan_prefetcher.add_pan(dx, dy, cam.bearing.value_or(0.0), now);
+    if (!cam.center || !cam.zoom) {
+        return;
+    }
+    const auto size = map->getMapOptions().size();
+    const auto tiles = pan_prefetcher.plan(
+        project_mercator(cam.center->latitude(), cam.center->longitude()),
+        *cam.zoom, size.width, size.height, now);
+    if (!tiles.empty()) {
+        file_source->prefetch(tiles);
+    }
+}
+
+void SlintMapGL::set_wake_callback(std::function<void()> callback) {
+    wake_callback = std::move(callback);
+}
+
+void SlintMapGL::wake() {
+    if (ticks_paused.exchange(false) && wake_callback) {
+        wake_callback();
+    }
+}
+
+bool SlintMapGL::render() {
+    if (!frontend) {
+        return false;
+    }
+    // Render on every Slint frame even if the map is unchanged: tiled GPUs
+    // such as V3D treat the FBO colour attachment as transient, so skipping
+    // the render would leave the borrowed texture blank. Slint itself only
+    // draws when something requested a redraw.
+    const bool changed = repaint.exchange(false);
+    {
+        const auto timer = stats->time(FrameStage::Render);
         frontend->render();
     }
     if ((frame_count_++ % 300) == 0) {
-        std::cout << "[SlintMapGL] render frame=" << frame_count_
-                  << " style_loaded=" << style_loaded.load() << std::endl;
+        SLINT_MAPLIBRE_LOG(Debug, "SlintMapGL",
+                           "render frame=" << frame_count_ << " style_loaded="
+                                           << style_loaded.load());
     }
+    return changed;
 }
 
 // --- Pointer / touch interaction ---
@@ -98,6 +188,8 @@ void SlintMapGL::handle_mouse_press(float x, float y) {
     last_tap_x_ = x;
     last_tap_y_ = y;
     last_pos = {x, y};
+    pan_prefetcher.reset();
+    wake();
 }
 
 void SlintMapGL::handle_mouse_release() {
@@ -107,10 +199,9 @@ void SlintMapGL::handle_mouse_move(float x, float y, bool pressed) {
     if (!pressed || !map)
         return;
     mbgl::Point<double> cur{x, y};
-    map->moveBy(cur - last_pos);
+    pending_input.pan(cur.x - last_pos.x, cur.y - last_pos.y);
     last_pos = cur;
-    map->triggerRepaint();
-    repaint = true;
+    wake();
 }
 
 void SlintMapGL::handle_wheel_zoom(float x, float y, float dy) {
@@ -118,92 +209,146 @@ void SlintMapGL::handle_wheel_zoom(float x, float y, float dy) {
         return;
     constexpr double step = 1.2;
     double scale = (dy < 0.0) ? step : (1.0 / step);
-    map->scaleBy(scale, mbgl::ScreenCoordinate{x, y});
-    map->triggerRepaint();
-    repaint = true;
+    pending_input.zoom(scale, x, y);
+    wake();
 }
 
 void SlintMapGL::handle_double_click(float x, float y, bool shift) {
     if (!map)
         return;
+    apply_pending_input();
     const mbgl::LatLng ll = map->latLngForPixel(mbgl::ScreenCoordinate{x, y});
     const auto cam = map->getCameraOptions();
     double z = cam.zoom.value_or(0.0) + (shift ? -1.0 : 1.0);
     z = std::min(max_zoom_, std::max(min_zoom_, z));
     map->jumpTo(mbgl::CameraOptions().withCenter(ll).withZoom(z));
-    map->triggerRepaint();
-    repaint = true;
 }
 
 // --- Toolbar commands ---
 void SlintMapGL::setStyleUrl(const std::string& url) {
     if (map) {
-        std::cout << "[SlintMapGL] style change: " << url << std::endl;
+        SLINT_MAPLIBRE_LOG(Info, "SlintMapGL", "style change: " << url);
         map->getStyle().loadURL(url);
-        repaint = true;
     }
 }
 
 void SlintMapGL::fly_to(double lat, double lon, double zoom) {
     if (!map)
         return;
+    apply_pending_input();
+    if (file_source) {
+        // mbgl's flyTo zooms out to roughly where both ends are in view;
+        // warm the cache for that and for the destination while it flies.
+        constexpr std::size_t kFlyToPrefetchBudget = 64;
+        const auto cam = map->getCameraOptions();
+        const mbgl::LatLng start = cam.center.value_or(mbgl::LatLng{lat, lon});
+        const double start_zoom = cam.zoom.value_or(zoom);
+        const auto size = map->getMapOptions().size();
+        const double mid_zoom = std::min(
+            {start_zoom, zoom,
+             fit_zoom(project_mercator(start.latitude(), start.longitude()),
+                      project_mercator(lat, lon), size.width, size.height)});
+        file_source->prefetch(fly_to_tiles(
+            start.latitude(), start.longitude(), lat, lon, mid_zoom, zoom,
+            size.width, size.height, kFlyToPrefetchBudget));
+    }
     mbgl::AnimationOptions anim;
     anim.duration = mbgl::Duration(std::chrono::milliseconds(fly_ms_));
     map->flyTo(
         mbgl::CameraOptions().withCenter(mbgl::LatLng{lat, lon}).withZoom(zoom),
         anim);
-    map->triggerRepaint();
-    repaint = true;
+}
+
+mbgl::RegionSeeder::Region SlintMapGL::seed_area(
+    const mbgl::LatLngBounds& bounds, double first_zoom,
+    double last_zoom) const {
+    mbgl::RegionSeeder::Region region;
+    region.styleUrl = map->getStyle().getURL();
+    region.bounds = bounds;
+    region.minZoom = std::clamp(first_zoom, min_zoom_, max_zoom_);
+    region.maxZoom = std::clamp(last_zoom, region.minZoom, max_zoom_);
+    return region;
+}
+
+void SlintMapGL::estimate_region(
+    const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+    std::function<void(const mbgl::RegionSeeder::Estimate&)> done) {
+    if (!map || !done)
+        return;
+    const auto stats = file_source->transferStats();
+    const std::uint64_t average =
+        stats.transfers > 0 ? stats.decodedBytes / stats.transfers
+                            : mbgl::RegionSeeder::kTypicalTileBytes;
+    done(mbgl::RegionSeeder::estimate(
+        seed_area(bounds, first_zoom, last_zoom),
+        mbgl::RegionSeeder::tileSources(map->getStyle()), average));
+}
+
+void SlintMapGL::seed_region(const mbgl::LatLngBounds& bounds,
+                             double first_zoom, double last_zoom,
+                             mbgl::RegionSeeder::ProgressCallback on_progress) {
+    if (!map || !region_seeder)
+        return;
+    auto region = seed_area(bounds, first_zoom, last_zoom);
+    if (region.styleUrl.empty()) {
+        if (on_progress) {
+            mbgl::RegionSeeder::Progress progress;
+            progress.error = "the current style has no URL";
+            on_progress(progress);
+        }
+        return;
+    }
+    region_seeder->seed(region, std::move(on_progress));
+}
+
+void SlintMapGL::cancel_seeding() {
+    if (region_seeder)
+        region_seeder->cancel();
 }
 
 void SlintMapGL::set_zoom(double zoom) {
     if (!map)
         return;
     map->jumpTo(mbgl::CameraOptions().withZoom(zoom));
-    map->triggerRepaint();
-    repaint = true;
 }
 
 void SlintMapGL::set_pitch(double pitch) {
     if (!map)
         return;
     map->jumpTo(mbgl::CameraOptions().withPitch(pitch));
-    map->triggerRepaint();
-    repaint = true;
 }
 
 void SlintMapGL::set_bearing(double bearing) {
     if (!map)
         return;
     map->jumpTo(mbgl::CameraOptions().withBearing(bearing));
-    map->triggerRepaint();
-    repaint = true;
 }
 
 void SlintMapGL::onWillStartLoadingMap() {
-    std::cout << "[MapObserver] Will start loading map" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "MapObserver", "Will start loading map");
     style_loaded = false;
     map_idle = false;
 }
 
 void SlintMapGL::onDidFinishLoadingStyle() {
-    std::cout << "[MapObserver] Did finish loading style" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "MapObserver", "Did finish loading style");
     style_loaded = true;
 }
 
 void SlintMapGL::onDidBecomeIdle() {
-    std::cout << "[MapObserver] Did become idle" << std::endl;
+    SLINT_MAPLIBRE_LOG(Debug, "MapObserver", "Did become idle");
     map_idle = true;
 }
 
 void SlintMapGL::onDidFailLoadingMap(mbgl::MapLoadError error,
                                      const std::string& what) {
-    std::cout << "[MapObserver] FAILED loading map. type="
-              << static_cast<int>(error) << " what=" << what << std::endl;
+    SLINT_MAPLIBRE_LOG(Error, "MapObserver",
+                       "FAILED loading map. type=" << static_cast<int>(error)
+                                                   << " what=" << what);
     if (!fallback_style_applied && map) {
         fallback_style_applied = true;
-        std::cout << "[MapObserver] Applying fallback local JSON style"
-                  << std::endl;
+        SLINT_MAPLIBRE_LOG(Warning, "MapObserver",
+                           "Applying fallback local JSON style");
         const std::string fallback_json = R"JSON({
             "version": 8,
             "name": "solid-background",
@@ -218,14 +363,17 @@ void SlintMapGL::onDidFailLoadingMap(mbgl::MapLoadError error,
 }
 
 void SlintMapGL::onCameraDidChange(CameraChangeMode) {
-    repaint = true;
-}
-
-void SlintMapGL::onSourceChanged(mbgl::style::Source&) {
-    repaint = true;
+    if (file_source && map) {
+        const auto cam = map->getCameraOptions();
+        if (cam.center && cam.zoom) {
+            file_source->setViewport(*cam.center, *cam.zoom);
+        }
+    }
 }
 
 void SlintMapGL::onDidFinishRenderingFrame(const RenderFrameStatus& status) {
-    if (status.needsRepaint)
-        repaint = true;
+    // Tiles are still loading; onDidBecomeIdle() follows once they are in.
+    if (status.mode == RenderMode::Partial) {
+        map_idle = false;
+    }
 }
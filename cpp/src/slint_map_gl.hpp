@@ -11,9 +11,15 @@
 #include <memory>
 #include <string>
 
+#include "custom_file_source.hpp"
+#include "frame_stats.hpp"
+#include "input_coalescer.hpp"
+#include "pan_prefetcher.hpp"
+#include "region_seeder.hpp"
 #include "slint_gl_backend.hpp"
 
-// No-op observer used during orderly shutdown.
+// No-op observer used during orderly shutdown (the map registers itself as
+// the renderer observer while it is alive).
 class NoopGLRendererObserver final : public mbgl::RendererObserver {
 public:
     void onInvalidate() override {
@@ -22,27 +28,6 @@ public:
     }
 };
 
-// Renderer observer that flags a repaint when maplibre invalidates.
-class SlintGLRendererObserver final : public mbgl::RendererObserver {
-public:
-    explicit SlintGLRendererObserver(std::function<void()> notify)
-        : notify_(std::move(notify)) {
-    }
-
-    void onInvalidate() override {
-        if (notify_)
-            notify_();
-    }
-    void onDidFinishRenderingFrame(RenderMode, bool needsRepaint,
-                                   bool placementChanged) override {
-        if (needsRepaint || placementChanged)
-            onInvalidate();
-    }
-
-private:
-    std::function<void()> notify_;
-};
-
 class SlintMapGL : public mbgl::MapObserver {
 public:
     SlintMapGL() = default;
@@ -51,8 +36,32 @@ public:
     // Called from Slint's RenderingSetup (GL context current).
     void setup(uint32_t fbo, int w, int h, const std::string& styleUrl);
 
-    // Called from Slint's BeforeRendering (GL context current).
-    void render();
+    // Pumps the map's run loop; call from the UI tick. Returns whether the
+    // map is still busy (loading or changing) and wants another tick; after
+    // it returns false the tick may stop until the wake callback fires.
+    bool run_map_loop();
+
+    // Called, possibly from another thread, when the map has new work after
+    // run_map_loop() reported it was done. Set it before setup().
+    void set_wake_callback(std::function<void()> callback);
+
+    // True when the map changed since the last render(), i.e. the window
+    // needs a redraw.
+    bool needs_render() const {
+        return repaint.load();
+    }
+
+    // Called from Slint's BeforeRendering (GL context current). Always
+    // renders into the texture and returns whether the map changed since the
+    // previous call.
+    bool render();
+
+    // RunLoop and Render timings (see FrameStats). The texture is shared
+    // with Slint, so there is no readback, conversion or upload; the caller
+    // ends each frame after render().
+    std::shared_ptr<FrameStats> frame_stats() const {
+        return stats;
+    }
 
     bool style_is_loaded() const {
         return style_loaded.load();
@@ -72,6 +81,16 @@ public:
     void set_pitch(double pitch);
     void set_bearing(double bearing);
 
+    // Offline regions; see SlintMapLibre. `done` runs before
+    // estimate_region() returns, `on_progress` on a background thread.
+    void estimate_region(
+        const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+        std::function<void(const mbgl::RegionSeeder::Estimate&)> done);
+    void seed_region(const mbgl::LatLngBounds& bounds, double first_zoom,
+                     double last_zoom,
+                     mbgl::RegionSeeder::ProgressCallback on_progress);
+    void cancel_seeding();
+
     // MapObserver overrides
     void onWillStartLoadingMap() override;
     void onDidFinishLoadingStyle() override;
@@ -79,14 +98,18 @@ public:
     void onDidFailLoadingMap(mbgl::MapLoadError error,
                              const std::string& what) override;
     void onCameraDidChange(CameraChangeMode) override;
-    void onSourceChanged(mbgl::style::Source&) override;
     void onDidFinishRenderingFrame(const RenderFrameStatus&) override;
 
 private:
     std::unique_ptr<mbgl::util::RunLoop> run_loop;
+    std::shared_ptr<mbgl::CustomFileSource> file_source;
+    std::uint64_t file_source_listener = 0;
+    std::unique_ptr<mbgl::RegionSeeder> region_seeder;
+    mbgl::RegionSeeder::Region seed_area(const mbgl::LatLngBounds& bounds,
+                                         double first_zoom,
+                                         double last_zoom) const;
     std::unique_ptr<SlintGLBackend> backend;
     std::unique_ptr<SlintGLFrontend> frontend;
-    std::unique_ptr<SlintGLRendererObserver> observer;
     NoopGLRendererObserver noop_observer;
     std::unique_ptr<mbgl::Map> map;
 
@@ -95,10 +118,22 @@ private:
     std::atomic<bool> repaint{false};
     bool fallback_style_applied{false};
 
+    // See SlintMapLibre: set at the start of each tick, cleared while busy.
+    std::atomic<bool> ticks_paused{false};
+    std::function<void()> wake_callback;
+    void wake();
+
     mbgl::Point<double> last_pos{};
+    // See SlintMapLibre: drag/wheel input applied once per run_map_loop().
+    InputCoalescer pending_input;
+    void apply_pending_input();
+    // See SlintMapLibre: tiles ahead of a drag, fetched at low priority.
+    PanPrefetcher pan_prefetcher;
+    void prefetch_pan(double dx, double dy);
     double min_zoom_ = 0.0;
     double max_zoom_ = 22.0;
     int frame_count_ = 0;
+    std::shared_ptr<FrameStats> stats = std::make_shared<FrameStats>();
     int fly_ms_ = 2500;  // flyTo duration; override with MAPLIBRE_FLY_MS
 
     // Manual double-tap detection (touchscreens rarely emit Slint
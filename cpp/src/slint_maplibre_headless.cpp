@@ -2,7 +2,8 @@
 
 #include <algorithm>
 #include <cmath>
-#include <iostream>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
 #include "mbgl/gfx/backend_scope.hpp"
@@ -10,8 +11,37 @@
 #include "mbgl/map/camera.hpp"
 #include "mbgl/style/style.hpp"
 #include "mbgl/util/geo.hpp"
+#include "mbgl/util/image.hpp"
+#include "log.hpp"
 #include "mbgl/util/logging.hpp"
-#include "mbgl/util/premultiply.hpp"
+#include "pixel_convert.hpp"
+#include "tile_cover.hpp"
+
+namespace {
+
+void log_frame_statistics(
+    const slint::SharedPixelBuffer<slint::Rgba8Pixel>& frame) {
+    const slint::Rgba8Pixel* pixels = frame.begin();
+    const std::size_t pixel_count =
+        static_cast<std::size_t>(frame.width()) * frame.height();
+
+    std::ostringstream samples;
+    for (std::size_t i = 0; i < 20 && i < pixel_count; i += 5) {
+        samples << "(" << (int)pixels[i].r << "," << (int)pixels[i].g << ","
+                << (int)pixels[i].b << "," << (int)pixels[i].a << ") ";
+    }
+    const auto non_transparent_count =
+        std::count_if(pixels, pixels + pixel_count,
+                      [](const slint::Rgba8Pixel& p) { return p.a > 0; });
+
+    SLINT_MAPLIBRE_LOG(Debug, "SlintMapLibre",
+                       "Pixel samples (RGBA): " << samples.str());
+    SLINT_MAPLIBRE_LOG(Debug, "SlintMapLibre",
+                       "Non-transparent pixels: " << non_transparent_count
+                                                  << " / " << pixel_count);
+}
+
+}  // namespace
 
 SlintMapLibre::SlintMapLibre() {
     // Defer RunLoop creation until initialize() when we know sizes and
@@ -20,8 +50,11 @@ SlintMapLibre::SlintMapLibre() {
 }
 
 SlintMapLibre::~SlintMapLibre() {
-    // Orderly shutdown: first, unregister the observer to prevent dangling
-    // references.
+    // Orderly shutdown: stop the file source from waking us, then unregister
+    // the observer to prevent dangling references.
+    if (file_source && file_source_listener) {
+        file_source->removeResponseListener(file_source_listener);
+    }
     if (frontend) {
         frontend->setObserver(m_noop_observer);
     }
@@ -35,8 +68,8 @@ void SlintMapLibre::initialize(int w, int h) {
     width = w;
     height = h;
 
-    std::cout << "[SlintMapLibre] initialize(" << w << "," << h << ")"
-              << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "SlintMapLibre",
+                       "initialize(" << w << "," << h << ")");
 
     // Initialize RunLoop.
     // On macOS with Metal/OpenGL, winit manages the CFRunLoop so we skip
@@ -54,17 +87,18 @@ void SlintMapLibre::initialize(int w, int h) {
         mbgl::Size{static_cast<uint32_t>(width), static_cast<uint32_t>(height)},
         1.0f);
 
-    // Set the observer to receive repaint requests (flag-based, UI-safe)
-    m_renderer_observer = std::make_unique<SlintRendererObserver>([this]() {
-        request_repaint();
-        // Keep a short burst of frames to drain the queue
-        arm_forced_repaint_ms(100);
-    });
-    frontend->setObserver(*m_renderer_observer);
+    // Route the map's network requests through our fetch pool. Responses
+    // land on our run loop, which is only pumped while ticking.
+    file_source = mbgl::CustomFileSource::installDefault();
+    file_source_listener =
+        file_source->addResponseListener([this]() { wake(); });
 
     // Set ResourceOptions same as mbgl-render
     mbgl::ResourceOptions resourceOptions;
     resourceOptions.withCachePath("cache.sqlite").withAssetPath(".");
+    // Seeds offline regions into the same database the map reads from.
+    region_seeder = std::make_unique<mbgl::RegionSeeder>(
+        resourceOptions, mbgl::ClientOptions());
 
     // Set MapOptions same as mbgl-render
     map = std::make_unique<mbgl::Map>(
@@ -82,7 +116,8 @@ void SlintMapLibre::initialize(int w, int h) {
         mbgl::BoundOptions().withMinZoom(min_zoom).withMaxZoom(max_zoom));
 
     // Set a more reliable background color style
-    std::cout << "Setting solid background color style..." << std::endl;
+    SLINT_MAPLIBRE_LOG(Debug, "SlintMapLibre",
+                       "Setting solid background color style");
     std::string simple_style = R"JSON({
         "version": 8,
         "name": "solid-background",
@@ -98,17 +133,19 @@ void SlintMapLibre::initialize(int w, int h) {
             }
         ]
     })JSON";
-    // Try remote MapLibre demo style first; fall back to local JSON on error
-    std::cout << "Loading remote MapLibre style..." << std::endl;
-    map->getStyle().loadURL("https://demotiles.maplibre.org/style.json");
+    // Remote MapLibre demo style unless setStyleUrl() chose another; fall
+    // back to local JSON on error
+    SLINT_MAPLIBRE_LOG(Info, "SlintMapLibre",
+                       "Loading style " << initial_style_url);
+    map->getStyle().loadURL(initial_style_url);
 
     // Set initial display position (around Tokyo)
-    // std::cout << "Setting initial map position..." << std::endl;
     // map->jumpTo(mbgl::CameraOptions()
     //     .withCenter(mbgl::LatLng{35.6762, 139.6503}) // Tokyo
     //    .withZoom(10.0));
 
-    std::cout << "[SlintMapLibre] Map initialization completed" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "SlintMapLibre", "Map initialization completed");
+    wake();
 }
 
 void SlintMapLibre::setRenderCallback(std::function<void()> callback) {
@@ -117,32 +154,30 @@ void SlintMapLibre::setRenderCallback(std::function<void()> callback) {
 
 // MapObserver implementation
 void SlintMapLibre::onWillStartLoadingMap() {
-    std::cout << "[MapObserver] Will start loading map" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "MapObserver", "Will start loading map");
     style_loaded = false;
     map_idle = false;
 }
 
 void SlintMapLibre::onDidFinishLoadingStyle() {
-    std::cout << "[MapObserver] Did finish loading style" << std::endl;
+    SLINT_MAPLIBRE_LOG(Info, "MapObserver", "Did finish loading style");
     style_loaded = true;
 }
 
 void SlintMapLibre::onDidBecomeIdle() {
-    std::cout << "[MapObserver] Did become idle" << std::endl;
+    SLINT_MAPLIBRE_LOG(Debug, "MapObserver", "Did become idle");
     map_idle = true;
 }
 
 void SlintMapLibre::onDidFailLoadingMap(mbgl::MapLoadError error,
                                         const std::string& what) {
-    std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!" << std::endl;
-    std::cout << "[MapObserver] FAILED loading map." << std::endl;
-    std::cout << "    Error type: " << static_cast<int>(error) << std::endl;
-    std::cout << "    What: " << what << std::endl;
-    std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!" << std::endl;
+    SLINT_MAPLIBRE_LOG(Error, "MapObserver",
+                       "FAILED loading map. type=" << static_cast<int>(error)
+                                                   << " what=" << what);
     if (!fallback_style_applied && map) {
         fallback_style_applied = true;
-        std::cout << "[MapObserver] Applying fallback local JSON style"
-                  << std::endl;
+        SLINT_MAPLIBRE_LOG(Warning, "MapObserver",
+                           "Applying fallback local JSON style");
         const std::string fallback_json = R"JSON({
             "version": 8,
             "name": "solid-background",
@@ -157,111 +192,138 @@ void SlintMapLibre::onDidFailLoadingMap(mbgl::MapLoadError error,
 }
 
 void SlintMapLibre::onCameraDidChange(CameraChangeMode) {
-    request_repaint();
-    arm_forced_repaint_ms(100);
+    if (file_source && map) {
+        const auto cam = map->getCameraOptions();
+        if (cam.center && cam.zoom) {
+            file_source->setViewport(*cam.center, *cam.zoom);
+        }
+    }
 }
 
-void SlintMapLibre::onSourceChanged(mbgl::style::Source&) {
-    request_repaint();
-    arm_forced_repaint_ms(100);
+void SlintMapLibre::onWillStartRenderingFrame() {
+    render_start = FrameStats::Clock::now();
+    render_start_allocations = alloc_counter::this_thread();
 }
 
 void SlintMapLibre::onDidFinishRenderingFrame(const RenderFrameStatus& status) {
-    if (status.needsRepaint) {
-        request_repaint();
-        arm_forced_repaint_ms(100);
+    if (render_start != FrameStats::Clock::time_point{}) {
+        const auto elapsed = FrameStats::Clock::now() - render_start;
+        const auto allocations =
+            alloc_counter::this_thread() - render_start_allocations;
+        stats->record(FrameStage::Render, elapsed, allocations);
+        render_in_pump += elapsed;
+        render_allocations_in_pump += allocations;
+        render_start = {};
+    }
+    // The headless frontend renders as soon as the map invalidates, so this
+    // is the one place where the offscreen frame actually changes. When the
+    // status asks for another frame (fades, transitions) the map schedules it
+    // itself, and we hear about it here again.
+    request_repaint();
+    frames_pending = status.needsRepaint;
+    // Tiles are still loading; onDidBecomeIdle() follows once they are in.
+    if (status.mode == RenderMode::Partial) {
+        map_idle = false;
     }
 }
 
 void SlintMapLibre::setStyleUrl(const std::string& url) {
     if (map) {
+        wake();
         map->getStyle().loadURL(url);
+    } else {
+        initial_style_url = url;
     }
 }
 
+std::string SlintMapLibre::style_url() const {
+    return map ? map->getStyle().getURL() : initial_style_url;
+}
+
 slint::Image SlintMapLibre::render_map() {
-    std::cout << "render_map() called" << std::endl;
+    SLINT_MAPLIBRE_LOG(Trace, "SlintMapLibre", "render_map()");
 
-    if (!map || !frontend) {
-        std::cout << "ERROR: map or frontend is null" << std::endl;
+    auto& pixel_buffer = frame_buffers[next_frame_buffer];
+    if (!read_frame_into(pixel_buffer)) {
         return {};
     }
+    next_frame_buffer = (next_frame_buffer + 1) % frame_buffers.size();
+
+    // Full-frame statistics are a debugging aid; only scan when asked to.
+    if (slint_maplibre::log::enabled(slint_maplibre::log::Level::Debug)) {
+        log_frame_statistics(pixel_buffer);
+        stats->add_copied_bytes(std::uint64_t{pixel_buffer.width()} *
+                                pixel_buffer.height() *
+                                sizeof(slint::Rgba8Pixel));
+    }
+    return slint::Image(pixel_buffer);
+}
+
+bool SlintMapLibre::read_frame_into(
+    slint::SharedPixelBuffer<slint::Rgba8Pixel>& target) {
+    if (!map || !frontend) {
+        SLINT_MAPLIBRE_LOG(Error, "SlintMapLibre", "map or frontend is null");
+        return false;
+    }
 
     // Wait for style to finish loading
     if (!style_loaded.load()) {
-        std::cout << "Style not loaded yet, returning empty image" << std::endl;
-        return {};  // Return an empty image
+        SLINT_MAPLIBRE_LOG(Trace, "SlintMapLibre",
+                           "Style not loaded yet, returning empty image");
+        return false;
     }
 
-    std::cout << "Style loaded, proceeding with rendering..." << std::endl;
-
     // Use the exact same rendering method as mbgl-render
-    std::cout << "Using frontend.render(map) like mbgl-render..." << std::endl;
     // Ensure a valid backend scope is active for rendering (required on some
     // platforms/drivers, notably Windows) to make the GL context current.
-    if (auto* backend = frontend->getBackend()) {
-        mbgl::gfx::BackendScope scope{*backend};
-        frontend->renderOnce(*map);
-        std::cout << "Rendered one frame, reading still image..." << std::endl;
-        mbgl::PremultipliedImage rendered_image = frontend->readStillImage();
-        std::cout << "Image size: " << rendered_image.size.width << "x"
-                  << rendered_image.size.height << std::endl;
-        std::cout << "Image data pointer: "
-                  << (rendered_image.data.get() ? "valid" : "null")
-                  << std::endl;
-
-        if (rendered_image.data == nullptr || rendered_image.size.isEmpty()) {
-            std::cout << "ERROR: frontend->render() returned empty data"
-                      << std::endl;
-            return {};
-        }
+    auto* backend = frontend->getBackend();
+    if (!backend) {
+        SLINT_MAPLIBRE_LOG(Error, "SlintMapLibre",
+                           "frontend->getBackend() returned null");
+        return false;
+    }
 
-        std::cout << "Converting from premultiplied to unpremultiplied..."
-                  << std::endl;
-        mbgl::UnassociatedImage unpremult_image =
-            mbgl::util::unpremultiply(std::move(rendered_image));
-
-        std::cout << "Creating Slint pixel buffer..." << std::endl;
-        auto pixel_buffer = slint::SharedPixelBuffer<slint::Rgba8Pixel>(
-            unpremult_image.size.width, unpremult_image.size.height);
-
-        std::cout << "Copying unpremultiplied pixel data..." << std::endl;
-        memcpy(pixel_buffer.begin(), unpremult_image.data.get(),
-               unpremult_image.size.width * unpremult_image.size.height *
-                   sizeof(slint::Rgba8Pixel));
-
-        const uint8_t* raw_data = unpremult_image.data.get();
-        std::cout << "Pixel samples (RGBA): ";
-        for (int i = 0; i < 20 && i < unpremult_image.size.width *
-                                          unpremult_image.size.height;
-             i += 5) {
-            int offset = i * 4;
-            std::cout << "(" << (int)raw_data[offset] << ","
-                      << (int)raw_data[offset + 1] << ","
-                      << (int)raw_data[offset + 2] << ","
-                      << (int)raw_data[offset + 3] << ") ";
-        }
-        std::cout << std::endl;
-
-        int non_transparent_count = 0;
-        for (int i = 0;
-             i < unpremult_image.size.width * unpremult_image.size.height;
-             i++) {
-            if (raw_data[i * 4 + 3] > 0) {
-                non_transparent_count++;
-            }
-        }
-        std::cout << "Non-transparent pixels: " << non_transparent_count
-                  << " / "
-                  << (unpremult_image.size.width * unpremult_image.size.height)
-                  << std::endl;
+    // No renderOnce() here: the frame was already rendered from
+    // run_map_loop(), and rendering again would only redraw the same scene.
+    mbgl::gfx::BackendScope scope{*backend};
+    // The readback itself is the one full-frame copy we cannot avoid: every
+    // backend (GL, Metal, WebGPU) hands it back as an mbgl-owned image.
+    const auto readback_start = FrameStats::Clock::now();
+    const auto readback_allocations = alloc_counter::this_thread();
+    const mbgl::PremultipliedImage rendered_image = frontend->readStillImage();
+    stats->record(FrameStage::Readback,
+                  FrameStats::Clock::now() - readback_start,
+                  alloc_counter::this_thread() - readback_allocations);
+    stats->add_copied_bytes(rendered_image.bytes());
+    SLINT_MAPLIBRE_LOG(Trace, "SlintMapLibre",
+                       "Read back " << rendered_image.size.width << "x"
+                                    << rendered_image.size.height);
+
+    if (rendered_image.data == nullptr || rendered_image.size.isEmpty()) {
+        SLINT_MAPLIBRE_LOG(Error, "SlintMapLibre",
+                           "frontend->readStillImage() returned empty data");
+        return false;
+    }
 
-        std::cout << "Image created successfully" << std::endl;
-        return slint::Image(pixel_buffer);
-    } else {
-        std::cout << "ERROR: frontend->getBackend() returned null" << std::endl;
-        return {};
+    // A buffer reallocated after a resize is booked under Convert, so the
+    // allocation shows up there.
+    const auto convert_timer = stats->time(FrameStage::Convert);
+    if (target.width() != rendered_image.size.width ||
+        target.height() != rendered_image.size.height) {
+        target = slint::SharedPixelBuffer<slint::Rgba8Pixel>(
+            rendered_image.size.width, rendered_image.size.height);
     }
+
+    // Slint takes straight alpha, so un-premultiply while copying into the
+    // recycled buffer rather than converting in place and copying again.
+    static_assert(sizeof(slint::Rgba8Pixel) == 4);
+    stats->add_copied_bytes(rendered_image.bytes());
+    slint_maplibre::unpremultiply_rgba8(
+        rendered_image.data.get(),
+        reinterpret_cast<uint8_t*>(target.begin()),
+        static_cast<std::size_t>(rendered_image.size.width) *
+            rendered_image.size.height);
+    return true;
 }
 
 void SlintMapLibre::resize(int w, int h) {
@@ -269,6 +331,7 @@ void SlintMapLibre::resize(int w, int h) {
     height = h;
 
     if (frontend && map) {
+        wake();
         frontend->setSize(
             {static_cast<uint32_t>(width), static_cast<uint32_t>(height)});
         map->setSize(
@@ -278,9 +341,8 @@ void SlintMapLibre::resize(int w, int h) {
 
 void SlintMapLibre::handle_mouse_press(float x, float y) {
     last_pos = {x, y};
-    // Trigger a redraw after interaction starts for responsiveness
-    request_repaint();
-    arm_forced_repaint_ms(120);
+    pan_prefetcher.reset();
+    wake();
 }
 
 void SlintMapLibre::handle_mouse_release(float x, float y) {
@@ -291,16 +353,18 @@ void SlintMapLibre::handle_mouse_move(float x, float y, bool pressed) {
     if (pressed) {
         mbgl::Point<double> current_pos = {x, y};
         mbgl::Point<double> delta = current_pos - last_pos;
-        // Move the map along with the pointer movement (dragging behavior)
-        map->moveBy(delta);
+        // Move the map along with the pointer movement (dragging behavior);
+        // applied with the rest of this frame's input in run_map_loop().
+        pending_input.pan(delta.x, delta.y);
         last_pos = current_pos;
-        map->triggerRepaint();
+        wake();
     }
 }
 
 void SlintMapLibre::handle_double_click(float x, float y, bool shift) {
     if (!map)
         return;
+    apply_pending_input();
     // Center the map on the clicked location and zoom by one level (+/- with
     // Shift)
     const mbgl::LatLng ll = map->latLngForPixel(mbgl::ScreenCoordinate{x, y});
@@ -314,7 +378,7 @@ void SlintMapLibre::handle_double_click(float x, float y, bool shift) {
     next.withCenter(std::optional<mbgl::LatLng>(ll));
     next.withZoom(std::optional<double>(targetZoom));
     map->jumpTo(next);
-    map->triggerRepaint();
+    wake();
 }
 
 void SlintMapLibre::handle_wheel_zoom(float x, float y, float dy) {
@@ -323,8 +387,8 @@ void SlintMapLibre::handle_wheel_zoom(float x, float y, float dy) {
     // Lower sensitivity: dy < 0 => zoom in, dy > 0 => zoom out
     constexpr double step = 1.2;  // smoother than 2.0
     double scale = (dy < 0.0) ? step : (1.0 / step);
-    map->scaleBy(scale, mbgl::ScreenCoordinate{x, y});
-    map->triggerRepaint();
+    pending_input.zoom(scale, x, y);
+    wake();
 }
 
 void SlintMapLibre::set_pitch(int pitch_value) {
@@ -342,7 +406,7 @@ void SlintMapLibre::set_pitch(int pitch_value) {
         .withPitch(std::optional<double>(pitch));
 
     map->jumpTo(next);
-    map->triggerRepaint();
+    wake();
 }
 
 void SlintMapLibre::set_bearing(float bearing_value) {
@@ -360,114 +424,183 @@ void SlintMapLibre::set_bearing(float bearing_value) {
         .withBearing(std::optional<double>(bearing));
 
     map->jumpTo(next);
-    map->triggerRepaint();
+    wake();
 }
 
-void SlintMapLibre::run_map_loop() {
+bool SlintMapLibre::run_map_loop() {
+    // Anything that wakes us from here on, including work queued while we
+    // pump, restarts the tick even if this one decides to stop.
+    ticks_paused = true;
+    const auto pump_start = FrameStats::Clock::now();
+    const auto pump_start_allocations = alloc_counter::this_thread();
+    render_in_pump = {};
+    render_allocations_in_pump = {};
+    apply_pending_input();
+    // Advance the custom animation first so the camera move it makes is
+    // rendered by this pump rather than one tick later.
+    tick_animation();
     if (run_loop) {
         run_loop->runOnce();
+        const auto pumped =
+            FrameStats::Clock::now() - pump_start - render_in_pump;
+        stats->record(FrameStage::RunLoop,
+                      std::max(pumped, FrameStats::Clock::duration::zero()),
+                      alloc_counter::this_thread() - pump_start_allocations -
+                          render_allocations_in_pump);
     } else {
         // Not initialized yet; nothing to pump.
     }
-    // Drive custom animation if active
-    tick_animation();
+    const bool busy =
+        map && (custom_anim.active || !map_idle.load() ||
+                frames_pending.load() || repaint_needed.load());
+    if (busy) {
+        ticks_paused = false;
+    }
+    return busy;
 }
 
-bool SlintMapLibre::take_repaint_request() {
-    bool expected = true;
-    return repaint_needed.compare_exchange_strong(expected, false,
-                                                  std::memory_order_seq_cst);
+void SlintMapLibre::apply_pending_input() {
+    const auto gesture = pending_input.take();
+    if (!gesture || !map) {
+        return;
+    }
+    if (gesture->is_scale) {
+        map->scaleBy(gesture->scale,
+                     mbgl::ScreenCoordinate{gesture->x, gesture->y});
+    } else {
+        map->moveBy({gesture->x, gesture->y});
+        prefetch_pan(gesture->x, gesture->y);
+    }
 }
 
-void SlintMapLibre::request_repaint() {
-    repaint_needed.store(true, std::memory_order_relaxed);
+void SlintMapLibre::prefetch_pan(double dx, double dy) {
+    if (!file_source) {
+        return;
+    }
+    const auto now = PanPrefetcher::Clock::now();
+    const auto cam = map->getCameraOptions();
+    pan_prefetcher.add_pan(dx, dy, cam.bearing.value_or(0.0), now);
+    if (!cam.center || !cam.zoom) {
+        return;
+    }
+    const auto tiles = pan_prefetcher.plan(
+        project_mercator(cam.center->latitude(), cam.center->longitude()),
+        *cam.zoom, width, height, now);
+    if (!tiles.empty()) {
+        file_source->prefetch(tiles);
+    }
 }
 
-bool SlintMapLibre::consume_forced_repaint() {
-    int v = forced_repaint_frames.load(std::memory_order_relaxed);
-    if (v > 0) {
-        forced_repaint_frames.store(v - 1, std::memory_order_relaxed);
-        return true;
-    }
-    return false;
+void SlintMapLibre::set_pan_prefetch_budget(std::size_t tiles) {
+    pan_prefetcher.set_budget(tiles);
 }
 
-void SlintMapLibre::arm_forced_repaint_ms(int ms) {
-    int frames = std::max(1, ms / 16);
-    int cur = forced_repaint_frames.load(std::memory_order_relaxed);
-    if (frames > cur) {
-        forced_repaint_frames.store(frames, std::memory_order_relaxed);
+mbgl::RegionSeeder::Region SlintMapLibre::seed_area(
+    const mbgl::LatLngBounds& bounds, double first_zoom,
+    double last_zoom) const {
+    mbgl::RegionSeeder::Region region;
+    region.styleUrl = map->getStyle().getURL();
+    region.bounds = bounds;
+    region.minZoom = std::clamp(first_zoom, min_zoom, max_zoom);
+    region.maxZoom = std::clamp(last_zoom, region.minZoom, max_zoom);
+    return region;
+}
+
+void SlintMapLibre::estimate_region(
+    const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+    std::function<void(const mbgl::RegionSeeder::Estimate&)> done) {
+    if (!map || !done) {
+        return;
     }
+    const auto stats = file_source->transferStats();
+    const std::uint64_t average =
+        stats.transfers > 0 ? stats.decodedBytes / stats.transfers
+                            : mbgl::RegionSeeder::kTypicalTileBytes;
+    done(mbgl::RegionSeeder::estimate(
+        seed_area(bounds, first_zoom, last_zoom),
+        mbgl::RegionSeeder::tileSources(map->getStyle()), average));
 }
 
-void SlintMapLibre::fly_to(double lat, double lon, double target_zoom_value) {
-    if (!map)
+void SlintMapLibre::seed_region(
+    const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+    mbgl::RegionSeeder::ProgressCallback on_progress) {
+    if (!map || !region_seeder) {
         return;
+    }
+    auto region = seed_area(bounds, first_zoom, last_zoom);
+    if (region.styleUrl.empty()) {
+        // Offline regions are stored per style URL; a style loaded from
+        // JSON cannot be seeded.
+        if (on_progress) {
+            mbgl::RegionSeeder::Progress progress;
+            progress.error = "the current style has no URL";
+            on_progress(progress);
+        }
+        return;
+    }
+    SLINT_MAPLIBRE_LOG(Info, "SlintMapLibre",
+                       "Seeding " << region.styleUrl << " z" << region.minZoom
+                                  << "-" << region.maxZoom);
+    region_seeder->seed(region, std::move(on_progress));
+}
 
-    mbgl::LatLng target{lat, lon};
+void SlintMapLibre::cancel_seeding() {
+    if (region_seeder) {
+        region_seeder->cancel();
+    }
+}
 
-    // Capture start camera
-    const auto cam = map->getCameraOptions();
-    mbgl::LatLng start_center = cam.center.value_or(target);
-    double start_zoom = cam.zoom.value_or(10.0);
+std::shared_ptr<FrameStats> SlintMapLibre::frame_stats() const {
+    return stats;
+}
 
-    auto deg2rad = [](double d) { return d * M_PI / 180.0; };
-    auto approx_distance_deg = [&](const mbgl::LatLng& a,
-                                   const mbgl::LatLng& b) {
-        double lat1r = deg2rad(a.latitude());
-        double lat2r = deg2rad(b.latitude());
-        double dlatr = lat2r - lat1r;
-        double dlonr = deg2rad(b.longitude() - a.longitude());
-        double x = dlonr * std::cos((lat1r + lat2r) * 0.5);
-        double y = dlatr;
-        return std::sqrt(x * x + y * y) * 180.0 / M_PI;
-    };
-    double dist = approx_distance_deg(start_center, target);
-    double zoom_out_delta = std::max(2.0, 8.0 + std::min(3.0, dist / 8.0));
-    double mid_zoom =
-        std::max(min_zoom, std::min(max_zoom, start_zoom - zoom_out_delta));
+void SlintMapLibre::set_frame_stats(std::shared_ptr<FrameStats> shared) {
+    if (shared) {
+        stats = std::move(shared);
+    }
+}
 
-    custom_anim.active = true;
-    custom_anim.start_center = start_center;
-    custom_anim.target_center = target;
-    custom_anim.start_zoom = start_zoom;
-    custom_anim.target_zoom = target_zoom_value;
-    custom_anim.mid_zoom = mid_zoom;
-    custom_anim.mid_ratio = 0.60;
-    custom_anim.center_hold_ratio = 0.20;
-    custom_anim.start_time = std::chrono::steady_clock::now();
-    custom_anim.duration_ms = 2500;
-    request_repaint();
-    arm_forced_repaint_ms(custom_anim.duration_ms + 600);
+void SlintMapLibre::set_wake_callback(std::function<void()> callback) {
+    m_wakeCallback = std::move(callback);
 }
 
-void SlintMapLibre::fly_to(const std::string& location) {
+void SlintMapLibre::wake() {
+    if (ticks_paused.exchange(false) && m_wakeCallback) {
+        m_wakeCallback();
+    }
+}
+
+bool SlintMapLibre::take_repaint_request() {
+    bool expected = true;
+    return repaint_needed.compare_exchange_strong(expected, false,
+                                                  std::memory_order_seq_cst);
+}
+
+void SlintMapLibre::request_repaint() {
+    repaint_needed.store(true, std::memory_order_relaxed);
+}
+
+void SlintMapLibre::fly_to(double lat, double lon, double target_zoom_value) {
     if (!map)
         return;
+    apply_pending_input();
 
-    // Determine target
-    mbgl::LatLng target;
-    if (location == "paris") {
-        target = mbgl::LatLng{48.8566, 2.3522};
-    } else if (location == "new_york") {
-        target = mbgl::LatLng{40.7128, -74.0060};
-    } else {  // tokyo or default
-        target = mbgl::LatLng{35.6895, 139.6917};
-    }
+    mbgl::LatLng target{lat, lon};
 
     // Capture start camera
     const auto cam = map->getCameraOptions();
     mbgl::LatLng start_center = cam.center.value_or(target);
     double start_zoom = cam.zoom.value_or(10.0);
-    double target_zoom = 10.0;
-    // Dynamic zoom-out amount based on approximate great-circle distance
+
+    // Dynamic zoom-out amount based on approximate great-circle distance,
+    // the short way round across the antimeridian
     auto deg2rad = [](double d) { return d * M_PI / 180.0; };
     auto approx_distance_deg = [&](const mbgl::LatLng& a,
                                    const mbgl::LatLng& b) {
         double lat1 = deg2rad(a.latitude());
         double lat2 = deg2rad(b.latitude());
         double dlat = lat2 - lat1;
-        double dlon = deg2rad(b.longitude() - a.longitude());
+        double dlon = deg2rad(longitude_delta(a.longitude(), b.longitude()));
         double x = dlon * std::cos((lat1 + lat2) * 0.5);
         double y = dlat;
         return std::sqrt(x * x + y * y) * 180.0 / M_PI;
@@ -486,15 +619,43 @@ void SlintMapLibre::fly_to(const std::string& location) {
     custom_anim.start_center = start_center;
     custom_anim.target_center = target;
     custom_anim.start_zoom = start_zoom;
-    custom_anim.target_zoom = target_zoom;
+    custom_anim.target_zoom = target_zoom_value;
     custom_anim.mid_zoom = mid_zoom;
     custom_anim.mid_ratio =
         0.60;  // 60% zoom-out, 40% zoom-in (emphasize pull-back)
     custom_anim.center_hold_ratio = 0.20;  // keep center almost still at first
     custom_anim.start_time = std::chrono::steady_clock::now();
     custom_anim.duration_ms = 2500;
-    request_repaint();
-    arm_forced_repaint_ms(custom_anim.duration_ms + 600);
+    prefetch_fly_to();
+    wake();
+}
+
+void SlintMapLibre::fly_to(const std::string& location) {
+    // Determine target
+    mbgl::LatLng target;
+    if (location == "paris") {
+        target = mbgl::LatLng{48.8566, 2.3522};
+    } else if (location == "new_york") {
+        target = mbgl::LatLng{40.7128, -74.0060};
+    } else {  // tokyo or default
+        target = mbgl::LatLng{35.6895, 139.6917};
+    }
+    fly_to(target.latitude(), target.longitude(), 10.0);
+}
+
+void SlintMapLibre::prefetch_fly_to() {
+    if (!file_source) {
+        return;
+    }
+    // Tiles at the destination (and what is visible while zoomed out on
+    // the way) load during the 2.5 s flight instead of after it.
+    constexpr std::size_t kFlyToPrefetchBudget = 64;
+    file_source->prefetch(fly_to_tiles(
+        custom_anim.start_center.latitude(),
+        custom_anim.start_center.longitude(),
+        custom_anim.target_center.latitude(),
+        custom_anim.target_center.longitude(), custom_anim.mid_zoom,
+        custom_anim.target_zoom, width, height, kFlyToPrefetchBudget));
 }
 
 static inline double ease_in_out(double t) {
@@ -528,8 +689,10 @@ void SlintMapLibre::tick_animation() {
     }
     mbgl::LatLng c{lerp(custom_anim.start_center.latitude(),
                         custom_anim.target_center.latitude(), k_center),
-                   lerp(custom_anim.start_center.longitude(),
-                        custom_anim.target_center.longitude(), k_center)};
+                   custom_anim.start_center.longitude() +
+                       longitude_delta(custom_anim.start_center.longitude(),
+                                       custom_anim.target_center.longitude()) *
+                           k_center};
     // Two-phase zoom: out then in
     double z;
     if (t <= custom_anim.mid_ratio) {
@@ -548,7 +711,6 @@ void SlintMapLibre::tick_animation() {
     next.center = c;
     next.zoom = z;
     map->jumpTo(next);
-    request_repaint();
 
     if (t >= 1.0) {
         custom_anim.active = false;
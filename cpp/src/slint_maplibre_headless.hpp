@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <slint.h>
@@ -15,11 +18,16 @@
 #include <mbgl/storage/resource_options.hpp>
 #include <mbgl/util/run_loop.hpp>
 
-// Custom file source is implemented, but not required for core rendering
-// paths used here. We avoid constructing it eagerly to reduce startup
-// complexity.
+#include "custom_file_source.hpp"
+#include "frame_stats.hpp"
+#include "input_coalescer.hpp"
+#include "pan_prefetcher.hpp"
+#include "region_seeder.hpp"
 
 // --- No-op Observer for safe shutdown ---
+// mbgl::Map registers itself as the frontend's renderer observer and forwards
+// invalidations and finished frames to our MapObserver overrides; this one
+// only replaces it while the map is torn down.
 class NoopRendererObserver final : public mbgl::RendererObserver {
 public:
     void onInvalidate() override {
@@ -28,40 +36,24 @@ public:
     }
 };
 
-// --- Renderer Observer ---
-// Receives repaint requests from MapLibre and forwards them to the Slint event
-// loop. This class is now fully defined here to resolve compilation issues.
-class SlintRendererObserver : public mbgl::RendererObserver {
-public:
-    explicit SlintRendererObserver(std::function<void()> notifyRepaint)
-        : m_notifyRepaint(std::move(notifyRepaint)) {
-    }
-
-    void onInvalidate() override {
-        if (m_notifyRepaint)
-            m_notifyRepaint();
-    }
-
-    void onDidFinishRenderingFrame(RenderMode mode, bool needsRepaint,
-                                   bool placementChanged) override {
-        if (needsRepaint || placementChanged) {
-            onInvalidate();
-        }
-    }
-
-private:
-    std::function<void()> m_notifyRepaint;
-};
-
 // --- Main MapLibre Integration Class ---
 class SlintMapLibre : public mbgl::MapObserver {
 public:
+    static constexpr const char* default_style_url =
+        "https://demotiles.maplibre.org/style.json";
+
     SlintMapLibre();
     ~SlintMapLibre();
 
     void initialize(int width, int height);
     void setRenderCallback(std::function<void()> callback);
+    // The image shares its pixels with a recycled buffer; keep at most the
+    // latest one (as a Slint image property does) so the next frame can be
+    // written without a copy.
     slint::Image render_map();
+    // Reads the current frame into `target` as straight-alpha RGBA, reusing
+    // its storage when the size matches. Returns false if there is no frame.
+    bool read_frame_into(slint::SharedPixelBuffer<slint::Rgba8Pixel>& target);
     void resize(int width, int height);
     void handle_mouse_press(float x, float y);
     void handle_mouse_release(float x, float y);
@@ -70,19 +62,60 @@ public:
     void handle_wheel_zoom(float x, float y, float dy);
     void set_pitch(int pitch_value);
     void set_bearing(float bearing_value);
+    // Before initialize(), chooses the style the map starts with instead
+    // of the MapLibre demo tiles.
     void setStyleUrl(const std::string& url);
+    // The style the map shows, or will start with before initialize().
+    std::string style_url() const;
     void fly_to(const std::string& location);
     void fly_to(double lat, double lon, double zoom);
-
-    // Manually drive the map's run loop
-    void run_map_loop();
+    // Whether a fly_to() animation is still moving the camera.
+    bool animating() const {
+        return custom_anim.active;
+    }
+    // Tiles requested ahead of a drag per prediction (default 16, 0 = off).
+    void set_pan_prefetch_budget(std::size_t tiles);
+
+    // Offline regions: the current style over `bounds` and a zoom range,
+    // downloaded into the persistent cache (see mbgl::RegionSeeder). The
+    // estimate uses the loaded style and the average size of the tiles
+    // fetched so far; `done` runs before estimate_region() returns.
+    // `on_progress` runs on a background thread.
+    void estimate_region(
+        const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+        std::function<void(const mbgl::RegionSeeder::Estimate&)> done);
+    void seed_region(const mbgl::LatLngBounds& bounds, double first_zoom,
+                     double last_zoom,
+                     mbgl::RegionSeeder::ProgressCallback on_progress);
+    void cancel_seeding();
+
+    // Manually drive the map's run loop. MapLibre renders from inside it
+    // whenever the camera, style or tiles changed since the last frame.
+    // Returns whether the map is still busy (loading, animating or fading)
+    // and wants another tick; once it returns false the caller may stop
+    // ticking until the wake callback fires.
+    bool run_map_loop();
     void tick_animation();
 
-    // Repaint signaling consumed by UI thread (timer)
+    // Called, possibly from another thread, when the map has new work after
+    // run_map_loop() reported it was done: user input, a camera command or a
+    // network response queued on the run loop. Typically it restarts the UI
+    // tick via slint::invoke_from_event_loop. Set it before initialize().
+    void set_wake_callback(std::function<void()> callback);
+
+    // Per-stage frame timings. RunLoop, Render, Readback and Convert are
+    // recorded here, as are the pixel bytes readback and conversion copy;
+    // the embedder records Upload and calls end_frame() once the frame is
+    // on screen. Safe to read from any thread; may be replaced with an
+    // instance shared with another owner.
+    std::shared_ptr<FrameStats> frame_stats() const;
+    void set_frame_stats(std::shared_ptr<FrameStats> stats);
+
+    // Repaint signaling consumed by UI thread (timer). A repaint is pending
+    // when MapLibre has rendered a frame that has not been read back yet, so
+    // an unchanged map never reports one.
     bool take_repaint_request();
     void request_repaint();
-    bool consume_forced_repaint();
-    void arm_forced_repaint_ms(int ms);
 
     // MapObserver implementation
     void onWillStartLoadingMap() override;
@@ -91,7 +124,7 @@ public:
     void onDidFailLoadingMap(mbgl::MapLoadError error,
                              const std::string& what) override;
     void onCameraDidChange(CameraChangeMode) override;
-    void onSourceChanged(mbgl::style::Source&) override;
+    void onWillStartRenderingFrame() override;
     void onDidFinishRenderingFrame(const RenderFrameStatus&) override;
 
 private:
@@ -99,11 +132,21 @@ private:
     // The observer must outlive the frontend.
     std::unique_ptr<mbgl::util::RunLoop> run_loop;  // created in initialize()
     std::function<void()> m_renderCallback;
+    std::function<void()> m_wakeCallback;
+
+    // Network file source used by the map (installed in initialize()); it
+    // must outlive the map, and is told where the camera is so it can fetch
+    // visible tiles first.
+    std::shared_ptr<mbgl::CustomFileSource> file_source;
+    std::uint64_t file_source_listener = 0;
+    std::unique_ptr<mbgl::RegionSeeder> region_seeder;
+    mbgl::RegionSeeder::Region seed_area(const mbgl::LatLngBounds& bounds,
+                                         double first_zoom,
+                                         double last_zoom) const;
 
     // Observer and frontend must be declared before the map.
     // The observer must be declared before the frontend to ensure it's
     // destroyed after.
-    std::unique_ptr<SlintRendererObserver> m_renderer_observer;
     NoopRendererObserver m_noop_observer;  // For safe shutdown
     std::unique_ptr<mbgl::HeadlessFrontend> frontend;
     std::unique_ptr<mbgl::Map> map;
@@ -111,7 +154,29 @@ private:
     int width = 0;
     int height = 0;
 
+    // Frames handed to Slint by render_map(). The UI only keeps the image of
+    // the latest frame, so the buffer of the one before is no longer shared
+    // when it is rewritten; a buffer still referenced by an image would be
+    // copied on write instead of reused.
+    std::array<slint::SharedPixelBuffer<slint::Rgba8Pixel>, 2> frame_buffers;
+    std::size_t next_frame_buffer = 0;
+
+    std::shared_ptr<FrameStats> stats = std::make_shared<FrameStats>();
+    // The headless frontend renders from inside the run loop; render time
+    // and allocations are taken out of the RunLoop sample of the same pump.
+    FrameStats::Clock::time_point render_start{};
+    FrameStats::Clock::duration render_in_pump{};
+    FrameStats::Allocations render_start_allocations;
+    FrameStats::Allocations render_allocations_in_pump;
+
     mbgl::Point<double> last_pos;
+    // Drag and wheel input since the last run_map_loop(), applied there as
+    // one camera change.
+    InputCoalescer pending_input;
+    void apply_pending_input();
+    // Requests the tiles a drag is about to reveal, at low priority.
+    PanPrefetcher pan_prefetcher;
+    void prefetch_pan(double dx, double dy);
     double min_zoom = 0.0;
     double max_zoom = 22.0;
 
@@ -128,7 +193,14 @@ private:
     std::atomic<bool> repaint_needed{false};
 
     bool fallback_style_applied{false};
-    std::atomic<int> forced_repaint_frames{0};
+    std::string initial_style_url = default_style_url;
+
+    // Set at the start of every run_map_loop() and cleared while the map is
+    // busy; wake() only calls the wake callback when it is set, so a paused
+    // UI tick is restarted exactly once.
+    std::atomic<bool> ticks_paused{false};
+    std::atomic<bool> frames_pending{false};
+    void wake();
 
     struct CustomAnim {
         bool active = false;
@@ -143,4 +215,6 @@ private:
         std::chrono::steady_clock::time_point start_time{};
         int duration_ms = 0;
     } custom_anim;
+    // Warms the file source with the tiles custom_anim will show.
+    void prefetch_fly_to();
 };
@@ -0,0 +1,232 @@
+#include "slint_maplibre_render_thread.hpp"
+
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "log.hpp"
+
+namespace {
+
+// Pump interval while the map is busy, matching MMapView's tick.
+constexpr auto kFrameInterval = std::chrono::milliseconds(16);
+
+}  // namespace
+
+SlintMapLibreRenderThread::SlintMapLibreRenderThread(
+    std::function<void()> frame_ready)
+    : frame_ready_(std::move(frame_ready)), thread_([this] { run(); }) {
+}
+
+SlintMapLibreRenderThread::~SlintMapLibreRenderThread() {
+    stopping_ = true;
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+const SlintMapLibreRenderThread::Frame*
+SlintMapLibreRenderThread::take_frame() {
+    // Re-arm the notification first so a frame published right after the
+    // take below is announced again rather than missed.
+    frame_notified_ = false;
+    const Frame* frame = frames_.take();
+    if (frame) {
+        camera_ = frame->camera;
+    }
+    return frame;
+}
+
+void SlintMapLibreRenderThread::initialize(int width, int height) {
+    post(Initialize{width, height});
+}
+
+void SlintMapLibreRenderThread::resize(int width, int height) {
+    post(Resize{width, height});
+}
+
+void SlintMapLibreRenderThread::handle_mouse_press(float x, float y) {
+    post(MousePress{x, y});
+}
+
+void SlintMapLibreRenderThread::handle_mouse_release(float x, float y) {
+    post(MouseRelease{x, y});
+}
+
+void SlintMapLibreRenderThread::handle_mouse_move(float x, float y,
+                                                  bool pressed) {
+    post(MouseMove{x, y, pressed});
+}
+
+void SlintMapLibreRenderThread::handle_double_click(float x, float y,
+                                                    bool shift) {
+    post(DoubleClick{x, y, shift});
+}
+
+void SlintMapLibreRenderThread::handle_wheel_zoom(float x, float y, float dy) {
+    post(WheelZoom{x, y, dy});
+}
+
+void SlintMapLibreRenderThread::set_pitch(int pitch_value) {
+    post(SetPitch{pitch_value});
+}
+
+void SlintMapLibreRenderThread::set_bearing(float bearing_value) {
+    post(SetBearing{bearing_value});
+}
+
+void SlintMapLibreRenderThread::setStyleUrl(const std::string& url) {
+    style_url_ = url;
+    post(SetStyleUrl{url});
+}
+
+void SlintMapLibreRenderThread::fly_to(const std::string& location) {
+    post(FlyToLocation{location});
+}
+
+void SlintMapLibreRenderThread::fly_to(double lat, double lon, double zoom) {
+    post(FlyTo{lat, lon, zoom});
+}
+
+void SlintMapLibreRenderThread::estimate_region(
+    const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+    std::function<void(const mbgl::RegionSeeder::Estimate&)> done) {
+    post(EstimateRegion{bounds, first_zoom, last_zoom, std::move(done)});
+}
+
+void SlintMapLibreRenderThread::seed_region(
+    const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+    mbgl::RegionSeeder::ProgressCallback on_progress) {
+    post(SeedRegion{bounds, first_zoom, last_zoom, std::move(on_progress)});
+}
+
+void SlintMapLibreRenderThread::cancel_seeding() {
+    post(CancelSeeding{});
+}
+
+void SlintMapLibreRenderThread::post(Event event) {
+    if (!events_.try_push(std::move(event))) {
+        // Only happens if the render thread is stalled for hundreds of
+        // events; dropping input is better than blocking the UI.
+        SLINT_MAPLIBRE_LOG(Warning, "RenderThread",
+                           "input queue full, dropping event");
+        return;
+    }
+    wake();
+}
+
+void SlintMapLibreRenderThread::wake() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_requested_ = true;
+    }
+    wake_cv_.notify_one();
+}
+
+void SlintMapLibreRenderThread::run() {
+    // The map and its RunLoop belong to this thread from creation to
+    // destruction.
+    auto map = std::make_unique<SlintMapLibre>();
+    map->set_wake_callback([this] { wake(); });
+    map->set_frame_stats(stats_);
+
+    while (!stopping_) {
+        while (auto event = events_.try_pop()) {
+            apply(*map, *event);
+        }
+
+        bool busy = false;
+        if (initialized_) {
+            busy = map->run_map_loop();
+            if (map->take_repaint_request()) {
+                publish_frame(*map);
+            }
+        }
+
+        // Sleep until input, a network response or shutdown wakes us; while
+        // the map is busy, also come back for the next frame.
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        const auto woken = [this] { return wake_requested_ || stopping_; };
+        if (busy) {
+            wake_cv_.wait_for(lock, kFrameInterval, woken);
+        } else {
+            wake_cv_.wait(lock, woken);
+        }
+        wake_requested_ = false;
+    }
+}
+
+void SlintMapLibreRenderThread::apply(SlintMapLibre& map, Event& event) {
+    std::visit(
+        [this, &map](auto& e) {
+            using E = std::decay_t<decltype(e)>;
+            if constexpr (std::is_same_v<E, Initialize>) {
+                if (!initialized_) {
+                    map.initialize(e.width, e.height);
+                    initialized_ = true;
+                } else {
+                    map.resize(e.width, e.height);
+                }
+                return;
+            }
+            // Nothing to act on before the map exists.
+            if (!initialized_) {
+                return;
+            }
+            if constexpr (std::is_same_v<E, Resize>) {
+                map.resize(e.width, e.height);
+            } else if constexpr (std::is_same_v<E, MousePress>) {
+                map.handle_mouse_press(e.x, e.y);
+            } else if constexpr (std::is_same_v<E, MouseRelease>) {
+                map.handle_mouse_release(e.x, e.y);
+            } else if constexpr (std::is_same_v<E, MouseMove>) {
+                map.handle_mouse_move(e.x, e.y, e.pressed);
+            } else if constexpr (std::is_same_v<E, DoubleClick>) {
+                map.handle_double_click(e.x, e.y, e.shift);
+            } else if constexpr (std::is_same_v<E, WheelZoom>) {
+                map.handle_wheel_zoom(e.x, e.y, e.dy);
+            } else if constexpr (std::is_same_v<E, SetPitch>) {
+                map.set_pitch(e.value);
+            } else if constexpr (std::is_same_v<E, SetBearing>) {
+                map.set_bearing(e.value);
+            } else if constexpr (std::is_same_v<E, SetStyleUrl>) {
+                map.setStyleUrl(e.url);
+            } else if constexpr (std::is_same_v<E, FlyToLocation>) {
+                map.fly_to(e.location);
+            } else if constexpr (std::is_same_v<E, FlyTo>) {
+                map.fly_to(e.lat, e.lon, e.zoom);
+            } else if constexpr (std::is_same_v<E, EstimateRegion>) {
+                map.estimate_region(e.bounds, e.first_zoom, e.last_zoom,
+                                    std::move(e.done));
+            } else if constexpr (std::is_same_v<E, SeedRegion>) {
+                map.seed_region(e.bounds, e.first_zoom, e.last_zoom,
+                                std::move(e.on_progress));
+            } else if constexpr (std::is_same_v<E, CancelSeeding>) {
+                map.cancel_seeding();
+            }
+        },
+        event);
+}
+
+void SlintMapLibreRenderThread::publish_frame(SlintMapLibre& map) {
+    Frame& frame = frames_.back();
+    if (!map.read_frame_into(frame.pixels)) {
+        return;
+    }
+    if (auto* m = map.get_map()) {
+        const auto cam = m->getCameraOptions();
+        if (cam.center) {
+            frame.camera.latitude = cam.center->latitude();
+            frame.camera.longitude = cam.center->longitude();
+        }
+        frame.camera.zoom = cam.zoom.value_or(frame.camera.zoom);
+        frame.camera.bearing = cam.bearing.value_or(frame.camera.bearing);
+        frame.camera.pitch = cam.pitch.value_or(frame.camera.pitch);
+    }
+    frames_.publish();
+    if (!frame_notified_.exchange(true) && frame_ready_) {
+        frame_ready_();
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <slint.h>
+#include <string>
+#include <thread>
+#include <variant>
+
+#include "slint_maplibre_headless.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+
+// Runs a SlintMapLibre (map, HeadlessFrontend and RunLoop) on a dedicated
+// thread so style parsing, rendering, readback and pixel conversion never
+// stall the Slint UI thread.
+//
+// The UI thread calls the same input/command methods as on SlintMapLibre;
+// they are queued without locking and applied on the render thread. Finished
+// frames are published through a triple buffer: the frame-ready callback
+// fires on the render thread, and the UI thread then collects the newest
+// frame with take_frame() and turns it into a slint::Image itself (images
+// are not thread-safe).
+class SlintMapLibreRenderThread {
+public:
+    struct Camera {
+        double latitude = 0.0;
+        double longitude = 0.0;
+        double zoom = 0.0;
+        double bearing = 0.0;
+        double pitch = 0.0;
+    };
+
+    struct Frame {
+        slint::SharedPixelBuffer<slint::Rgba8Pixel> pixels;
+        Camera camera;
+    };
+
+    // `frame_ready` runs on the render thread when a frame is published and
+    // the previous notification has been followed by take_frame(); it
+    // typically posts to the UI via slint::invoke_from_event_loop.
+    explicit SlintMapLibreRenderThread(std::function<void()> frame_ready);
+    ~SlintMapLibreRenderThread();
+
+    SlintMapLibreRenderThread(const SlintMapLibreRenderThread&) = delete;
+    SlintMapLibreRenderThread& operator=(const SlintMapLibreRenderThread&) =
+        delete;
+
+    // UI thread only. Returns the newest frame published since the last call
+    // (valid until the next call), or nullptr, in which case the previous
+    // frame is kept. A new frame hands the previous one back to the render
+    // thread, which rewrites its pixels in place: drop images made from it
+    // right away, or that write copies the whole buffer.
+    const Frame* take_frame();
+    // UI thread only. The camera of the newest frame taken, and the style
+    // last asked for (SlintMapLibre's default until then).
+    Camera camera() const {
+        return camera_;
+    }
+    std::string style_url() const {
+        return style_url_;
+    }
+
+    // UI thread only; mirror SlintMapLibre.
+    void initialize(int width, int height);
+    void resize(int width, int height);
+    void handle_mouse_press(float x, float y);
+    void handle_mouse_release(float x, float y);
+    void handle_mouse_move(float x, float y, bool pressed);
+    void handle_double_click(float x, float y, bool shift);
+    void handle_wheel_zoom(float x, float y, float dy);
+    void set_pitch(int pitch_value);
+    void set_bearing(float bearing_value);
+    void setStyleUrl(const std::string& url);
+    void fly_to(const std::string& location);
+    void fly_to(double lat, double lon, double zoom);
+    // `done` runs on the render thread.
+    void estimate_region(
+        const mbgl::LatLngBounds& bounds, double first_zoom, double last_zoom,
+        std::function<void(const mbgl::RegionSeeder::Estimate&)> done);
+    void seed_region(const mbgl::LatLngBounds& bounds, double first_zoom,
+                     double last_zoom,
+                     mbgl::RegionSeeder::ProgressCallback on_progress);
+    void cancel_seeding();
+    // Shared with the map on the render thread; Upload and end_frame() are
+    // up to the UI thread.
+    std::shared_ptr<FrameStats> frame_stats() const {
+        return stats_;
+    }
+
+private:
+    struct Initialize {
+        int width, height;
+    };
+    struct Resize {
+        int width, height;
+    };
+    struct MousePress {
+        float x, y;
+    };
+    struct MouseRelease {
+        float x, y;
+    };
+    struct MouseMove {
+        float x, y;
+        bool pressed;
+    };
+    struct DoubleClick {
+        float x, y;
+        bool shift;
+    };
+    struct WheelZoom {
+        float x, y, dy;
+    };
+    struct SetPitch {
+        int value;
+    };
+    struct SetBearing {
+        float value;
+    };
+    struct SetStyleUrl {
+        std::string url;
+    };
+    struct FlyToLocation {
+        std::string location;
+    };
+    struct FlyTo {
+        double lat, lon, zoom;
+    };
+    struct EstimateRegion {
+        mbgl::LatLngBounds bounds;
+        double first_zoom, last_zoom;
+        std::function<void(const mbgl::RegionSeeder::Estimate&)> done;
+    };
+    struct SeedRegion {
+        mbgl::LatLngBounds bounds;
+        double first_zoom, last_zoom;
+        mbgl::RegionSeeder::ProgressCallback on_progress;
+    };
+    struct CancelSeeding {};
+    using Event =
+        std::variant<std::monostate, Initialize, Resize, MousePress,
+                     MouseRelease, MouseMove, DoubleClick, WheelZoom, SetPitch,
+                     SetBearing, SetStyleUrl, FlyToLocation, FlyTo,
+                     EstimateRegion, SeedRegion, CancelSeeding>;
+
+    void post(Event event);
+    void wake();
+    void run();
+    void apply(SlintMapLibre& map, Event& event);
+    void publish_frame(SlintMapLibre& map);
+
+    std::function<void()> frame_ready_;
+
+    SpscQueue<Event, 256> events_;
+    TripleBuffer<Frame> frames_;
+    std::atomic<bool> frame_notified_{false};
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool wake_requested_ = false;
+    std::atomic<bool> stopping_{false};
+
+    bool initialized_ = false;  // render thread only
+    std::shared_ptr<FrameStats> stats_ = std::make_shared<FrameStats>();
+
+    Camera camera_;                                             // UI thread
+    std::string style_url_ = SlintMapLibre::default_style_url;  // UI thread
+
+    // Started last, joined first.
+    std::thread thread_;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Neither side ever blocks: try_push() fails when the queue is full
+// and try_pop() returns nothing when it is empty.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+public:
+    // Producer thread only.
+    bool try_push(T value) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots_[tail & (Capacity - 1)] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    std::optional<T> try_pop() {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        std::optional<T> value(std::move(slots_[head & (Capacity - 1)]));
+        head_.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+private:
+    std::array<T, Capacity> slots_{};
+    // Kept on separate cache lines so the two threads do not false-share.
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Which tiles a camera position needs, so they can be fetched before the
+// camera gets there. Works on 512 px XYZ tiles (what MapLibre uses for
+// vector sources) and ignores pitch and bearing, which only matters at the
+// edges of the cover.
+struct TileCoordinate {
+    std::uint8_t z = 0;
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+
+    bool operator==(const TileCoordinate& other) const {
+        return z == other.z && x == other.x && y == other.y;
+    }
+};
+
+// Normalized Web Mercator position: [0, 1] on both axes, y pointing south.
+struct MercatorPoint {
+    double x = 0.5;
+    double y = 0.5;
+};
+
+inline MercatorPoint project_mercator(double lat, double lon) {
+    constexpr double kMaxLatitude = 85.051128779806604;
+    const double phi = std::clamp(lat, -kMaxLatitude, kMaxLatitude) *
+                       M_PI / 180.0;
+    MercatorPoint p;
+    p.x = (lon + 180.0) / 360.0;
+    p.x -= std::floor(p.x);
+    p.y = 0.5 - std::log(std::tan(M_PI / 4.0 + phi / 2.0)) / (2.0 * M_PI);
+    return p;
+}
+
+// Longitude difference from `from` to `to` the short way round, in
+// [-180, 180]; a camera flying between the two crosses the antimeridian
+// when that is shorter.
+inline double longitude_delta(double from, double to) {
+    const double delta = to - from;
+    return delta - 360.0 * std::round(delta / 360.0);
+}
+
+// Tile zoom level MapLibre loads for a camera zoom.
+inline std::uint8_t cover_zoom(double zoom) {
+    return static_cast<std::uint8_t>(std::clamp(std::floor(zoom), 0.0, 22.0));
+}
+
+// Tiles of zoom level `z` under a width x height px viewport centred on
+// `center` with the map shown at `zoom`, grown by `margin` px on every
+// side. Nearest the centre first; x wraps around the antimeridian.
+inline std::vector<TileCoordinate> tile_cover(MercatorPoint center,
+                                              double zoom, double width,
+                                              double height, std::uint8_t z,
+                                              double margin = 0.0) {
+    const double tiles = std::ldexp(1.0, z);
+    const double world_px = 512.0 * std::exp2(zoom);
+    const double half_w = (width / 2.0 + margin) / world_px * tiles;
+    const double half_h = (height / 2.0 + margin) / world_px * tiles;
+    const double cx = center.x * tiles;
+    const double cy = center.y * tiles;
+
+    auto x0 = static_cast<std::int64_t>(std::floor(cx - half_w));
+    // Upper bounds are exclusive: a tile the viewport only touches at its
+    // edge is not visible.
+    auto x1 = static_cast<std::int64_t>(std::ceil(cx + half_w)) - 1;
+    if (x1 - x0 + 1 >= static_cast<std::int64_t>(tiles)) {
+        x0 = 0;
+        x1 = static_cast<std::int64_t>(tiles) - 1;
+    }
+    const auto y0 = std::max<std::int64_t>(
+        0, static_cast<std::int64_t>(std::floor(cy - half_h)));
+    const auto y1 = std::min<std::int64_t>(
+        static_cast<std::int64_t>(tiles) - 1,
+        static_cast<std::int64_t>(std::ceil(cy + half_h)) - 1);
+
+    struct Candidate {
+        TileCoordinate tile;
+        double distance;
+    };
+    std::vector<Candidate> candidates;
+    const auto n = static_cast<std::int64_t>(tiles);
+    for (std::int64_t y = y0; y <= y1; ++y) {
+        for (std::int64_t x = x0; x <= x1; ++x) {
+            const double dx = x + 0.5 - cx;
+            const double dy = y + 0.5 - cy;
+            const auto wrapped = static_cast<std::uint32_t>(((x % n) + n) % n);
+            candidates.push_back({{z, wrapped, static_cast<std::uint32_t>(y)},
+                                  dx * dx + dy * dy});
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b) {
+                         return a.distance < b.distance;
+                     });
+    std::vector<TileCoordinate> result;
+    result.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+        result.push_back(candidate.tile);
+    }
+    return result;
+}
+
+// The tile MapLibre loads in place of `tile` from a source that has tiles
+// for zoom levels min_zoom..max_zoom: its ancestor at max_zoom above that
+// range (overzooming), none below it.
+inline std::optional<TileCoordinate> source_tile(TileCoordinate tile,
+                                                 std::uint8_t min_zoom,
+                                                 std::uint8_t max_zoom) {
+    if (tile.z < min_zoom) {
+        return std::nullopt;
+    }
+    if (tile.z > max_zoom) {
+        const int shift = tile.z - max_zoom;
+        tile = {max_zoom, tile.x >> shift, tile.y >> shift};
+    }
+    return tile;
+}
+
+// Appends the tiles of `more` that are not in `tiles` yet, up to `budget`
+// tiles in total. Returns false once the budget is used up.
+inline bool append_tiles(std::vector<TileCoordinate>& tiles,
+                         const std::vector<TileCoordinate>& more,
+                         std::size_t budget) {
+    for (const auto& tile : more) {
+        if (tiles.size() >= budget) {
+            return false;
+        }
+        if (std::find(tiles.begin(), tiles.end(), tile) == tiles.end()) {
+            tiles.push_back(tile);
+        }
+    }
+    return tiles.size() < budget;
+}
+
+// Highest zoom at which both points fit into the viewport; a fly-to passes
+// through about this zoom on its way from one to the other.
+inline double fit_zoom(MercatorPoint a, MercatorPoint b, double width,
+                       double height) {
+    double dx = std::abs(a.x - b.x);
+    dx = std::min(dx, 1.0 - dx);
+    const double dy = std::abs(a.y - b.y);
+    const double span = std::max(dx / std::max(1.0, width),
+                                 dy / std::max(1.0, height));
+    if (span <= 0.0) {
+        return 22.0;
+    }
+    return std::clamp(std::log2(1.0 / (512.0 * span)), 0.0, 22.0);
+}
+
+// Tiles for a fly-to, most important first: the destination viewport at the
+// target zoom, then coarse covers at `mid_zoom` along the (linearly
+// interpolated, short way round) path, which is what is on screen while the
+// camera is zoomed out. At most `budget` tiles.
+inline std::vector<TileCoordinate> fly_to_tiles(double start_lat,
+                                                double start_lon,
+                                                double target_lat,
+                                                double target_lon,
+                                                double mid_zoom,
+                                                double target_zoom,
+                                                double width, double height,
+                                                std::size_t budget) {
+    std::vector<TileCoordinate> tiles;
+    const MercatorPoint target = project_mercator(target_lat, target_lon);
+    if (!append_tiles(tiles,
+                      tile_cover(target, target_zoom, width, height,
+                                 cover_zoom(target_zoom)),
+                      budget)) {
+        return tiles;
+    }
+    const std::uint8_t z = cover_zoom(mid_zoom);
+    const double delta_lon = longitude_delta(start_lon, target_lon);
+    for (double t : {0.5, 0.25, 0.75, 1.0}) {
+        const MercatorPoint point =
+            project_mercator(start_lat + (target_lat - start_lat) * t,
+                             start_lon + delta_lon * t);
+        if (!append_tiles(tiles, tile_cover(point, mid_zoom, width, height, z),
+                          budget)) {
+            break;
+        }
+    }
+    return tiles;
+}
+
+// Number of tiles of the zoom levels floor(min_zoom)..floor(max_zoom) that
+// intersect a latitude/longitude box, which is what an offline region with
+// these bounds downloads per tile source. A box with west > east crosses the
+// antimeridian.
+inline std::uint64_t region_tile_count(double south, double west,
+                                       double north, double east,
+                                       double min_zoom, double max_zoom) {
+    const MercatorPoint north_west = project_mercator(north, west);
+    const MercatorPoint south_east = project_mercator(south, east);
+    // project_mercator wraps longitudes; 180 must stay the eastern edge.
+    const double east_x = east >= 180.0 ? 1.0 : south_east.x;
+    const bool wraps = west > east;
+    std::uint64_t count = 0;
+    for (int z = cover_zoom(min_zoom); z <= cover_zoom(max_zoom); ++z) {
+        const double tiles = std::ldexp(1.0, z);
+        const auto n = static_cast<std::int64_t>(tiles);
+        auto first = [&](double v) {
+            return std::clamp<std::int64_t>(
+                static_cast<std::int64_t>(std::floor(v * tiles)), 0, n - 1);
+        };
+        // Exclusive upper edges, as in tile_cover().
+        auto last = [&](double v) {
+            return std::clamp<std::int64_t>(
+                static_cast<std::int64_t>(std::ceil(v * tiles)) - 1, 0, n - 1);
+        };
+        // A box narrower than a tile still needs the tile it lies in.
+        const std::int64_t x0 = first(north_west.x);
+        const std::int64_t x1 =
+            wraps ? last(east_x) : std::max(x0, last(east_x));
+        const std::int64_t y0 = first(north_west.y);
+        const std::int64_t y1 = std::max(y0, last(south_east.y));
+        const std::int64_t columns =
+            wraps ? std::min(n, (n - x0) + (x1 + 1)) : x1 - x0 + 1;
+        const std::int64_t rows = y1 - y0 + 1;
+        count += static_cast<std::uint64_t>(columns * rows);
+    }
+    return count;
+}
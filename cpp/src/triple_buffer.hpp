@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Single-producer/single-consumer triple buffer ("mailbox"). The producer
+// always has a slot to write into, the consumer always has a slot to read,
+// and the third slot holds the most recently published value, so neither
+// side waits for the other and the consumer only ever sees the newest value.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer thread only: the slot to fill before publish().
+    T& back() {
+        return slots_[back_];
+    }
+
+    // Producer thread only: hands back() to the consumer, replacing any
+    // value it has not taken yet, and takes over that slot for writing.
+    void publish() {
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+                kIndexMask;
+    }
+
+    // Consumer thread only: the newest published value, or nullptr if
+    // nothing was published since the last call. The pointer stays valid
+    // until the next call.
+    T* take() {
+        if (!(middle_.load(std::memory_order_acquire) & kFresh)) {
+            return nullptr;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) &
+                 kIndexMask;
+        return &slots_[front_];
+    }
+
+private:
+    static constexpr unsigned char kIndexMask = 0x3;
+    static constexpr unsigned char kFresh = 0x4;
+
+    std::array<T, 3> slots_{};
+    std::atomic<unsigned char> middle_{1};
+    unsigned char back_ = 0;   // producer-owned
+    unsigned char front_ = 2;  // consumer-owned
+};
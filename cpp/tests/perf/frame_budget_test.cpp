@@ -0,0 +1,303 @@
+// Replays scripted interactions against SlintMapLibre and fails when frame
+// time or allocations per frame exceed the baselines checked in next to this
+// file (budgets.txt) by more than a fixed margin, or when readback or
+// conversion allocate more than the one image MapLibre reads back.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "alloc_counter.hpp"
+#include "fixture.hpp"
+#include "frame_stats.hpp"
+#include "log.hpp"
+#include "slint_maplibre_headless.hpp"
+
+#ifndef PERF_BUDGETS_FILE
+#define PERF_BUDGETS_FILE "budgets.txt"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kSize = 512;
+constexpr float kCenter = kSize / 2.0f;
+// Readback and conversion each pass over the frame once.
+constexpr std::uint64_t kFrameBytes = std::uint64_t{kSize} * kSize * 4;
+constexpr std::uint64_t kCopiedBytesPerFrame = 2 * kFrameBytes;
+
+// Allowed excess over a measured baseline: llvmpipe frame times vary more
+// between runs than allocation counts do.
+double margin(const std::string& metric) {
+    return metric == "median_ms" || metric == "p95_ms" ? 1.5 : 1.25;
+}
+
+struct Scenario {
+    const char* name;
+    int frames;
+    // Input for frame `i`, applied before it is rendered.
+    void (*step)(SlintMapLibre& map, int i, int frames);
+};
+
+// One measured pass of a scenario, after a pass that loaded its tiles.
+struct Measurement {
+    int rendered = 0;
+    FrameStats::Summary frame;
+    alloc_counter::Counts process;
+    alloc_counter::Counts stages;
+    alloc_counter::Counts readback;
+    alloc_counter::Counts convert;
+    std::uint64_t copied_bytes = 0;
+};
+
+const Scenario kScenarios[] = {
+    {"static", 60, nullptr},
+    {"drag", 60,
+     [](SlintMapLibre& map, int i, int frames) {
+         if (i == 0) {
+             map.handle_mouse_press(kCenter, kCenter);
+         } else if (i == frames - 1) {
+             map.handle_mouse_release(kCenter - 6.0f * i, kCenter - 2.0f * i);
+         } else {
+             map.handle_mouse_move(kCenter - 6.0f * i, kCenter - 2.0f * i,
+                                   true);
+         }
+     }},
+    {"wheel", 60,
+     [](SlintMapLibre& map, int i, int) {
+         // Ten notches in, ten out, around a slowly moving cursor.
+         const float dy = (i / 10) % 2 == 0 ? -1.0f : 1.0f;
+         map.handle_wheel_zoom(kCenter + (i % 5) * 10.0f, kCenter, dy);
+     }},
+    {"double_click", 60,
+     [](SlintMapLibre& map, int i, int) {
+         if (i % 8 == 0) {
+             map.handle_double_click(200.0f + (i % 3) * 40.0f, 300.0f,
+                                     (i / 8) % 2 == 1);
+         }
+     }},
+    {"fly_to", 90,
+     [](SlintMapLibre& map, int i, int frames) {
+         // Tokyo to Osaka and back along a zoomed-out arc. The camera is
+         // placed on every frame, as an animation would, but without
+         // depending on how long the frames take.
+         const int leg = std::max(1, frames / 2);
+         const double t = double(i % leg + 1) / leg;
+         const double k = i < leg ? t : 1.0 - t;
+         map.get_map()->jumpTo(
+             mbgl::CameraOptions()
+                 .withCenter(mbgl::LatLng{35.681 + (34.693 - 35.681) * k,
+                                          139.767 + (135.502 - 139.767) * k})
+                 .withZoom(10.0 - 7.0 * std::sin(M_PI * t)));
+     }},
+};
+
+// "<scenario> <metric>" -> baseline
+std::map<std::string, double> load_budgets(const std::string& path) {
+    std::map<std::string, double> budgets;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string scenario, metric;
+        double baseline = 0.0;
+        if (!(fields >> scenario) || scenario[0] == '#') {
+            continue;
+        }
+        if (fields >> metric >> baseline) {
+            budgets[scenario + " " + metric] = baseline;
+        }
+    }
+    return budgets;
+}
+
+bool pump_until_idle(SlintMapLibre& map, std::chrono::seconds timeout) {
+    const auto deadline = Clock::now() + timeout;
+    while (Clock::now() < deadline) {
+        const bool busy = map.run_map_loop();
+        map.take_repaint_request();
+        if (!busy && map.get_map()->isFullyLoaded()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// Pumps until MapLibre has rendered, then reads the frame back as the UI
+// would. Returns false if nothing was rendered in time.
+bool render_frame(SlintMapLibre& map) {
+    map.get_map()->triggerRepaint();
+    const auto deadline = Clock::now() + std::chrono::seconds(2);
+    while (Clock::now() < deadline) {
+        map.run_map_loop();
+        if (map.take_repaint_request()) {
+            map.render_map();
+            map.frame_stats()->end_frame();
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+class FrameBudgetTest : public ::testing::TestWithParam<Scenario> {
+protected:
+    static void SetUpTestSuite() {
+        slint_maplibre::log::set_level(slint_maplibre::log::Level::Warning);
+        const auto directory =
+            std::filesystem::temp_directory_path() / "maplibre-slint-perf";
+        const BenchFixture fixture = write_bench_fixture(directory);
+        map = std::make_unique<SlintMapLibre>();
+        map->setStyleUrl(fixture.style_url);
+        map->initialize(kSize, kSize);
+        loaded = pump_until_idle(*map, std::chrono::seconds(30));
+        budgets = load_budgets(PERF_BUDGETS_FILE);
+    }
+
+    static void TearDownTestSuite() {
+        map.reset();
+    }
+
+    // Runs the script from the start position; returns the frames rendered.
+    static int play(const Scenario& scenario) {
+        map->get_map()->jumpTo(mbgl::CameraOptions()
+                                   .withCenter(mbgl::LatLng{35.681, 139.767})
+                                   .withZoom(10.0)
+                                   .withBearing(0.0)
+                                   .withPitch(0.0));
+        pump_until_idle(*map, std::chrono::seconds(10));
+        map->frame_stats()->reset();
+        alloc_counter::reset();
+        alloc_counter::start();
+        int rendered = 0;
+        for (int i = 0; i < scenario.frames; ++i) {
+            if (scenario.step) {
+                scenario.step(*map, i, scenario.frames);
+            }
+            rendered += render_frame(*map) ? 1 : 0;
+        }
+        alloc_counter::stop();
+        return rendered;
+    }
+
+    // The scenario's steady state, measured once and shared by the tests.
+    static const Measurement& measure(const Scenario& scenario) {
+        auto it = measurements.find(scenario.name);
+        if (it != measurements.end()) {
+            return it->second;
+        }
+        // The first pass loads and parses the tiles the script visits.
+        play(scenario);
+        Measurement m;
+        m.rendered = play(scenario);
+        const auto& stats = *map->frame_stats();
+        m.frame = stats.summary(FrameStage::Frame);
+        m.process = alloc_counter::counts();
+        m.stages = stats.allocations(FrameStage::Frame);
+        m.readback = stats.allocations(FrameStage::Readback);
+        m.convert = stats.allocations(FrameStage::Convert);
+        m.copied_bytes = stats.copied_bytes();
+        return measurements.emplace(scenario.name, m).first->second;
+    }
+
+    void check(const std::string& metric, double measured) {
+        const std::string key = std::string(GetParam().name) + " " + metric;
+        if (std::getenv("SLINT_MAPLIBRE_PERF_REPORT")) {
+            std::printf("%-13s %-28s %.1f\n", GetParam().name, metric.c_str(),
+                        measured);
+        }
+        const auto baseline = budgets.find(key);
+        if (baseline == budgets.end()) {
+            ADD_FAILURE() << "no baseline for '" << key << "' in "
+                          << PERF_BUDGETS_FILE;
+            return;
+        }
+        const double limit = baseline->second * margin(metric);
+        EXPECT_LE(measured, limit)
+            << key << " is over budget (" << measured << " > " << limit
+            << ", baseline " << baseline->second << ")";
+    }
+
+    static std::unique_ptr<SlintMapLibre> map;
+    static bool loaded;
+    static std::map<std::string, double> budgets;
+    static std::map<std::string, Measurement> measurements;
+};
+
+std::unique_ptr<SlintMapLibre> FrameBudgetTest::map;
+bool FrameBudgetTest::loaded = false;
+std::map<std::string, double> FrameBudgetTest::budgets;
+std::map<std::string, Measurement> FrameBudgetTest::measurements;
+
+// Machine dependent; ctest labels it "timing" as well as "perf".
+TEST_P(FrameBudgetTest, FrameTimeStaysWithinBudget) {
+    ASSERT_TRUE(loaded) << "the fixture style did not load";
+    const Measurement& m = measure(GetParam());
+    ASSERT_EQ(m.rendered, GetParam().frames)
+        << "frames were not rendered in time";
+    check("median_ms", m.frame.p50_ms);
+    check("p95_ms", m.frame.p95_ms);
+}
+
+TEST_P(FrameBudgetTest, AllocationsStayWithinBudget) {
+    ASSERT_TRUE(loaded) << "the fixture style did not load";
+    const Measurement& m = measure(GetParam());
+    ASSERT_EQ(m.rendered, GetParam().frames)
+        << "frames were not rendered in time";
+    check("allocations_per_frame",
+          static_cast<double>(m.process.allocations) / m.rendered);
+    // The part of those made by the frame stages themselves, on this thread.
+    check("stage_allocations_per_frame",
+          static_cast<double>(m.stages.allocations) / m.rendered);
+}
+
+// Needs no baseline, so unlike the budgets it holds on any machine.
+TEST_P(FrameBudgetTest, CopiesEachFrameTwice) {
+    ASSERT_TRUE(loaded) << "the fixture style did not load";
+    const Measurement& m = measure(GetParam());
+    ASSERT_EQ(m.rendered, GetParam().frames)
+        << "frames were not rendered in time";
+    const auto frames = static_cast<std::uint64_t>(m.rendered);
+    // The allocation counter sees every operator new, so a copy into a new
+    // buffer cannot go unrecorded: readback allocates the image MapLibre
+    // hands back and nothing near another frame's worth, conversion writes
+    // into recycled buffers and allocates nothing.
+    EXPECT_GE(m.readback.bytes, kFrameBytes * frames);
+    EXPECT_LT(m.readback.bytes, 2 * kFrameBytes * frames)
+        << "readback allocated another full frame";
+    EXPECT_EQ(m.convert.bytes, 0u) << "conversion allocated";
+    // A pass over an existing buffer only counts where the code books it
+    // with add_copied_bytes(), so this covers the booked passes only.
+    EXPECT_EQ(m.copied_bytes, kCopiedBytesPerFrame * frames);
+
+    // The Debug-level pixel statistics scan the frame once more, and that
+    // is counted too.
+    const auto level = slint_maplibre::log::level();
+    slint_maplibre::log::set_level(slint_maplibre::log::Level::Debug);
+    map->frame_stats()->reset();
+    const bool debug_rendered = render_frame(*map);
+    slint_maplibre::log::set_level(level);
+    ASSERT_TRUE(debug_rendered);
+    EXPECT_EQ(map->frame_stats()->copied_bytes(),
+              kCopiedBytesPerFrame + kFrameBytes);
+}
+
+INSTANTIATE_TEST_SUITE_P(Scenarios, FrameBudgetTest,
+                         ::testing::ValuesIn(kScenarios),
+                         [](const auto& info) {
+                             return std::string(info.param.name);
+                         });
+
+}  // namespace
@@ -0,0 +1,477 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <gtest/gtest.h>
+#include <mbgl/storage/resource.hpp>
+#include <mbgl/storage/resource_transform.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "custom_file_source.hpp"
+#include "disk_cache.hpp"
+#include "local_http_server.hpp"
+
+// CustomFileSource against a scripted local server: status mapping, and the
+// retries and refreshes mbgl expects from its network file source.
+namespace {
+
+using namespace std::chrono_literals;
+
+LocalHttpServer::Options scripted(LocalHttpServer::Handler handler) {
+    LocalHttpServer::Options options;
+    options.latency = 0ms;
+    options.jitter = 0ms;
+    options.threads = 4;
+    options.handler = std::move(handler);
+    return options;
+}
+
+bool wait_for(const std::function<bool()>& done,
+              std::chrono::milliseconds timeout = 5000ms) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(5ms);
+    }
+    return true;
+}
+
+// Responses of one request, as they arrive on the fetch workers.
+class Responses {
+public:
+    mbgl::FileSource::Callback callback() {
+        return [this](mbgl::Response response) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            responses_.push_back(std::move(response));
+        };
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return responses_.size();
+    }
+
+    mbgl::Response at(std::size_t i) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return responses_.at(i);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<mbgl::Response> responses_;
+};
+
+}  // namespace
+
+class CustomFileSourceHttpTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        // Before the server, so no transfer outlives it.
+        file_source.reset();
+        server.reset();
+    }
+
+    void serve(LocalHttpServer::Handler handler) {
+        server = std::make_unique<LocalHttpServer>(
+            scripted(std::move(handler)));
+    }
+
+    std::string url(const std::string& path) const {
+        return server->base_url() + path;
+    }
+
+    std::unique_ptr<LocalHttpServer> server;
+    std::unique_ptr<mbgl::CustomFileSource> file_source =
+        std::make_unique<mbgl::CustomFileSource>();
+};
+
+TEST_F(CustomFileSourceHttpTest, IdenticalRequestsEachGetOneResponse) {
+    // Identical requests share one transfer, every live requester still
+    // gets exactly one response, and a cancelled one gets none
+    serve([](const LocalHttpServer::Request&) {
+        // Slow enough for all requests to join the first.
+        std::this_thread::sleep_for(200ms);
+        return LocalHttpServer::Reply{200, "", "tile"};
+    });
+    const mbgl::Resource resource(mbgl::Resource::Kind::Tile,
+                                  url("/0/0/0.pbf"));
+    std::atomic<int> responses{0};
+    std::vector<std::unique_ptr<mbgl::AsyncRequest>> requests;
+    for (int i = 0; i < 4; ++i) {
+        requests.push_back(file_source->request(
+            resource, [&responses](mbgl::Response response) {
+                EXPECT_TRUE(response.data);
+                ++responses;
+            }));
+    }
+    requests[1].reset();
+
+    ASSERT_TRUE(wait_for([&] { return responses.load() >= 3; }));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_EQ(responses.load(), 3);
+    EXPECT_EQ(server->stats().requests, 1u);
+    EXPECT_EQ(file_source->transferStats().transfers, 1u);
+}
+
+TEST_F(CustomFileSourceHttpTest, TransfersAreBoundedByTheWorkerCount) {
+    // More requests than workers: the rest wait in the queue instead of
+    // opening more connections
+    std::atomic<int> in_flight{0};
+    std::atomic<int> peak{0};
+    serve([&](const LocalHttpServer::Request&) {
+        const int now = ++in_flight;
+        int seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(100ms);
+        --in_flight;
+        return LocalHttpServer::Reply{200, "", "tile"};
+    });
+    mbgl::CustomFileSource::FetchOptions options;
+    options.workerCount = 2;
+    file_source = std::make_unique<mbgl::CustomFileSource>(options);
+
+    std::atomic<int> responses{0};
+    std::vector<std::unique_ptr<mbgl::AsyncRequest>> requests;
+    for (int i = 0; i < 8; ++i) {
+        requests.push_back(file_source->request(
+            mbgl::Resource(mbgl::Resource::Kind::Tile,
+                           url("/3/" + std::to_string(i) + "/0.pbf")),
+            [&responses](mbgl::Response) { ++responses; }));
+    }
+
+    ASSERT_TRUE(wait_for([&] { return responses.load() == 8; }));
+    EXPECT_EQ(server->stats().requests, 8u);
+    EXPECT_GE(peak.load(), 1);
+    EXPECT_LE(static_cast<std::size_t>(peak.load()),
+              file_source->workerCount());
+}
+
+TEST_F(CustomFileSourceHttpTest, QueuedRequestsRunInPriorityOrder) {
+    // With the only worker busy, the queue decides: the style first, then
+    // glyphs, then tiles nearest to the viewport center
+    std::atomic<bool> released{false};
+    std::mutex order_mutex;
+    std::vector<std::string> order;
+    serve([&](const LocalHttpServer::Request& request) {
+        if (request.path == "/busy.pbf") {
+            while (!released) {
+                std::this_thread::sleep_for(5ms);
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(request.path);
+        }
+        return LocalHttpServer::Reply{200, "", "{}"};
+    });
+    mbgl::CustomFileSource::FetchOptions options;
+    options.workerCount = 1;
+    file_source = std::make_unique<mbgl::CustomFileSource>(options);
+    file_source->setViewport(mbgl::LatLng{0.0, 0.0}, 4.0);
+
+    std::atomic<int> responses{0};
+    auto count = [&responses](mbgl::Response) { ++responses; };
+    std::vector<std::unique_ptr<mbgl::AsyncRequest>> requests;
+    requests.push_back(file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/busy.pbf")), count));
+    ASSERT_TRUE(wait_for([&] { return server->received("/busy.pbf"); }));
+
+    // At z4 the camera is at the corner of tiles 7 and 8.
+    const std::string url_template = url("/{z}/{x}/{y}.pbf");
+    for (const int x : {14, 8, 10}) {
+        requests.push_back(file_source->request(
+            mbgl::Resource::tile(url_template, 1.0f, x, 8, 4,
+                                 mbgl::Tileset::Scheme::XYZ),
+            count));
+    }
+    requests.push_back(file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Glyphs, url("/glyphs.pbf")),
+        count));
+    requests.push_back(file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Style, url("/style.json")),
+        count));
+    released = true;
+
+    ASSERT_TRUE(wait_for([&] { return responses.load() == 6; }));
+    const std::vector<std::string> expected = {
+        "/style.json", "/glyphs.pbf", "/4/8/8.pbf", "/4/10/8.pbf",
+        "/4/14/8.pbf",
+    };
+    std::lock_guard<std::mutex> lock(order_mutex);
+    EXPECT_EQ(order, expected);
+}
+
+TEST_F(CustomFileSourceHttpTest, MissingTileIsNoContent) {
+    serve([](const LocalHttpServer::Request&) {
+        return LocalHttpServer::Reply{404, "", ""};
+    });
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/0/0/0.pbf")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    const mbgl::Response response = responses.at(0);
+    EXPECT_FALSE(response.error);
+    EXPECT_TRUE(response.noContent);
+}
+
+TEST_F(CustomFileSourceHttpTest, MissingStyleIsNotFoundAndNotRetried) {
+    serve([](const LocalHttpServer::Request&) {
+        return LocalHttpServer::Reply{404, "", ""};
+    });
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Style, url("/style.json")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    const mbgl::Response response = responses.at(0);
+    ASSERT_TRUE(response.error);
+    EXPECT_EQ(response.error->reason, mbgl::Response::Error::Reason::NotFound);
+
+    // A server error would have been retried after a second.
+    std::this_thread::sleep_for(1500ms);
+    EXPECT_EQ(responses.size(), 1u);
+    EXPECT_EQ(server->stats().requests, 1u);
+}
+
+TEST_F(CustomFileSourceHttpTest, ServerErrorIsRetried) {
+    std::atomic<int> calls{0};
+    serve([&calls](const LocalHttpServer::Request&) {
+        if (calls++ == 0) {
+            return LocalHttpServer::Reply{500, "", ""};
+        }
+        return LocalHttpServer::Reply{200, "", "{}"};
+    });
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Source, url("/source.json")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() >= 2; }));
+    const mbgl::Response failed = responses.at(0);
+    ASSERT_TRUE(failed.error);
+    EXPECT_EQ(failed.error->reason, mbgl::Response::Error::Reason::Server);
+    const mbgl::Response retried = responses.at(1);
+    EXPECT_FALSE(retried.error);
+    ASSERT_TRUE(retried.data);
+    EXPECT_EQ(*retried.data, "{}");
+}
+
+TEST_F(CustomFileSourceHttpTest, RateLimitedRequestWaitsForRetryAfter) {
+    // A 429 holds the request back until Retry-After has passed and then
+    // reissues it; the requester only sees the eventual answer
+    std::atomic<int> calls{0};
+    serve([&calls](const LocalHttpServer::Request&) {
+        if (calls++ == 0) {
+            return LocalHttpServer::Reply{429, "Retry-After: 2\r\n", ""};
+        }
+        return LocalHttpServer::Reply{200, "", "tile"};
+    });
+    Responses responses;
+    const auto start = std::chrono::steady_clock::now();
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/0/0/0.pbf")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 500ms);
+    std::this_thread::sleep_for(50ms);
+    ASSERT_EQ(responses.size(), 1u);
+    const mbgl::Response response = responses.at(0);
+    EXPECT_FALSE(response.error);
+    ASSERT_TRUE(response.data);
+    EXPECT_EQ(*response.data, "tile");
+    EXPECT_EQ(server->stats().requests, 2u);
+}
+
+TEST_F(CustomFileSourceHttpTest, RateLimitWithoutAWaitIsNotATightLoop) {
+    // Retry-After: 0 still backs off, 1 s and then 2 s, and after three
+    // refusals the requester gets the RateLimit error
+    serve([](const LocalHttpServer::Request&) {
+        return LocalHttpServer::Reply{429, "Retry-After: 0\r\n", ""};
+    });
+    Responses responses;
+    const auto start = std::chrono::steady_clock::now();
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/0/0/0.pbf")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }, 10000ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 2900ms);
+    EXPECT_EQ(server->stats().requests, 3u);
+    const mbgl::Response response = responses.at(0);
+    ASSERT_TRUE(response.error);
+    EXPECT_EQ(response.error->reason,
+              mbgl::Response::Error::Reason::RateLimit);
+    // The host is still backed off; mbgl's retry waits for it.
+    std::this_thread::sleep_for(500ms);
+    EXPECT_EQ(server->stats().requests, 3u);
+}
+
+TEST_F(CustomFileSourceHttpTest, ExpiringResponseIsRefreshed) {
+    std::atomic<int> revalidations{0};
+    serve([&revalidations](const LocalHttpServer::Request& request) {
+        const std::string headers =
+            "ETag: \"v1\"\r\nCache-Control: max-age=1\r\n";
+        if (request.header("If-None-Match") == "\"v1\"") {
+            ++revalidations;
+            return LocalHttpServer::Reply{304, headers, ""};
+        }
+        return LocalHttpServer::Reply{200, headers, "body"};
+    });
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/1/0/0.pbf")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() >= 2; }));
+    ASSERT_TRUE(responses.at(0).data);
+    EXPECT_EQ(*responses.at(0).data, "body");
+    // Revalidated with the validator of the first response; the requester
+    // already holds the body.
+    EXPECT_EQ(revalidations.load(), 1);
+    const mbgl::Response refreshed = responses.at(1);
+    EXPECT_FALSE(refreshed.error);
+    EXPECT_TRUE(refreshed.notModified);
+    EXPECT_TRUE(refreshed.expires);
+}
+
+TEST_F(CustomFileSourceHttpTest, DroppedRequestIsNotRefreshed) {
+    serve([](const LocalHttpServer::Request&) {
+        return LocalHttpServer::Reply{200, "Cache-Control: max-age=1\r\n",
+                                      "body"};
+    });
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/1/1/0.pbf")),
+        responses.callback());
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    request.reset();
+
+    std::this_thread::sleep_for(2500ms);
+    EXPECT_EQ(responses.size(), 1u);
+    EXPECT_EQ(server->stats().requests, 1u);
+}
+
+TEST_F(CustomFileSourceHttpTest, ResourceTransformRewritesUrls) {
+    serve([](const LocalHttpServer::Request&) {
+        return LocalHttpServer::Reply{200, "", "{}"};
+    });
+    file_source->setResourceTransform(mbgl::ResourceTransform(
+        [](mbgl::Resource::Kind, const std::string& url,
+           mbgl::ResourceTransform::FinishedCallback finished) {
+            finished(url + "?key=secret");
+        }));
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Style, url("/style.json")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    EXPECT_TRUE(server->received("/style.json?key=secret"));
+    EXPECT_FALSE(server->received("/style.json"));
+}
+
+TEST_F(CustomFileSourceHttpTest, PrefetchStaysInTheTileJsonZoomRange) {
+    std::string tiles_url;
+    serve([&tiles_url](const LocalHttpServer::Request& request) {
+        if (request.path == "/source.json") {
+            return LocalHttpServer::Reply{
+                200, "", "{\"tiles\":[\"" + tiles_url +
+                             "\"],\"minzoom\":2,\"maxzoom\":4,"
+                             "\"vector_layers\":[{\"minzoom\":0}]}"};
+        }
+        return LocalHttpServer::Reply{200, "", "tile"};
+    });
+    // Escaped the way many servers write URLs in JSON.
+    tiles_url = server->base_url() + "\\/{z}\\/{x}\\/{y}.pbf";
+    const std::string url_template = url("/{z}/{x}/{y}.pbf");
+
+    Responses source;
+    auto source_request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Source, url("/source.json")),
+        source.callback());
+    ASSERT_TRUE(wait_for([&] { return source.size() > 0; }));
+    Responses tile;
+    auto tile_request = file_source->request(
+        mbgl::Resource::tile(url_template, 1.0f, 1, 1, 3,
+                             mbgl::Tileset::Scheme::XYZ),
+        tile.callback());
+    ASSERT_TRUE(wait_for([&] { return tile.size() > 0; }));
+
+    // Below minzoom: nothing to load. Above maxzoom: MapLibre overzooms
+    // the ancestor at maxzoom.
+    EXPECT_EQ(file_source->prefetch({{0, 0, 0}, {6, 40, 20}}), 1u);
+    EXPECT_TRUE(wait_for([&] { return server->served("/4/10/5.pbf"); }));
+    EXPECT_FALSE(server->received("/0/0/0.pbf"));
+    EXPECT_FALSE(server->received("/6/40/20.pbf"));
+}
+
+TEST_F(CustomFileSourceHttpTest, GzipBodiesAreNegotiatedAndDecoded) {
+    // 4096 times 'a', gzipped
+    static const char gzipped[] =
+        "\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\x03\xed\xc1\x01\x0d\x00\x00"
+        "\x00\xc2\xa0\xac\xef\x5f\xc2\x1e\x0e\x28\x00\x00\x00\xe0\xdd\x00"
+        "\x73\xdc\x99\x9c\x00\x10\x00\x00";
+    std::atomic<bool> accepts_gzip{false};
+    serve([&accepts_gzip](const LocalHttpServer::Request& request) {
+        accepts_gzip =
+            request.header("Accept-Encoding").find("gzip") != std::string::npos;
+        return LocalHttpServer::Reply{
+            200, "Content-Encoding: gzip\r\n",
+            std::string(gzipped, sizeof(gzipped) - 1)};
+    });
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Tile, url("/0/0/0.pbf")),
+        responses.callback());
+
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    EXPECT_TRUE(accepts_gzip.load());
+    const mbgl::Response response = responses.at(0);
+    ASSERT_TRUE(response.data);
+    EXPECT_EQ(*response.data, std::string(4096, 'a'));
+    const auto stats = file_source->transferStats();
+    EXPECT_EQ(stats.decodedBytes, 4096u);
+    EXPECT_LT(stats.wireBytes, stats.decodedBytes);
+}
+
+TEST_F(CustomFileSourceHttpTest, OnlyPrefetchedTilesArePersisted) {
+    // Responses handed to mbgl end up in mbgl's own cache database; the
+    // file source only keeps what nobody asked for yet
+    serve([](const LocalHttpServer::Request&) {
+        return LocalHttpServer::Reply{200, "Cache-Control: max-age=3600\r\n",
+                                      "tile"};
+    });
+    const auto path = std::filesystem::temp_directory_path() /
+                      "maplibre-slint-http-test-cache.sqlite";
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::filesystem::remove(path.string() + suffix);
+    }
+    mbgl::CustomFileSource::FetchOptions options;
+    options.cachePath = path.string();
+    file_source = std::make_unique<mbgl::CustomFileSource>(options);
+
+    const std::string url_template = url("/{z}/{x}/{y}.pbf");
+    Responses responses;
+    auto request = file_source->request(
+        mbgl::Resource::tile(url_template, 1.0f, 0, 0, 0,
+                             mbgl::Tileset::Scheme::XYZ),
+        responses.callback());
+    ASSERT_TRUE(wait_for([&] { return responses.size() > 0; }));
+    ASSERT_EQ(file_source->prefetch({{1, 1, 1}}), 1u);
+
+    const auto stored = [&path](const std::string& url) {
+        mbgl::DiskCache cache(path.string(), 1 << 20);
+        return cache.get(url).has_value();
+    };
+    EXPECT_TRUE(wait_for([&] { return stored(url("/1/1/1.pbf")); }));
+    EXPECT_FALSE(stored(url("/0/0/0.pbf")));
+}
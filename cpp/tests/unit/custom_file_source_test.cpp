@@ -1,7 +1,11 @@
 #include "custom_file_source.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <gtest/gtest.h>
 #include <mbgl/storage/resource.hpp>
+#include <thread>
+#include <vector>
 
 class CustomFileSourceTest : public ::testing::Test {
 protected:
@@ -68,6 +72,15 @@ TEST_F(CustomFileSourceTest, CannotRequestLocalResource) {
     EXPECT_FALSE(can_request);
 }
 
+TEST_F(CustomFileSourceTest, CanRequestLocalTileArchives) {
+    EXPECT_TRUE(file_source->canRequest(mbgl::Resource(
+        mbgl::Resource::Kind::Source, "mbtiles:///data/region.mbtiles")));
+    EXPECT_TRUE(file_source->canRequest(mbgl::Resource(
+        mbgl::Resource::Kind::Tile, "pmtiles:///data/region.pmtiles/1/0/0")));
+    EXPECT_FALSE(file_source->canRequest(mbgl::Resource(
+        mbgl::Resource::Kind::Glyphs, "pmtiles:///data/region.pmtiles")));
+}
+
 TEST_F(CustomFileSourceTest, CannotRequestInvalidResource) {
     mbgl::Resource resource(mbgl::Resource::Kind::Source, "invalid-url");
 
@@ -327,4 +340,121 @@ TEST_F(CustomFileSourceTest, HttpAndHttpsComparison) {
 
     EXPECT_TRUE(file_source->canRequest(http_resource));
     EXPECT_TRUE(file_source->canRequest(https_resource));
-}
\ No newline at end of file
+}
+
+TEST_F(CustomFileSourceTest, CancelledTransfersDoNotBlockShutdown) {
+    // A dropped request aborts its transfer instead of waiting for the
+    // connect timeout, so shutting down with stale requests is quick
+    auto fs = std::make_unique<mbgl::CustomFileSource>(
+        mbgl::CustomFileSource::FetchOptions{1});
+
+    std::vector<std::unique_ptr<mbgl::AsyncRequest>> requests;
+    for (int i = 0; i < 10; ++i) {
+        mbgl::Resource resource(mbgl::Resource::Kind::Tile,
+                                "http://10.255.255.1/tiles/" +
+                                    std::to_string(i) + ".pbf");
+        requests.push_back(fs->request(resource, [](mbgl::Response) {
+            FAIL() << "Callback should not be called after cancellation";
+        }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const auto start = std::chrono::steady_clock::now();
+    requests.clear();
+    fs.reset();
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(5));
+}
+
+TEST_F(CustomFileSourceTest, ResponseListenerNotified) {
+    // Listeners hear about every handed-back response, failures included
+    std::atomic<int> notified{0};
+    const auto id =
+        file_source->addResponseListener([&notified]() { ++notified; });
+
+    mbgl::Resource resource(mbgl::Resource::Kind::Style,
+                            "http://127.0.0.1:1/style.json");
+    auto request = file_source->request(resource, [](mbgl::Response) {});
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (notified.load() == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(notified.load(), 1);
+
+    // Removed listeners are not called again
+    file_source->removeResponseListener(id);
+    auto second = file_source->request(resource, [](mbgl::Response) {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(notified.load(), 1);
+}
+
+TEST_F(CustomFileSourceTest, FailedResponsesAreNotCached) {
+    // Each request looks in the memory cache; errors never land in it
+    std::atomic<int> responses{0};
+    mbgl::Resource resource(mbgl::Resource::Kind::Style,
+                            "http://127.0.0.1:1/style.json");
+    auto first = file_source->request(
+        resource, [&responses](mbgl::Response) { ++responses; });
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (responses.load() == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto second = file_source->request(resource, [](mbgl::Response) {});
+
+    const auto stats = file_source->memoryCacheStats();
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.entries, 0u);
+}
+
+TEST_F(CustomFileSourceTest, FailedConnectionsAreNotCountedAsTransfers) {
+    std::atomic<int> responses{0};
+    auto request = file_source->request(
+        mbgl::Resource(mbgl::Resource::Kind::Style,
+                       "http://127.0.0.1:1/style.json"),
+        [&responses](mbgl::Response) { ++responses; });
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (responses.load() == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    const auto stats = file_source->transferStats();
+    EXPECT_EQ(stats.transfers, 0u);
+    EXPECT_EQ(stats.wireBytes, 0u);
+    EXPECT_EQ(stats.decodedBytes, 0u);
+}
+
+TEST_F(CustomFileSourceTest, PrefetchExpandsKnownTileTemplates) {
+    // Nothing to expand before a tile source has been seen
+    EXPECT_EQ(file_source->prefetch({{1, 0, 0}, {1, 1, 0}}), 0u);
+
+    const std::string url_template = "http://127.0.0.1:1/{z}/{x}/{y}.pbf";
+    mbgl::Resource tile(mbgl::Resource::Kind::Tile,
+                        "http://127.0.0.1:1/0/0/0.pbf",
+                        mbgl::Resource::TileData{url_template, 1, 0, 0, 0});
+    auto request = file_source->request(tile, [](mbgl::Response) {});
+
+    EXPECT_EQ(file_source->prefetch({{1, 0, 0}, {1, 1, 0}}), 2u);
+}
+
+TEST_F(CustomFileSourceTest, SetViewport) {
+    // Viewport updates only reorder pending requests (the order itself is
+    // tested against a local server in custom_file_source_http_test.cpp)
+    EXPECT_NO_THROW(
+        file_source->setViewport(mbgl::LatLng{35.6895, 139.6917}, 10.0));
+    EXPECT_NO_THROW(file_source->setViewport(mbgl::LatLng{90.0, 540.0}, 0.0));
+}
+
+TEST_F(CustomFileSourceTest, InstallDefaultReturnsSharedInstance) {
+    auto first = mbgl::CustomFileSource::installDefault();
+    auto second = mbgl::CustomFileSource::installDefault();
+    EXPECT_NE(first, nullptr);
+    EXPECT_EQ(first, second);
+}
@@ -0,0 +1,115 @@
+#include "disk_cache.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+
+std::filesystem::path temp_cache_path(const char* name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string("maplibre-slint-") + name + ".sqlite");
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::filesystem::remove(path.string() + suffix);
+    }
+    return path;
+}
+
+mbgl::DiskCache::Entry make_entry(std::string body) {
+    mbgl::DiskCache::Entry entry;
+    entry.data = std::make_shared<const std::string>(std::move(body));
+    return entry;
+}
+
+}  // namespace
+
+TEST(DiskCacheTest, RoundTripsEntries) {
+    const auto path = temp_cache_path("roundtrip");
+    const auto expires = mbgl::util::now() + std::chrono::hours(1);
+    {
+        mbgl::DiskCache cache(path.string(), 1 << 20);
+        ASSERT_TRUE(cache.isOpen());
+        EXPECT_FALSE(cache.get("https://example.com/a").has_value());
+
+        auto entry = make_entry(std::string("tile\0data", 9));
+        entry.etag = "\"abc\"";
+        entry.expires = expires;
+        cache.put("https://example.com/a", entry);
+    }
+
+    // Survives reopening, binary-safe.
+    mbgl::DiskCache cache(path.string(), 1 << 20);
+    auto entry = cache.get("https://example.com/a");
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(*entry->data, std::string("tile\0data", 9));
+    EXPECT_EQ(entry->etag, "\"abc\"");
+    EXPECT_EQ(entry->expires, expires);
+    EXPECT_FALSE(entry->modified.has_value());
+    EXPECT_TRUE(entry->isFresh(mbgl::util::now()));
+    EXPECT_EQ(cache.size(), 9u);
+}
+
+TEST(DiskCacheTest, RefreshKeepsBody) {
+    const auto path = temp_cache_path("refresh");
+    mbgl::DiskCache cache(path.string(), 1 << 20);
+
+    auto entry = make_entry("body");
+    entry.etag = "\"v1\"";
+    cache.put("https://example.com/b", entry);
+    EXPECT_FALSE(cache.get("https://example.com/b")->isFresh(
+        mbgl::util::now()));
+
+    mbgl::DiskCache::Entry validators;
+    validators.expires = mbgl::util::now() + std::chrono::minutes(5);
+    cache.refresh("https://example.com/b", validators);
+
+    auto refreshed = cache.get("https://example.com/b");
+    ASSERT_TRUE(refreshed.has_value());
+    EXPECT_EQ(*refreshed->data, "body");
+    EXPECT_EQ(refreshed->etag, "\"v1\"");  // not sent again, so kept
+    EXPECT_TRUE(refreshed->isFresh(mbgl::util::now()));
+}
+
+TEST(DiskCacheTest, EvictsLeastRecentlyUsed) {
+    const auto path = temp_cache_path("evict");
+    mbgl::DiskCache cache(path.string(), 1000);
+
+    const std::string body(300, 'x');
+    cache.put("https://example.com/1", make_entry(body));
+    cache.put("https://example.com/2", make_entry(body));
+    cache.put("https://example.com/3", make_entry(body));
+    // Touch the oldest so the second one becomes least recently used.
+    EXPECT_TRUE(cache.get("https://example.com/1").has_value());
+    cache.put("https://example.com/4", make_entry(body));
+
+    EXPECT_LE(cache.size(), 1000u);
+    EXPECT_TRUE(cache.get("https://example.com/1").has_value());
+    EXPECT_FALSE(cache.get("https://example.com/2").has_value());
+    EXPECT_TRUE(cache.get("https://example.com/4").has_value());
+}
+
+TEST(DiskCacheTest, UnwritablePathDisablesCache) {
+    mbgl::DiskCache cache("/nonexistent-dir/cache.sqlite", 1 << 20);
+    EXPECT_FALSE(cache.isOpen());
+    cache.put("https://example.com/a", make_entry("data"));
+    EXPECT_FALSE(cache.get("https://example.com/a").has_value());
+}
+
+TEST(DiskCacheTest, BatchedReadsStillOrderEviction) {
+    // Reads are written back when the cache closes, so the access order
+    // survives a restart
+    const auto path = temp_cache_path("touch");
+    const std::string body(300, 'x');
+    {
+        mbgl::DiskCache cache(path.string(), 1000);
+        cache.put("https://example.com/1", make_entry(body));
+        cache.put("https://example.com/2", make_entry(body));
+        cache.put("https://example.com/3", make_entry(body));
+        EXPECT_TRUE(cache.get("https://example.com/1").has_value());
+    }
+    mbgl::DiskCache cache(path.string(), 1000);
+    cache.put("https://example.com/4", make_entry(body));
+    EXPECT_TRUE(cache.get("https://example.com/1").has_value());
+    EXPECT_FALSE(cache.get("https://example.com/2").has_value());
+}
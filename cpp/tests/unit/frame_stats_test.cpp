@@ -0,0 +1,113 @@
+#include "frame_stats.hpp"
+
+#include <gtest/gtest.h>
+
+using std::chrono::milliseconds;
+
+TEST(FrameStatsTest, EmptyStagesReportNothing) {
+    FrameStats stats;
+    const auto summary = stats.summary(FrameStage::Render);
+    EXPECT_EQ(summary.samples, 0u);
+    EXPECT_EQ(summary.p99_ms, 0.0);
+}
+
+TEST(FrameStatsTest, NearestRankPercentiles) {
+    FrameStats stats;
+    // 1..100 ms in shuffled order.
+    for (int i = 0; i < 100; ++i) {
+        stats.record(FrameStage::Render, milliseconds((i * 37) % 100 + 1));
+    }
+    const auto summary = stats.summary(FrameStage::Render);
+    EXPECT_EQ(summary.samples, 100u);
+    EXPECT_DOUBLE_EQ(summary.p50_ms, 50.0);
+    EXPECT_DOUBLE_EQ(summary.p95_ms, 95.0);
+    EXPECT_DOUBLE_EQ(summary.p99_ms, 99.0);
+    EXPECT_DOUBLE_EQ(summary.max_ms, 100.0);
+}
+
+TEST(FrameStatsTest, WindowKeepsOnlyRecentSamples) {
+    FrameStats stats(4);
+    for (int i = 0; i < 4; ++i) {
+        stats.record(FrameStage::Readback, milliseconds(100));
+    }
+    for (int i = 0; i < 4; ++i) {
+        stats.record(FrameStage::Readback, milliseconds(2));
+    }
+    const auto summary = stats.summary(FrameStage::Readback);
+    EXPECT_EQ(summary.samples, 4u);
+    EXPECT_DOUBLE_EQ(summary.max_ms, 2.0);
+}
+
+TEST(FrameStatsTest, EndFrameSumsTheStages) {
+    FrameStats stats;
+    stats.record(FrameStage::RunLoop, milliseconds(3));
+    stats.record(FrameStage::Render, milliseconds(5));
+    stats.record(FrameStage::Convert, milliseconds(2));
+    stats.end_frame();
+    stats.record(FrameStage::RunLoop, milliseconds(1));
+    stats.end_frame();
+
+    const auto frame = stats.summary(FrameStage::Frame);
+    EXPECT_EQ(frame.samples, 2u);
+    EXPECT_DOUBLE_EQ(frame.max_ms, 10.0);
+    EXPECT_DOUBLE_EQ(frame.p50_ms, 1.0);
+    // Stages keep their own samples.
+    EXPECT_EQ(stats.summary(FrameStage::RunLoop).samples, 2u);
+}
+
+TEST(FrameStatsTest, TimerRecordsItsScope) {
+    FrameStats stats;
+    {
+        auto timer = stats.time(FrameStage::Upload);
+    }
+    EXPECT_EQ(stats.summary(FrameStage::Upload).samples, 1u);
+
+    stats.reset();
+    EXPECT_EQ(stats.summary(FrameStage::Upload).samples, 0u);
+}
+
+TEST(FrameStatsTest, CopiedBytesAccumulateUntilReset) {
+    FrameStats stats;
+    stats.add_copied_bytes(4 * 256 * 256);
+    stats.add_copied_bytes(4 * 256 * 256);
+    EXPECT_EQ(stats.copied_bytes(), 2u * 4 * 256 * 256);
+
+    stats.reset();
+    EXPECT_EQ(stats.copied_bytes(), 0u);
+}
+
+TEST(FrameStatsTest, AllocationsAreBookedPerStageAndFrame) {
+    FrameStats stats;
+    stats.record(FrameStage::Render, milliseconds(1), {3, 300});
+    stats.record(FrameStage::Readback, milliseconds(1), {1, 1024});
+    stats.end_frame();
+    stats.record(FrameStage::RunLoop, milliseconds(1));
+    stats.end_frame();
+
+    EXPECT_EQ(stats.allocations(FrameStage::Render).allocations, 3u);
+    EXPECT_EQ(stats.allocations(FrameStage::Readback).bytes, 1024u);
+    EXPECT_EQ(stats.allocations(FrameStage::Frame).allocations, 4u);
+    EXPECT_EQ(stats.allocations(FrameStage::Frame).bytes, 1324u);
+    EXPECT_EQ(stats.frames(), 2u);
+    EXPECT_EQ(stats.allocating_frames(), 1u);
+
+    stats.reset();
+    EXPECT_EQ(stats.allocations(FrameStage::Frame).allocations, 0u);
+    EXPECT_EQ(stats.frames(), 0u);
+    EXPECT_EQ(stats.allocating_frames(), 0u);
+}
+
+TEST(FrameStatsTest, TimerCountsThisThreadsAllocations) {
+    FrameStats stats;
+    // Stands in for the replacement operator new, which is not linked here.
+    alloc_counter::note(64);
+    {
+        auto timer = stats.time(FrameStage::Convert);
+        alloc_counter::note(16);
+        alloc_counter::note(32);
+    }
+    const auto convert = stats.allocations(FrameStage::Convert);
+    EXPECT_EQ(convert.allocations, 2u);
+    EXPECT_EQ(convert.bytes, 48u);
+    EXPECT_EQ(stats.allocations(FrameStage::Upload).allocations, 0u);
+}
@@ -0,0 +1,83 @@
+#include "input_coalescer.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Point {
+    double x, y;
+};
+
+// Applies a gesture the way mbgl's moveBy/scaleBy transform screen points.
+Point apply(const InputCoalescer::Gesture& g, Point p) {
+    if (g.is_scale) {
+        return {g.x + g.scale * (p.x - g.x), g.y + g.scale * (p.y - g.y)};
+    }
+    return {p.x + g.x, p.y + g.y};
+}
+
+}  // namespace
+
+TEST(InputCoalescerTest, EmptyUntilInput) {
+    InputCoalescer input;
+    EXPECT_TRUE(input.empty());
+    EXPECT_FALSE(input.take().has_value());
+}
+
+TEST(InputCoalescerTest, PansSumIntoOneMove) {
+    InputCoalescer input;
+    input.pan(3.0, -1.0);
+    input.pan(2.0, 4.0);
+    auto gesture = input.take();
+    ASSERT_TRUE(gesture.has_value());
+    EXPECT_FALSE(gesture->is_scale);
+    EXPECT_DOUBLE_EQ(gesture->x, 5.0);
+    EXPECT_DOUBLE_EQ(gesture->y, 3.0);
+    EXPECT_TRUE(input.empty());
+}
+
+TEST(InputCoalescerTest, WheelNotchesMultiply) {
+    InputCoalescer input;
+    input.zoom(1.2, 100.0, 50.0);
+    input.zoom(1.2, 100.0, 50.0);
+    auto gesture = input.take();
+    ASSERT_TRUE(gesture.has_value());
+    ASSERT_TRUE(gesture->is_scale);
+    EXPECT_NEAR(gesture->scale, 1.44, 1e-12);
+    EXPECT_NEAR(gesture->x, 100.0, 1e-9);
+    EXPECT_NEAR(gesture->y, 50.0, 1e-9);
+}
+
+TEST(InputCoalescerTest, CancellingZoomBecomesMove) {
+    InputCoalescer input;
+    input.zoom(1.2, 10.0, 10.0);
+    input.zoom(1.0 / 1.2, 10.0, 10.0);
+    auto gesture = input.take();
+    ASSERT_TRUE(gesture.has_value());
+    EXPECT_FALSE(gesture->is_scale);
+    EXPECT_NEAR(gesture->x, 0.0, 1e-9);
+    EXPECT_NEAR(gesture->y, 0.0, 1e-9);
+}
+
+TEST(InputCoalescerTest, MixedInputMatchesSequentialApplication) {
+    // Pan, zoom at one point, pan again, zoom out at another: the single
+    // coalesced gesture must move every screen point to the same place as
+    // applying each event in turn.
+    InputCoalescer input;
+    input.pan(12.0, -7.0);
+    input.zoom(1.2, 300.0, 200.0);
+    input.pan(-4.0, 9.0);
+    input.zoom(1.0 / 1.5, 50.0, 400.0);
+    auto gesture = input.take();
+    ASSERT_TRUE(gesture.has_value());
+
+    for (Point p : {Point{0, 0}, Point{640, 480}, Point{123, 45}}) {
+        Point q{p.x + 12.0, p.y - 7.0};
+        q = {300.0 + 1.2 * (q.x - 300.0), 200.0 + 1.2 * (q.y - 200.0)};
+        q = {q.x - 4.0, q.y + 9.0};
+        q = {50.0 + (q.x - 50.0) / 1.5, 400.0 + (q.y - 400.0) / 1.5};
+        const Point r = apply(*gesture, p);
+        EXPECT_NEAR(r.x, q.x, 1e-9);
+        EXPECT_NEAR(r.y, q.y, 1e-9);
+    }
+}
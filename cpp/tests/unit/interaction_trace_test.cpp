@@ -0,0 +1,168 @@
+#include "interaction_trace.hpp"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using Kind = TraceEvent::Kind;
+using std::chrono::microseconds;
+
+namespace {
+
+std::string encode(const std::vector<TraceEvent>& events) {
+    std::string data(kTraceMagic, sizeof(kTraceMagic));
+    data += static_cast<char>(kTraceVersion);
+    microseconds previous{0};
+    for (const auto& event : events) {
+        encode_trace_event(data, event, previous);
+        previous = event.time;
+    }
+    return data;
+}
+
+TraceEvent at(TraceEvent event, long long us) {
+    event.time = microseconds(us);
+    return event;
+}
+
+// Stands in for SlintMapLibre and writes down what it was asked to do.
+struct FakeMap {
+    std::vector<std::string> calls;
+
+    void handle_mouse_press(float x, float y) {
+        calls.push_back("press " + std::to_string(int(x)) + "," +
+                        std::to_string(int(y)));
+    }
+    void handle_mouse_release(float, float) {
+        calls.push_back("release");
+    }
+    void handle_mouse_move(float, float, bool pressed) {
+        calls.push_back(pressed ? "drag" : "hover");
+    }
+    void handle_wheel_zoom(float, float, float dy) {
+        calls.push_back(dy < 0 ? "wheel in" : "wheel out");
+    }
+    void handle_double_click(float, float, bool shift) {
+        calls.push_back(shift ? "double shift" : "double");
+    }
+    void fly_to(double, double, double zoom) {
+        calls.push_back("fly " + std::to_string(int(zoom)));
+    }
+    void setStyleUrl(const std::string& url) {
+        calls.push_back("style " + url);
+    }
+    void set_pitch(int value) {
+        calls.push_back("pitch " + std::to_string(value));
+    }
+    void set_bearing(float value) {
+        calls.push_back("bearing " + std::to_string(int(value)));
+    }
+    void resize(int w, int h) {
+        calls.push_back("resize " + std::to_string(w) + "x" +
+                        std::to_string(h));
+    }
+};
+
+}  // namespace
+
+TEST(InteractionTraceTest, RoundTripsEveryKind) {
+    const std::vector<TraceEvent> events = {
+        at({Kind::Resize, {800, 600}}, 0),
+        at({Kind::InitialState,
+            {35.68f, 139.76f, 10.5f, -20.0f, 45.0f},
+            false,
+            "https://example.com/start.json"},
+           10),
+        at({Kind::MousePress, {10.5f, 20.25f}}, 1000),
+        at({Kind::MouseMove, {11.0f, 21.0f}}, 17000),
+        at({Kind::MouseRelease, {12.0f, 22.0f}}, 33000),
+        at({Kind::WheelZoom, {400, 300, -1.0f}}, 2000000),
+        at({Kind::DoubleClick, {5, 6}, true}, 2500000),
+        at({Kind::FlyTo, {35.68f, 139.76f, 11.0f}}, 3000000),
+        at({Kind::StyleChange, {}, false, "https://example.com/style.json"},
+           3000001),
+        at({Kind::PitchChange, {30.0f}}, 4000000),
+        at({Kind::BearingChange, {-45.0f}}, 4000000),
+    };
+    const auto decoded = decode_trace(encode(events));
+    ASSERT_EQ(decoded.size(), events.size());
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        EXPECT_EQ(decoded[i].kind, events[i].kind) << i;
+        EXPECT_EQ(decoded[i].time, events[i].time) << i;
+        EXPECT_EQ(decoded[i].flag, events[i].flag) << i;
+        EXPECT_EQ(decoded[i].text, events[i].text) << i;
+        for (std::size_t a = 0; a < trace_arg_count(events[i].kind); ++a) {
+            EXPECT_EQ(decoded[i].args[a], events[i].args[a]) << i;
+        }
+    }
+}
+
+TEST(InteractionTraceTest, PointerEventsAreCompact) {
+    const std::string header = encode({});
+    const std::string one = encode({at({Kind::MouseMove, {1, 2}}, 16000)});
+    EXPECT_LE(one.size() - header.size(), 11u);
+}
+
+TEST(InteractionTraceTest, RejectsForeignAndDamagedFiles) {
+    EXPECT_THROW(decode_trace("not a trace at all"), std::runtime_error);
+
+    std::string wrong_version = encode({});
+    wrong_version.back() = static_cast<char>(kTraceVersion + 1);
+    EXPECT_THROW(decode_trace(wrong_version), std::runtime_error);
+
+    const std::string full = encode({at({Kind::WheelZoom, {1, 2, 3}}, 5)});
+    EXPECT_THROW(decode_trace(full.substr(0, full.size() - 1)),
+                 std::runtime_error);
+
+    std::string unknown = encode({});
+    unknown += '\0';
+    unknown += static_cast<char>(0x7f);
+    EXPECT_THROW(decode_trace(unknown), std::runtime_error);
+}
+
+TEST(InteractionTraceTest, RecorderWritesAReadableFile) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "interaction_trace_test.smltrace";
+    {
+        TraceRecorder recorder(path.string());
+        recorder.record({Kind::MousePress, {1, 2}});
+        recorder.record({Kind::MouseRelease, {3, 4}});
+    }
+    const auto events = read_trace(path.string());
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].kind, Kind::MousePress);
+    EXPECT_EQ(events[1].kind, Kind::MouseRelease);
+    EXPECT_LE(events[0].time, events[1].time);
+    std::filesystem::remove(path);
+}
+
+TEST(InteractionTraceTest, AppliesEventsLikeTheApplication) {
+    FakeMap map;
+    for (const auto& event : std::vector<TraceEvent>{
+             {Kind::MousePress, {10, 20}},
+             {Kind::MouseMove, {11, 21}},
+             {Kind::MouseRelease, {11, 21}},
+             {Kind::WheelZoom, {0, 0, -1}},
+             {Kind::DoubleClick, {0, 0}, true},
+             {Kind::FlyTo, {35, 139, 11}},
+             {Kind::StyleChange, {}, false, "file:///style.json"},
+             {Kind::PitchChange, {30}},
+             {Kind::BearingChange, {90}},
+             {Kind::Resize, {640, 480}},
+             {Kind::InitialState, {1, 2, 3, 4, 5}, false, "file:///a.json"},
+         }) {
+        apply_trace_event(map, event);
+    }
+    // Pitch and bearing arrive in degrees and are handed on as the 0..100
+    // slider values the map takes. The initial state is the replayer's to
+    // restore.
+    const std::vector<std::string> expected = {
+        "press 10,20", "drag",     "release",
+        "wheel in",    "double shift",
+        "fly 11",      "style file:///style.json",
+        "pitch 50",    "bearing 25",
+        "resize 640x480",
+    };
+    EXPECT_EQ(map.calls, expected);
+}
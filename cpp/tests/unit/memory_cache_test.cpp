@@ -0,0 +1,65 @@
+#include "memory_cache.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+
+mbgl::CacheEntry make_entry(std::size_t size) {
+    mbgl::CacheEntry entry;
+    entry.data = std::make_shared<const std::string>(size, 'x');
+    return entry;
+}
+
+}  // namespace
+
+TEST(MemoryCacheTest, HitsShareTheBody) {
+    mbgl::MemoryCache cache(1 << 20);
+    EXPECT_FALSE(cache.get("https://example.com/a").has_value());
+
+    auto entry = make_entry(100);
+    const auto* body = entry.data.get();
+    cache.put("https://example.com/a", entry);
+
+    auto hit = cache.get("https://example.com/a");
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->data.get(), body);
+
+    const auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_GE(stats.bytes, 100u);
+}
+
+TEST(MemoryCacheTest, ReplacingKeepsOneEntry) {
+    mbgl::MemoryCache cache(1 << 20);
+    cache.put("https://example.com/a", make_entry(100));
+    cache.put("https://example.com/a", make_entry(50));
+    EXPECT_EQ(cache.get("https://example.com/a")->data->size(), 50u);
+    EXPECT_EQ(cache.stats().entries, 1u);
+}
+
+TEST(MemoryCacheTest, EvictsLeastRecentlyUsedWithinBudget) {
+    // One shard so the LRU order is global.
+    mbgl::MemoryCache cache(4096, 1);
+    cache.put("https://example.com/1", make_entry(1000));
+    cache.put("https://example.com/2", make_entry(1000));
+    cache.put("https://example.com/3", make_entry(1000));
+    EXPECT_TRUE(cache.get("https://example.com/1").has_value());
+    cache.put("https://example.com/4", make_entry(1000));
+
+    const auto stats = cache.stats();
+    EXPECT_LE(stats.bytes, 4096u);
+    EXPECT_GE(stats.evictions, 1u);
+    EXPECT_TRUE(cache.get("https://example.com/1").has_value());
+    EXPECT_FALSE(cache.get("https://example.com/2").has_value());
+    EXPECT_TRUE(cache.get("https://example.com/4").has_value());
+}
+
+TEST(MemoryCacheTest, SkipsEntriesLargerThanBudget) {
+    mbgl::MemoryCache cache(1024, 1);
+    cache.put("https://example.com/big", make_entry(4096));
+    EXPECT_FALSE(cache.get("https://example.com/big").has_value());
+    EXPECT_EQ(cache.stats().bytes, 0u);
+}
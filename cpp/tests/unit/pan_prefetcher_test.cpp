@@ -0,0 +1,99 @@
+#include "pan_prefetcher.hpp"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// Drags the content left (camera heading east) at 1200 px/s in 16 ms steps.
+PanPrefetcher::Clock::time_point drag_east(PanPrefetcher& prefetcher,
+                                           double bearing = 0.0) {
+    auto now = PanPrefetcher::Clock::now();
+    for (int i = 0; i < 10; ++i) {
+        now += 16ms;
+        prefetcher.add_pan(-19.2, 0.0, bearing, now);
+    }
+    return now;
+}
+
+}  // namespace
+
+TEST(PanPrefetcherTest, IdleOrSlowDragsPlanNothing) {
+    PanPrefetcher prefetcher;
+    const auto now = PanPrefetcher::Clock::now();
+    EXPECT_TRUE(prefetcher.plan({0.5, 0.5}, 10.0, 800, 600, now).empty());
+
+    auto t = now;
+    for (int i = 0; i < 10; ++i) {
+        t += 16ms;
+        prefetcher.add_pan(-0.5, 0.0, 0.0, t);
+    }
+    EXPECT_LT(prefetcher.speed(), 100.0);
+    EXPECT_TRUE(prefetcher.plan({0.5, 0.5}, 10.0, 800, 600, t).empty());
+}
+
+TEST(PanPrefetcherTest, PlansTilesAheadOfTheMotion) {
+    PanPrefetcher prefetcher;
+    const auto now = drag_east(prefetcher);
+    EXPECT_NEAR(prefetcher.speed(), 1200.0, 1.0);
+
+    const MercatorPoint center{0.5003, 0.5003};
+    const auto tiles = prefetcher.plan(center, 10.0, 800, 600, now);
+    ASSERT_FALSE(tiles.empty());
+    EXPECT_LE(tiles.size(), 16u);
+
+    const auto visible = tile_cover(center, 10.0, 800, 600, 10);
+    std::uint32_t max_visible_x = 0;
+    for (const auto& tile : visible) {
+        max_visible_x = std::max(max_visible_x, tile.x);
+    }
+    for (const auto& tile : tiles) {
+        EXPECT_EQ(tile.z, 10);
+        EXPECT_GT(tile.x, max_visible_x) << "tile is not east of the view";
+    }
+}
+
+TEST(PanPrefetcherTest, BearingRotatesTheDirection) {
+    // With the map rotated by 90 degrees, screen-right is south.
+    PanPrefetcher prefetcher;
+    const auto now = drag_east(prefetcher, 90.0);
+    const MercatorPoint center{0.5003, 0.5003};
+    const auto tiles = prefetcher.plan(center, 10.0, 600, 600, now);
+    ASSERT_FALSE(tiles.empty());
+    const auto visible = tile_cover(center, 10.0, 600, 600, 10);
+    std::uint32_t max_visible_y = 0;
+    for (const auto& tile : visible) {
+        max_visible_y = std::max(max_visible_y, tile.y);
+    }
+    for (const auto& tile : tiles) {
+        EXPECT_GT(tile.y, max_visible_y);
+    }
+}
+
+TEST(PanPrefetcherTest, ThrottlesAndRespectsBudget) {
+    PanPrefetcher::Options options;
+    options.budget = 1;
+    PanPrefetcher prefetcher(options);
+    auto now = drag_east(prefetcher);
+    const MercatorPoint center{0.5, 0.5};
+    EXPECT_EQ(prefetcher.plan(center, 10.0, 800, 600, now).size(), 1u);
+
+    now += 16ms;
+    prefetcher.add_pan(-19.2, 0.0, 0.0, now);
+    EXPECT_TRUE(prefetcher.plan(center, 10.0, 800, 600, now).empty());
+
+    prefetcher.set_budget(0);
+    now += 200ms;
+    prefetcher.add_pan(-19.2, 0.0, 0.0, now);
+    EXPECT_TRUE(prefetcher.plan(center, 10.0, 800, 600, now).empty());
+}
+
+TEST(PanPrefetcherTest, ResetForgetsTheDrag) {
+    PanPrefetcher prefetcher;
+    const auto now = drag_east(prefetcher);
+    prefetcher.reset();
+    EXPECT_EQ(prefetcher.speed(), 0.0);
+    EXPECT_TRUE(prefetcher.plan({0.5, 0.5}, 10.0, 800, 600, now).empty());
+}
@@ -0,0 +1,86 @@
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using slint_maplibre::PixelKernel;
+
+namespace {
+
+// Every (channel, alpha) combination, followed by random pixels so the
+// vector loops see mixed, opaque and transparent blocks.
+std::vector<uint8_t> make_pixels() {
+    std::vector<uint8_t> pixels;
+    for (int a = 0; a < 256; ++a) {
+        for (int c = 0; c < 256; ++c) {
+            pixels.insert(pixels.end(), {static_cast<uint8_t>(c),
+                                         static_cast<uint8_t>(255 - c),
+                                         static_cast<uint8_t>(c / 2),
+                                         static_cast<uint8_t>(a)});
+        }
+    }
+    std::mt19937 rng(42);
+    for (int i = 0; i < 1027; ++i) {
+        const auto a = static_cast<uint8_t>(rng() % 3 == 0 ? 255 : rng());
+        pixels.insert(pixels.end(), {static_cast<uint8_t>(rng() % (a + 1)),
+                                     static_cast<uint8_t>(rng() % (a + 1)),
+                                     static_cast<uint8_t>(rng() % (a + 1)), a});
+    }
+    pixels.insert(pixels.end(), 64 * 4, 255);
+    return pixels;
+}
+
+}  // namespace
+
+TEST(PixelConvertTest, ScalarMatchesMbglRounding) {
+    const auto src = make_pixels();
+    std::vector<uint8_t> dst(src.size());
+    slint_maplibre::unpremultiply_rgba8(PixelKernel::Scalar, src.data(),
+                                        dst.data(), src.size() / 4);
+
+    for (std::size_t i = 0; i < src.size(); i += 4) {
+        const int a = src[i + 3];
+        for (std::size_t k = 0; k < 3; ++k) {
+            const int c = src[i + k];
+            const int expected = (a == 0 || a == 255)
+                                     ? c
+                                     : std::min(255, (255 * c + a / 2) / a);
+            ASSERT_EQ(dst[i + k], expected) << "c=" << c << " a=" << a;
+        }
+        ASSERT_EQ(dst[i + 3], a);
+    }
+}
+
+TEST(PixelConvertTest, VectorKernelsMatchScalar) {
+    const auto src = make_pixels();
+    const std::size_t count = src.size() / 4;
+    std::vector<uint8_t> expected(src.size());
+    slint_maplibre::unpremultiply_rgba8(PixelKernel::Scalar, src.data(),
+                                        expected.data(), count);
+
+    for (PixelKernel kernel :
+         {PixelKernel::Sse41, PixelKernel::Avx2, PixelKernel::Neon}) {
+        if (!slint_maplibre::pixel_kernel_supported(kernel)) {
+            continue;
+        }
+        // Offsets exercise unaligned starts and every tail length.
+        for (std::size_t offset = 0; offset < 17; ++offset) {
+            std::vector<uint8_t> dst(src.size() - offset * 4);
+            slint_maplibre::unpremultiply_rgba8(kernel, src.data() + offset * 4,
+                                                dst.data(), count - offset);
+            ASSERT_TRUE(std::equal(dst.begin(), dst.end(),
+                                   expected.begin() + offset * 4))
+                << "kernel " << static_cast<int>(kernel) << " offset "
+                << offset;
+        }
+    }
+}
+
+TEST(PixelConvertTest, BestKernelIsSupported) {
+    EXPECT_TRUE(slint_maplibre::pixel_kernel_supported(
+        slint_maplibre::best_pixel_kernel()));
+    EXPECT_TRUE(slint_maplibre::pixel_kernel_supported(PixelKernel::Scalar));
+}
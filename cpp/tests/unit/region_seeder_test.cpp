@@ -0,0 +1,91 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <gtest/gtest.h>
+#include <mbgl/storage/resource_options.hpp>
+#include <mbgl/util/client_options.hpp>
+#include <mbgl/util/run_loop.hpp>
+#include <string>
+#include <thread>
+
+#include "custom_file_source.hpp"
+#include "local_http_server.hpp"
+#include "region_seeder.hpp"
+
+// RegionSeeder against a local server, fetching through the file source the
+// maps install as mbgl's network file source.
+namespace {
+
+using namespace std::chrono_literals;
+
+bool wait_for(const std::function<bool()>& done,
+              std::chrono::milliseconds timeout = 10000ms) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    return true;
+}
+
+std::filesystem::path fresh_cache(const std::string& name) {
+    const auto directory = std::filesystem::temp_directory_path();
+    for (const std::string& file : {name + ".sqlite", name + "-http.sqlite"}) {
+        for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::filesystem::remove(directory / (file + suffix));
+        }
+    }
+    return directory / (name + ".sqlite");
+}
+
+}  // namespace
+
+TEST(RegionSeederTest, SeedingFinishesAfterAFailedTile) {
+    // The only tile fails once. mbgl's offline download keeps its request
+    // alive and CustomFileSource retries it, so the region still completes
+    std::atomic<int> tile_requests{0};
+    std::string style;
+    LocalHttpServer::Options options;
+    options.latency = 0ms;
+    options.jitter = 0ms;
+    options.handler = [&](const LocalHttpServer::Request& request) {
+        if (request.path == "/style.json") {
+            return LocalHttpServer::Reply{200, "", style};
+        }
+        if (request.path == "/0/0/0.pbf" && tile_requests++ == 0) {
+            return LocalHttpServer::Reply{500, "", ""};
+        }
+        return LocalHttpServer::Reply{200, "", "tile"};
+    };
+    LocalHttpServer server(options);
+    style = "{\"version\":8,\"sources\":{\"tiles\":{\"type\":\"vector\","
+            "\"tiles\":[\"" +
+            server.base_url() +
+            "/{z}/{x}/{y}.pbf\"],\"maxzoom\":0}},\"layers\":[]}";
+
+    mbgl::util::RunLoop loop;
+    auto file_source = mbgl::CustomFileSource::installDefault();
+    const auto cache = fresh_cache("maplibre-slint-seed-test");
+    mbgl::RegionSeeder seeder(
+        mbgl::ResourceOptions().withCachePath(cache.string()),
+        mbgl::ClientOptions());
+
+    std::atomic<bool> complete{false};
+    mbgl::RegionSeeder::Region region;
+    region.styleUrl = server.base_url() + "/style.json";
+    region.minZoom = 0.0;
+    region.maxZoom = 0.0;
+    seeder.seed(region,
+                [&complete](const mbgl::RegionSeeder::Progress& progress) {
+                    if (progress.complete) {
+                        complete = true;
+                    }
+                });
+
+    ASSERT_TRUE(wait_for([&] { return complete.load(); }));
+    EXPECT_EQ(tile_requests.load(), 2);
+    seeder.cancel();
+}
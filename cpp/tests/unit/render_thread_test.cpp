@@ -0,0 +1,134 @@
+#include "slint_maplibre_render_thread.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "fixture.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+
+TEST(SpscQueueTest, PopsInOrder) {
+    SpscQueue<int, 4> queue;
+    EXPECT_FALSE(queue.try_pop().has_value());
+    EXPECT_TRUE(queue.try_push(1));
+    EXPECT_TRUE(queue.try_push(2));
+    EXPECT_EQ(queue.try_pop(), 1);
+    EXPECT_EQ(queue.try_pop(), 2);
+    EXPECT_FALSE(queue.try_pop().has_value());
+}
+
+TEST(SpscQueueTest, RejectsPushWhenFull) {
+    SpscQueue<std::string, 2> queue;
+    EXPECT_TRUE(queue.try_push("a"));
+    EXPECT_TRUE(queue.try_push("b"));
+    EXPECT_FALSE(queue.try_push("c"));
+    EXPECT_EQ(queue.try_pop(), "a");
+    EXPECT_TRUE(queue.try_push("c"));
+}
+
+TEST(SpscQueueTest, TransfersAcrossThreads) {
+    // Every value arrives exactly once and in order
+    SpscQueue<int, 64> queue;
+    constexpr int count = 100000;
+    std::thread producer([&queue] {
+        for (int i = 0; i < count; ++i) {
+            while (!queue.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    int expected = 0;
+    while (expected < count) {
+        if (auto value = queue.try_pop()) {
+            ASSERT_EQ(*value, expected);
+            ++expected;
+        }
+    }
+    producer.join();
+}
+
+TEST(TripleBufferTest, TakeReturnsNewestOnly) {
+    TripleBuffer<int> buffer;
+    EXPECT_EQ(buffer.take(), nullptr);
+
+    buffer.back() = 1;
+    buffer.publish();
+    buffer.back() = 2;
+    buffer.publish();
+
+    const int* value = buffer.take();
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(*value, 2);
+    EXPECT_EQ(buffer.take(), nullptr);
+}
+
+TEST(TripleBufferTest, ConsumerNeverSeesOlderValue) {
+    TripleBuffer<int> buffer;
+    constexpr int count = 100000;
+    std::thread producer([&buffer] {
+        for (int i = 1; i <= count; ++i) {
+            buffer.back() = i;
+            buffer.publish();
+        }
+    });
+    int last = 0;
+    while (last < count) {
+        if (const int* value = buffer.take()) {
+            ASSERT_GT(*value, last);
+            last = *value;
+        }
+    }
+    producer.join();
+}
+
+TEST(SlintMapLibreRenderThreadTest, StartAndStop) {
+    // Input before initialize() is dropped on the render thread, and
+    // shutting down joins the thread without a frame ever being produced
+    int frames = 0;
+    auto render_thread = std::make_unique<SlintMapLibreRenderThread>(
+        [&frames]() { ++frames; });
+    render_thread->handle_mouse_press(10, 10);
+    render_thread->handle_wheel_zoom(10, 10, -1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(render_thread->take_frame(), nullptr);
+    render_thread.reset();
+    EXPECT_EQ(frames, 0);
+}
+
+TEST(SlintMapLibreRenderThreadTest, FramesReuseTheirBuffers) {
+    // With the UI dropping its image before taking the next frame, as
+    // main.cpp does, frames are written into the triple buffer's three
+    // pixel buffers in place: no copy-on-write reallocation per frame
+    const BenchFixture fixture = write_bench_fixture(
+        std::filesystem::temp_directory_path() / "maplibre-slint-frames");
+    auto render_thread = std::make_unique<SlintMapLibreRenderThread>([] {});
+    render_thread->setStyleUrl(fixture.style_url);
+    render_thread->initialize(256, 256);
+
+    std::set<const slint::Rgba8Pixel*> buffers;
+    slint::Image displayed;
+    int frames = 0;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (frames < 30 && std::chrono::steady_clock::now() < deadline) {
+        // Keep the camera moving so every pass renders a new frame.
+        render_thread->handle_wheel_zoom(128, 128, frames % 2 ? 1.0f : -1.0f);
+        displayed = slint::Image();
+        if (const auto* frame = render_thread->take_frame()) {
+            buffers.insert(std::as_const(frame->pixels).begin());
+            displayed = slint::Image(frame->pixels);
+            ++frames;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    displayed = slint::Image();
+    render_thread.reset();
+
+    EXPECT_EQ(frames, 30);
+    EXPECT_LE(buffers.size(), 3u);
+}
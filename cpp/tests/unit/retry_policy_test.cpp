@@ -0,0 +1,61 @@
+#include "retry_policy.hpp"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using mbgl::Response;
+using mbgl::Timestamp;
+
+namespace {
+
+const Timestamp kNow = mbgl::util::now();
+
+std::optional<mbgl::Duration> retry(Response::Error::Reason reason,
+                                    std::uint32_t failed,
+                                    std::optional<Timestamp> after = {}) {
+    return mbgl::errorRetryTimeout(reason, failed, after, kNow);
+}
+
+}  // namespace
+
+TEST(RetryPolicyTest, ServerErrorsRetryEverySecondThenBackOff) {
+    EXPECT_EQ(retry(Response::Error::Reason::Server, 1), 1s);
+    EXPECT_EQ(retry(Response::Error::Reason::Server, 3), 1s);
+    EXPECT_EQ(retry(Response::Error::Reason::Server, 4), 2s);
+    EXPECT_EQ(retry(Response::Error::Reason::Server, 6), 8s);
+}
+
+TEST(RetryPolicyTest, ConnectionErrorsBackOffExponentially) {
+    EXPECT_EQ(retry(Response::Error::Reason::Connection, 1), 1s);
+    EXPECT_EQ(retry(Response::Error::Reason::Connection, 2), 2s);
+    EXPECT_EQ(retry(Response::Error::Reason::Connection, 5), 16s);
+    // Capped instead of overflowing.
+    EXPECT_EQ(retry(Response::Error::Reason::Connection, 100),
+              std::chrono::seconds(std::int64_t{1} << 31));
+}
+
+TEST(RetryPolicyTest, RateLimitWaitsForRetryAfter) {
+    EXPECT_EQ(retry(Response::Error::Reason::RateLimit, 1, kNow + 30s), 30s);
+    EXPECT_EQ(retry(Response::Error::Reason::RateLimit, 1), 5s);
+    // A hint in the past means right away.
+    EXPECT_EQ(retry(Response::Error::Reason::RateLimit, 1, kNow - 30s),
+              mbgl::Duration::zero());
+}
+
+TEST(RetryPolicyTest, FinalErrorsAreNotRetried) {
+    EXPECT_FALSE(retry(Response::Error::Reason::NotFound, 1));
+    EXPECT_FALSE(retry(Response::Error::Reason::Other, 1));
+    EXPECT_FALSE(retry(Response::Error::Reason::Success, 0));
+}
+
+TEST(RetryPolicyTest, ExpiringResponsesAreRefreshedWhenTheyExpire) {
+    EXPECT_EQ(mbgl::expirationTimeout(kNow + 60s, 0, kNow), 60s);
+    EXPECT_FALSE(mbgl::expirationTimeout(std::nullopt, 0, kNow));
+}
+
+TEST(RetryPolicyTest, ExpiredResponsesBackOff) {
+    // The server keeps sending stale data; don't ask again right away.
+    EXPECT_EQ(mbgl::expirationTimeout(kNow - 60s, 1, kNow), 1s);
+    EXPECT_EQ(mbgl::expirationTimeout(kNow - 60s, 4, kNow), 8s);
+}
@@ -1,6 +1,7 @@
 #include "slint_maplibre_headless.hpp"
 
 #include <gtest/gtest.h>
+#include <optional>
 #include <thread>
 
 class SlintMapLibreTest : public ::testing::Test {
@@ -151,6 +152,15 @@ TEST_F(SlintMapLibreTest, SetStyleUrl) {
         slint_map->setStyleUrl("https://demotiles.maplibre.org/style.json"));
 }
 
+TEST_F(SlintMapLibreTest, SetStyleUrlBeforeInitialize) {
+    // The URL is kept and loaded by initialize() instead of the demo style
+    const std::string url = "file:///nonexistent/bench/style.json";
+    slint_map->setStyleUrl(url);
+    slint_map->initialize(800, 600);
+    ASSERT_NE(slint_map->get_map(), nullptr);
+    EXPECT_EQ(slint_map->get_map()->getStyle().getURL(), url);
+}
+
 TEST_F(SlintMapLibreTest, FlyToLocation) {
     // Test fly-to animation with location name
     slint_map->initialize(800, 600);
@@ -174,6 +184,29 @@ TEST_F(SlintMapLibreTest, RunMapLoop) {
     }
 }
 
+TEST_F(SlintMapLibreTest, RunMapLoopReportsBusyWhileLoading) {
+    // Without a map there is nothing to tick for
+    EXPECT_FALSE(slint_map->run_map_loop());
+
+    // The style is still loading right after initialization
+    slint_map->initialize(800, 600);
+    EXPECT_TRUE(slint_map->run_map_loop());
+}
+
+TEST_F(SlintMapLibreTest, WakeCallbackAfterPause) {
+    int wakes = 0;
+    slint_map->set_wake_callback([&wakes]() { ++wakes; });
+
+    // Nothing to do, so the tick pauses; initializing wakes it exactly once
+    EXPECT_FALSE(slint_map->run_map_loop());
+    slint_map->initialize(800, 600);
+    EXPECT_EQ(wakes, 1);
+
+    // Input while already awake does not wake again
+    slint_map->handle_wheel_zoom(400, 300, -1);
+    EXPECT_EQ(wakes, 1);
+}
+
 TEST_F(SlintMapLibreTest, TickAnimation) {
     // Test animation tick
     slint_map->initialize(800, 600);
@@ -192,12 +225,11 @@ TEST_F(SlintMapLibreTest, RepaintRequest) {
     EXPECT_FALSE(repaint_needed);
 }
 
-TEST_F(SlintMapLibreTest, ForcedRepaintArm) {
-    // Test forced repaint mechanism
+TEST_F(SlintMapLibreTest, NoRepaintUntilFrameRendered) {
+    // Nothing has been rendered yet, so there is no frame to read back
+    EXPECT_FALSE(slint_map->take_repaint_request());
     slint_map->initialize(800, 600);
-    slint_map->arm_forced_repaint_ms(100);
-    bool forced = slint_map->consume_forced_repaint();
-    EXPECT_TRUE(forced);
+    EXPECT_FALSE(slint_map->take_repaint_request());
 }
 
 TEST_F(SlintMapLibreTest, RenderMap) {
@@ -216,6 +248,14 @@ TEST_F(SlintMapLibreTest, RenderMapMultipleTimes) {
     }
 }
 
+TEST_F(SlintMapLibreTest, ReadFrameIntoWithoutMap) {
+    // Nothing is rendered before initialize(); the target stays untouched
+    slint::SharedPixelBuffer<slint::Rgba8Pixel> buffer(4, 4);
+    EXPECT_FALSE(slint_map->read_frame_into(buffer));
+    EXPECT_EQ(buffer.width(), 4u);
+    EXPECT_EQ(buffer.height(), 4u);
+}
+
 TEST_F(SlintMapLibreTest, SetRenderCallback) {
     // Test setting a render callback
     slint_map->initialize(800, 600);
@@ -279,3 +319,24 @@ TEST_F(SlintMapLibreTest, ExtremeBearingValues) {
     EXPECT_NO_THROW(slint_map->set_bearing(720.0f));   // Double rotation
     EXPECT_NO_THROW(slint_map->set_bearing(-360.0f));  // Negative full rotation
 }
+
+TEST_F(SlintMapLibreTest, EstimateRegionBeforeInitializeDoesNothing) {
+    bool called = false;
+    slint_map->estimate_region(
+        mbgl::LatLngBounds::hull({48.8, 2.2}, {48.9, 2.4}), 10.0, 12.0,
+        [&](const mbgl::RegionSeeder::Estimate&) { called = true; });
+    EXPECT_FALSE(called);
+    EXPECT_NO_THROW(slint_map->cancel_seeding());
+}
+
+TEST_F(SlintMapLibreTest, EstimateRegionCountsTilesOfTheZoomRange) {
+    slint_map->initialize(800, 600);
+    std::optional<mbgl::RegionSeeder::Estimate> estimate;
+    slint_map->estimate_region(
+        mbgl::LatLngBounds::hull({48.8, 2.2}, {48.9, 2.4}), 10.0, 12.0,
+        [&](const mbgl::RegionSeeder::Estimate& e) { estimate = e; });
+    ASSERT_TRUE(estimate.has_value());
+    // At least one tile per zoom level for every tile source.
+    EXPECT_GE(estimate->tiles, 3u);
+    EXPECT_GT(estimate->bytes, 0u);
+}
@@ -0,0 +1,214 @@
+#include "tile_archive.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+std::filesystem::path temp_archive(const char* name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string("maplibre-slint-") + name);
+    std::filesystem::remove(path);
+    return path;
+}
+
+std::string gzip(const std::string& data) {
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                 Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, data.size()) + 32, '\0');
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+void put_varint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+template <typename T>
+void put_le(std::string& header, std::size_t offset, T value) {
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        header[offset + i] = static_cast<char>(
+            (static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff);
+    }
+}
+
+// A PMTiles v3 archive with gzip-compressed tiles at 0/0/0 and 1/1/0 and an
+// uncompressed root directory.
+void write_pmtiles(const std::filesystem::path& path) {
+    const std::string tile0 = gzip("tile 0/0/0");
+    const std::string tile1 = gzip("tile 1/1/0");
+    const std::string metadata = R"({"name":"test","vector_layers":[]})";
+
+    struct Entry {
+        std::uint64_t id;
+        std::uint64_t length;
+    };
+    const std::vector<Entry> entries = {
+        {mbgl::pmtilesTileId(0, 0, 0), tile0.size()},
+        {mbgl::pmtilesTileId(1, 1, 0), tile1.size()}};
+    std::string directory;
+    put_varint(directory, entries.size());
+    std::uint64_t last = 0;
+    for (const auto& e : entries) {
+        put_varint(directory, e.id - last);
+        last = e.id;
+    }
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        put_varint(directory, 1);  // run length
+    }
+    for (const auto& e : entries) {
+        put_varint(directory, e.length);
+    }
+    put_varint(directory, 1);  // first offset 0, stored as offset + 1
+    put_varint(directory, 0);  // directly after the previous tile
+
+    std::string header(127, '\0');
+    std::memcpy(header.data(), "PMTiles", 7);
+    header[7] = 3;
+    const std::uint64_t rootOffset = header.size();
+    const std::uint64_t metadataOffset = rootOffset + directory.size();
+    const std::uint64_t dataOffset = metadataOffset + metadata.size();
+    put_le<std::uint64_t>(header, 8, rootOffset);
+    put_le<std::uint64_t>(header, 16, directory.size());
+    put_le<std::uint64_t>(header, 24, metadataOffset);
+    put_le<std::uint64_t>(header, 32, metadata.size());
+    put_le<std::uint64_t>(header, 40, dataOffset);  // no leaves
+    put_le<std::uint64_t>(header, 48, 0);
+    put_le<std::uint64_t>(header, 56, dataOffset);
+    put_le<std::uint64_t>(header, 64, tile0.size() + tile1.size());
+    header[97] = 1;  // directories uncompressed
+    header[98] = 2;  // tiles gzip
+    header[99] = 1;  // MVT
+    header[100] = 0;
+    header[101] = 1;
+    put_le<std::int32_t>(header, 102, -1800000000);
+    put_le<std::int32_t>(header, 106, -850000000);
+    put_le<std::int32_t>(header, 110, 1800000000);
+    put_le<std::int32_t>(header, 114, 850000000);
+
+    std::ofstream file(path, std::ios::binary);
+    file << header << directory << metadata << tile0 << tile1;
+}
+
+void write_mbtiles(const std::filesystem::path& path) {
+    sqlite3* db = nullptr;
+    ASSERT_EQ(sqlite3_open(path.string().c_str(), &db), SQLITE_OK);
+    ASSERT_EQ(
+        sqlite3_exec(
+            db,
+            "CREATE TABLE metadata (name TEXT, value TEXT);"
+            "CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER,"
+            " tile_row INTEGER, tile_data BLOB);"
+            "INSERT INTO metadata VALUES ('minzoom', '1'), ('maxzoom', '1'),"
+            " ('name', 'Offline \"test\"'),"
+            " ('json', '{\"vector_layers\":[{\"id\":\"water\"}]}');",
+            nullptr, nullptr, nullptr),
+        SQLITE_OK);
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db, "INSERT INTO tiles VALUES (1, 0, 1, ?1)", -1,
+                       &stmt, nullptr);
+    const std::string tile = gzip("tile 1/0/0");
+    sqlite3_bind_blob(stmt, 1, tile.data(), static_cast<int>(tile.size()),
+                      SQLITE_TRANSIENT);
+    ASSERT_EQ(sqlite3_step(stmt), SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+mbgl::Resource tile_resource(const std::string& url) {
+    return mbgl::Resource(mbgl::Resource::Kind::Tile, url);
+}
+
+}  // namespace
+
+TEST(TileArchiveTest, PMTilesTileIds) {
+    // Values from the PMTiles v3 specification.
+    EXPECT_EQ(mbgl::pmtilesTileId(0, 0, 0), 0u);
+    EXPECT_EQ(mbgl::pmtilesTileId(1, 0, 0), 1u);
+    EXPECT_EQ(mbgl::pmtilesTileId(1, 0, 1), 2u);
+    EXPECT_EQ(mbgl::pmtilesTileId(1, 1, 1), 3u);
+    EXPECT_EQ(mbgl::pmtilesTileId(1, 1, 0), 4u);
+    EXPECT_EQ(mbgl::pmtilesTileId(2, 0, 0), 5u);
+    EXPECT_EQ(mbgl::pmtilesTileId(12, 3423, 1763), 19078479u);
+}
+
+TEST(TileArchiveTest, RecognizesArchiveUrls) {
+    EXPECT_TRUE(mbgl::TileArchives::isArchiveUrl("mbtiles:///a.mbtiles"));
+    EXPECT_TRUE(mbgl::TileArchives::isArchiveUrl("pmtiles:///a.pmtiles"));
+    EXPECT_FALSE(mbgl::TileArchives::isArchiveUrl("https://a/b.pmtiles"));
+}
+
+TEST(TileArchiveTest, ServesPMTiles) {
+    const auto path = temp_archive("test.pmtiles");
+    write_pmtiles(path);
+    const std::string url = "pmtiles://" + path.string();
+    mbgl::TileArchives archives;
+
+    auto tileJSON = archives.fetch(
+        mbgl::Resource(mbgl::Resource::Kind::Source, url));
+    ASSERT_FALSE(tileJSON.error);
+    ASSERT_TRUE(tileJSON.data);
+    EXPECT_NE(tileJSON.data->find("\"tiles\":[\"" + url + "/{z}/{x}/{y}\"]"),
+              std::string::npos);
+    EXPECT_NE(tileJSON.data->find("\"vector_layers\""), std::string::npos);
+    EXPECT_NE(tileJSON.data->find("\"maxzoom\":1"), std::string::npos);
+
+    auto root = archives.fetch(tile_resource(url + "/0/0/0"));
+    ASSERT_TRUE(root.data);
+    EXPECT_EQ(*root.data, "tile 0/0/0");
+
+    auto tile = archives.fetch(tile_resource(url + "/1/1/0"));
+    ASSERT_TRUE(tile.data);
+    EXPECT_EQ(*tile.data, "tile 1/1/0");
+
+    auto missing = archives.fetch(tile_resource(url + "/1/0/0"));
+    EXPECT_FALSE(missing.error);
+    EXPECT_TRUE(missing.noContent);
+}
+
+TEST(TileArchiveTest, ServesMBTiles) {
+    const auto path = temp_archive("test.mbtiles");
+    write_mbtiles(path);
+    const std::string url = "mbtiles://" + path.string();
+    mbgl::TileArchives archives;
+
+    auto tileJSON = archives.fetch(
+        mbgl::Resource(mbgl::Resource::Kind::Source, url));
+    ASSERT_TRUE(tileJSON.data);
+    EXPECT_NE(tileJSON.data->find("\"minzoom\":1"), std::string::npos);
+    EXPECT_NE(tileJSON.data->find("\"id\":\"water\""), std::string::npos);
+    EXPECT_NE(tileJSON.data->find(R"("name":"Offline \"test\"")"),
+              std::string::npos);
+
+    // Stored TMS row 1 at zoom 1 is XYZ y = 0; the blob is gunzipped.
+    auto tile = archives.fetch(tile_resource(url + "/1/0/0"));
+    ASSERT_TRUE(tile.data);
+    EXPECT_EQ(*tile.data, "tile 1/0/0");
+    EXPECT_TRUE(archives.fetch(tile_resource(url + "/1/0/1")).noContent);
+}
+
+TEST(TileArchiveTest, MissingArchiveIsNotFound) {
+    mbgl::TileArchives archives;
+    auto response =
+        archives.fetch(tile_resource("pmtiles:///nonexistent.pmtiles/0/0/0"));
+    ASSERT_TRUE(response.error);
+    EXPECT_EQ(response.error->reason, mbgl::Response::Error::Reason::NotFound);
+}
@@ -0,0 +1,115 @@
+#include "tile_cover.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(TileCoverTest, ProjectsToNormalizedMercator) {
+    const MercatorPoint origin = project_mercator(0.0, 0.0);
+    EXPECT_DOUBLE_EQ(origin.x, 0.5);
+    EXPECT_NEAR(origin.y, 0.5, 1e-12);
+    const MercatorPoint north_west = project_mercator(85.0511287798, -180.0);
+    EXPECT_NEAR(north_west.x, 0.0, 1e-12);
+    EXPECT_NEAR(north_west.y, 0.0, 1e-9);
+}
+
+TEST(TileCoverTest, CoversViewportNearestFirst) {
+    // At zoom 2 the world is 2048 px, so a 512 px viewport is one tile
+    // wide: centred on tile (1, 1) it shows exactly that tile, slightly off
+    // centre it straddles four.
+    const auto exact = tile_cover({0.375, 0.375}, 2.0, 512.0, 512.0, 2);
+    ASSERT_EQ(exact.size(), 1u);
+    EXPECT_EQ(exact.front(), (TileCoordinate{2, 1, 1}));
+
+    const auto tiles = tile_cover({0.37, 0.37}, 2.0, 512.0, 512.0, 2);
+    ASSERT_EQ(tiles.size(), 4u);
+    EXPECT_EQ(tiles.front(), (TileCoordinate{2, 1, 1}));
+    EXPECT_EQ(tiles.back(), (TileCoordinate{2, 0, 0}));
+}
+
+TEST(TileCoverTest, WrapsAcrossTheAntimeridian) {
+    const MercatorPoint center = project_mercator(0.0, 179.9);
+    const auto tiles = tile_cover(center, 3.0, 1024.0, 256.0, 3);
+    bool east = false;
+    bool west = false;
+    for (const auto& tile : tiles) {
+        EXPECT_LT(tile.x, 8u);
+        east = east || tile.x == 7;
+        west = west || tile.x == 0;
+    }
+    EXPECT_TRUE(east);
+    EXPECT_TRUE(west);
+}
+
+TEST(TileCoverTest, WholeWorldAtLowZoom) {
+    const auto tiles = tile_cover({0.5, 0.5}, 0.0, 4096.0, 4096.0, 1);
+    EXPECT_EQ(tiles.size(), 4u);
+}
+
+TEST(TileCoverTest, MarginGrowsTheCover) {
+    const MercatorPoint center{0.5, 0.5};
+    const auto tight = tile_cover(center, 10.0, 800.0, 600.0, 10);
+    const auto wide = tile_cover(center, 10.0, 800.0, 600.0, 10, 512.0);
+    EXPECT_GT(wide.size(), tight.size());
+}
+
+TEST(TileCoverTest, FlyToPutsDestinationFirstAndRespectsBudget) {
+    const auto tiles = fly_to_tiles(48.8566, 2.3522, 35.6895, 139.6917, 3.0,
+                                    10.0, 800.0, 600.0, 20);
+    ASSERT_FALSE(tiles.empty());
+    EXPECT_LE(tiles.size(), 20u);
+    EXPECT_EQ(tiles.front().z, 10);
+    bool has_path = false;
+    for (const auto& tile : tiles) {
+        has_path = has_path || tile.z == 3;
+    }
+    EXPECT_TRUE(has_path);
+}
+
+TEST(TileCoverTest, LongitudeDeltaTakesTheShortWay) {
+    EXPECT_DOUBLE_EQ(longitude_delta(10.0, 30.0), 20.0);
+    EXPECT_DOUBLE_EQ(longitude_delta(170.0, -170.0), 20.0);
+    EXPECT_DOUBLE_EQ(longitude_delta(-170.0, 170.0), -20.0);
+}
+
+TEST(TileCoverTest, FlyToPathCrossesTheAntimeridian) {
+    // Fiji to Samoa: the path covers the Pacific, not the rest of the world
+    const auto tiles = fly_to_tiles(-18.0, 178.0, -14.0, -172.0, 4.0, 4.0,
+                                    256.0, 256.0, 64);
+    ASSERT_FALSE(tiles.empty());
+    for (const auto& tile : tiles) {
+        EXPECT_TRUE(tile.x <= 1 || tile.x >= 14) << tile.x;
+    }
+}
+
+TEST(TileCoverTest, SourceTileStaysInTheSourceZoomRange) {
+    EXPECT_EQ(source_tile({5, 10, 12}, 2, 14), (TileCoordinate{5, 10, 12}));
+    EXPECT_FALSE(source_tile({1, 1, 0}, 2, 14));
+    // Overzoomed: the ancestor at maxzoom is scaled up instead.
+    EXPECT_EQ(source_tile({16, 35000, 21000}, 0, 14),
+              (TileCoordinate{14, 8750, 5250}));
+}
+
+TEST(TileCoverTest, FitZoomShowsBothPoints) {
+    const MercatorPoint a = project_mercator(48.8566, 2.3522);
+    const MercatorPoint b = project_mercator(40.7128, -74.0060);
+    const double zoom = fit_zoom(a, b, 800.0, 600.0);
+    const double world_px = 512.0 * std::exp2(zoom);
+    EXPECT_LE(std::abs(a.x - b.x) * world_px, 800.0 + 1e-6);
+    EXPECT_GT(zoom, 0.0);
+    EXPECT_LT(zoom, 5.0);
+}
+
+TEST(TileCoverTest, CountsRegionTilesPerZoomLevel) {
+    // The whole world: 1 + 4 + 16 tiles.
+    EXPECT_EQ(region_tile_count(-85.0511, -180.0, 85.0511, 180.0, 0.0, 2.0),
+              21u);
+    // One quadrant of the world at z1 and z2 (zoom levels are floored).
+    EXPECT_EQ(region_tile_count(0.0, 0.0, 85.0511, 180.0, 1.0, 2.9), 1u + 4u);
+    // A point still needs one tile per zoom level.
+    EXPECT_EQ(region_tile_count(48.85, 2.35, 48.85, 2.35, 10.0, 12.0), 3u);
+}
+
+TEST(TileCoverTest, RegionAcrossTheAntimeridian) {
+    // 90 degrees either side of the antimeridian in the northern
+    // hemisphere: the two outer columns at z2.
+    EXPECT_EQ(region_tile_count(0.0, 90.0, 85.0511, -90.0, 2.0, 2.0), 4u);
+}
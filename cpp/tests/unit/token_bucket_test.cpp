@@ -0,0 +1,36 @@
+#include "token_bucket.hpp"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using mbgl::TokenBucket;
+
+TEST(TokenBucketTest, BurstIsFree) {
+    const auto start = TokenBucket::Clock::now();
+    TokenBucket bucket(1000, 1000, start);
+    EXPECT_EQ(bucket.take(600, start), TokenBucket::Clock::duration::zero());
+    EXPECT_EQ(bucket.take(400, start), TokenBucket::Clock::duration::zero());
+}
+
+TEST(TokenBucketTest, DebtTurnsIntoDelay) {
+    const auto start = TokenBucket::Clock::now();
+    TokenBucket bucket(1000, 1000, start);
+    bucket.take(1000, start);
+    EXPECT_EQ(bucket.take(500, start), 500ms);
+    // Shared debt: the next caller waits for everything owed before it.
+    EXPECT_EQ(bucket.take(500, start), 1000ms);
+}
+
+TEST(TokenBucketTest, RefillsAtRateUpToBurst) {
+    const auto start = TokenBucket::Clock::now();
+    TokenBucket bucket(1000, 1000, start);
+    bucket.take(1500, start);
+    // 500 bytes of debt are repaid after 0.5 s, another 250 bytes accrue.
+    EXPECT_EQ(bucket.take(250, start + 750ms),
+              TokenBucket::Clock::duration::zero());
+    // Idle time never stores more than one burst.
+    EXPECT_EQ(bucket.take(1000, start + 60s),
+              TokenBucket::Clock::duration::zero());
+    EXPECT_EQ(bucket.take(100, start + 60s), 100ms);
+}